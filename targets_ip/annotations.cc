@@ -0,0 +1,90 @@
+#include "annotations.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+namespace fs = boost::filesystem;
+namespace pt = boost::property_tree;
+
+std::vector<std::string> listAnnotations(const std::string &directory) {
+	std::vector<std::string> annotations;
+	for (const auto &entry : fs::directory_iterator(directory)) {
+		if (entry.path().extension() == ".json") {
+			annotations.push_back(entry.path().string());
+		}
+	}
+	std::sort(annotations.begin(), annotations.end());
+	return annotations;
+}
+
+std::vector<cv::Point2f> shapePoints(const pt::ptree &shape) {
+	std::vector<cv::Point2f> points;
+	for (const auto &point : shape.get_child("points")) {
+		auto coord = point.second.begin();
+		const float x = coord->second.get_value<float>();
+		const float y = (++coord)->second.get_value<float>();
+		points.emplace_back(x, y);
+	}
+	return points;
+}
+
+Annotation annotationFromTree(const pt::ptree &root, const fs::path &directory) {
+	Annotation annotation;
+	annotation.image_path = (directory / root.get<std::string>("imagePath")).string();
+	annotation.image_size = cv::Size(root.get<int>("imageWidth", 0),
+		root.get<int>("imageHeight", 0));
+	for (const auto &shape : root.get_child("shapes")) {
+		annotation.shapes.push_back({shape.second.get<std::string>("label", ""),
+			shape.second.get<std::string>("shape_type", ""),
+			shapePoints(shape.second)});
+	}
+	return annotation;
+}
+
+Annotation loadAnnotation(const std::string &filename) {
+	pt::ptree root;
+	pt::read_json(filename, root);
+	return annotationFromTree(root, fs::path(filename).parent_path());
+}
+
+Annotation parseAnnotation(const std::string &json, const std::string &directory) {
+	std::istringstream stream(json);
+	pt::ptree root;
+	pt::read_json(stream, root);
+	return annotationFromTree(root, directory);
+}
+
+std::map<std::string, int> loadLabelMap(const std::string &filename) {
+	std::ifstream file(filename);
+	if (!file) {
+		std::cerr << "Could not open label map " << filename << std::endl;
+		abort();
+	}
+	std::stringstream content;
+	content << file.rdbuf();
+	const std::string text = content.str();
+
+	// item { id: 1 name: 'arrow' }, fields in any order
+	const std::regex item_regex(R"(item\s*\{([^}]*)\})");
+	const std::regex id_regex(R"(\bid\s*:\s*(\d+))");
+	const std::regex name_regex(R"(\bname\s*:\s*['"]([^'"]*)['"])");
+	std::map<std::string, int> label_map;
+	for (std::sregex_iterator item(text.begin(), text.end(), item_regex), end; item != end; ++item) {
+		const std::string body = (*item)[1];
+		std::smatch id, name;
+		if (std::regex_search(body, id, id_regex) && std::regex_search(body, name, name_regex)) {
+			label_map[name[1]] = std::stoi(id[1]);
+		}
+	}
+	return label_map;
+}
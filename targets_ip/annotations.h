@@ -0,0 +1,33 @@
+#ifndef _ANNOTATIONS_H
+#define _ANNOTATIONS_H
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+struct AnnotatedShape {
+	std::string label;
+	std::string shape_type;
+	std::vector<cv::Point2f> points;
+};
+
+// Single labelme annotation file as produced for targets_tf.
+struct Annotation {
+	std::string image_path;  // resolved against the annotation directory
+	cv::Size image_size;
+	std::vector<AnnotatedShape> shapes;
+};
+
+// Sorted paths of all labelme annotations (*.json) in directory.
+std::vector<std::string> listAnnotations(const std::string &directory);
+Annotation loadAnnotation(const std::string &filename);
+// Annotation from labelme JSON text, imagePath resolved against directory.
+Annotation parseAnnotation(const std::string &json, const std::string &directory);
+
+// Label name to id map from an object detection label map (.pbtxt).
+std::map<std::string, int> loadLabelMap(const std::string &filename);
+
+#endif  // _ANNOTATIONS_H
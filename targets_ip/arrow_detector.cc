@@ -0,0 +1,155 @@
+#include "arrow_detector.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/dnn.hpp>
+#include <opencv2/imgproc.hpp>
+
+const int DETECTION_OUTPUT_COLUMNS = 7;
+
+ArrowDetectorParameters defaultArrowDetectorParameters(const std::string &model) {
+	ArrowDetectorParameters parameters;
+	const std::string extension = ".onnx";
+	if (model.size() >= extension.size() &&
+		model.compare(model.size() - extension.size(), extension.size(), extension) == 0) {
+		parameters.scale = 1.0;
+		parameters.mean = cv::Scalar();
+	}
+	return parameters;
+}
+
+ArrowDetector::ArrowDetector(const std::string &model, const std::string &config,
+	const ArrowDetectorParameters &parameters)
+	: net(cv::dnn::readNet(model, config)),
+		parameters(parameters) {
+	if (net.empty()) {
+		std::cerr << "Could not load detector model " << model << std::endl;
+		abort();
+	}
+	net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+	net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+	output_names = net.getUnconnectedOutLayersNames();
+}
+
+ArrowDetector::ArrowDetector(const std::string &model, const std::string &config)
+	: ArrowDetector(model, config, defaultArrowDetectorParameters(model)) {
+}
+
+// Index of the output named name, or -1. TF2 exports have further outputs
+// such as raw_detection_boxes and detection_multiclass_scores of other
+// shapes, so names are matched exactly.
+int findOutput(const std::vector<cv::String> &names, const std::string &name) {
+	for (size_t i = 0; i < names.size(); i++) {
+		if (names[i] == name) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool parseDetectionOutput(const cv::Mat &output, float score_threshold,
+	const std::vector<cv::Size> &face_sizes,
+	std::vector<std::vector<ArrowDetection>> *detections) {
+	if (output.type() != CV_32F || output.total() % DETECTION_OUTPUT_COLUMNS != 0) {
+		return false;
+	}
+	const cv::Mat rows(output.total() / DETECTION_OUTPUT_COLUMNS, DETECTION_OUTPUT_COLUMNS,
+		CV_32F, const_cast<uchar*>(output.ptr()));
+	for (int i = 0; i < rows.rows; i++) {
+		const float *row = rows.ptr<float>(i);
+		const int image = static_cast<int>(row[0]);
+		if (image < 0 || image >= static_cast<int>(face_sizes.size()) || row[2] < score_threshold) {
+			continue;
+		}
+		const cv::Size size = face_sizes[image];
+		(*detections)[image].push_back({static_cast<int>(row[1]), row[2],
+			cv::Rect2f(cv::Point2f(row[3] * size.width, row[4] * size.height),
+				cv::Point2f(row[5] * size.width, row[6] * size.height))});
+	}
+	return true;
+}
+
+bool parseObjectDetectionOutputs(const cv::Mat &boxes, const cv::Mat &scores,
+	const cv::Mat &classes, float score_threshold,
+	const std::vector<cv::Size> &face_sizes,
+	std::vector<std::vector<ArrowDetection>> *detections) {
+	const int batch = face_sizes.size();
+	if (batch == 0 || boxes.type() != CV_32F || scores.type() != CV_32F ||
+		classes.type() != CV_32F || scores.dims < 2 || scores.size[0] != batch) {
+		return false;
+	}
+	const size_t count = scores.total() / batch;
+	if (scores.total() != batch * count || classes.total() != batch * count ||
+		boxes.total() != batch * count * 4 ||
+		boxes.dims != 3 || boxes.size[0] != batch || boxes.size[2] != 4) {
+		return false;
+	}
+	for (int image = 0; image < batch; image++) {
+		const cv::Size size = face_sizes[image];
+		const float *image_boxes = boxes.ptr<float>() + image * count * 4;
+		const float *image_scores = scores.ptr<float>() + image * count;
+		const float *image_classes = classes.ptr<float>() + image * count;
+		for (size_t i = 0; i < count; i++) {
+			if (image_scores[i] < score_threshold) {
+				continue;
+			}
+			const float *box = image_boxes + i * 4;
+			(*detections)[image].push_back({static_cast<int>(image_classes[i]), image_scores[i],
+				cv::Rect2f(cv::Point2f(box[1] * size.width, box[0] * size.height),
+					cv::Point2f(box[3] * size.width, box[2] * size.height))});
+		}
+	}
+	return true;
+}
+
+std::vector<std::vector<ArrowDetection>> ArrowDetector::detect(const std::vector<cv::Mat> &faces) {
+	std::vector<std::vector<ArrowDetection>> detections(faces.size());
+	if (faces.empty()) {
+		return detections;
+	}
+
+	// The network is trained on color faces, V plane faces are replicated.
+	std::vector<cv::Size> face_sizes;
+	bgr_faces.resize(faces.size());
+	for (size_t i = 0; i < faces.size(); i++) {
+		face_sizes.push_back(faces[i].size());
+		if (faces[i].channels() == 1) {
+			cv::cvtColor(faces[i], bgr_faces[i], cv::COLOR_GRAY2BGR);
+		} else {
+			bgr_faces[i] = faces[i];
+		}
+	}
+
+	cv::dnn::blobFromImages(bgr_faces, blob, parameters.scale, parameters.input_size,
+		parameters.mean, true, false);
+	net.setInput(blob);
+
+	std::vector<cv::Mat> outputs;
+	net.forward(outputs, output_names);
+
+	const int boxes = findOutput(output_names, "detection_boxes");
+	const int scores = findOutput(output_names, "detection_scores");
+	const int classes = findOutput(output_names, "detection_classes");
+	const bool parsed = boxes >= 0 && scores >= 0 && classes >= 0
+		? parseObjectDetectionOutputs(outputs[boxes], outputs[scores], outputs[classes],
+			parameters.score_threshold, face_sizes, &detections)
+		: parseDetectionOutput(outputs[0], parameters.score_threshold, face_sizes, &detections);
+	if (!parsed) {
+		std::cerr << "Unexpected detector output layout" << std::endl;
+		abort();
+	}
+	return detections;
+}
+
+std::vector<ArrowDetection> ArrowDetector::detect(const cv::Mat &face) {
+	return detect(std::vector<cv::Mat>{face})[0];
+}
+
+void drawDetections(cv::Mat *image, const std::vector<ArrowDetection> &detections) {
+	for (const auto &detection : detections) {
+		cv::rectangle(*image, detection.box, cv::Scalar(0, 0, 255), 1);
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef _ARROW_DETECTOR_H
+#define _ARROW_DETECTOR_H
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/dnn.hpp>
+
+struct ArrowDetection {
+	int class_id;
+	float score;
+	cv::Rect2f box;  // face pixels
+};
+
+// Input of the network is (face - mean) * scale per RGB channel.
+struct ArrowDetectorParameters {
+	cv::Size input_size{320, 320};
+	float score_threshold = 0.5f;
+	double scale = 1.0 / 127.5;
+	cv::Scalar mean{127.5, 127.5, 127.5};
+};
+
+// Preprocessing of the model format: MobileNet's (x - 127.5) / 127.5 for
+// frozen SSD graphs, raw pixel values for ONNX exports of TF2 object
+// detection models, which normalize inside the graph.
+ArrowDetectorParameters defaultArrowDetectorParameters(const std::string &model);
+
+// Runs the MobileNet SSD arrow detector trained in targets_tf on rectified
+// color target faces (warpColorTargetFace) through OpenCV's dnn module on
+// the CPU. The network is loaded once and kept for the lifetime of the
+// detector, faces are batched into a single forward pass. Both the SSD
+// DetectionOutput layout ([1, 1, N, 7]) and the TF2 object detection
+// outputs (detection_boxes, detection_scores, detection_classes) exported
+// to ONNX with NCHW float input are understood.
+class ArrowDetector {
+ private:
+	cv::dnn::Net net;
+	ArrowDetectorParameters parameters;
+	std::vector<cv::String> output_names;
+	std::vector<cv::Mat> bgr_faces;
+	cv::Mat blob;
+
+ public:
+	ArrowDetector(const std::string &model, const std::string &config,
+		const ArrowDetectorParameters &parameters);
+	ArrowDetector(const std::string &model, const std::string &config);
+
+	std::vector<std::vector<ArrowDetection>> detect(const std::vector<cv::Mat> &faces);
+	std::vector<ArrowDetection> detect(const cv::Mat &face);
+};
+
+// Detections of a batch of faces of face_sizes from the SSD DetectionOutput
+// layout: [1, 1, N, 7] rows of {image_id, label, score, x1, y1, x2, y2},
+// normalized. Both parsers return false, leaving detections untouched, when
+// the outputs do not have the expected layout.
+bool parseDetectionOutput(const cv::Mat &output, float score_threshold,
+	const std::vector<cv::Size> &face_sizes,
+	std::vector<std::vector<ArrowDetection>> *detections);
+// Detections from the TF2 object detection outputs: boxes [B, N, 4] as
+// {ymin, xmin, ymax, xmax}, scores and classes [B, N].
+bool parseObjectDetectionOutputs(const cv::Mat &boxes, const cv::Mat &scores,
+	const cv::Mat &classes, float score_threshold,
+	const std::vector<cv::Size> &face_sizes,
+	std::vector<std::vector<ArrowDetection>> *detections);
+
+void drawDetections(cv::Mat *image, const std::vector<ArrowDetection> &detections);
+
+#endif  // _ARROW_DETECTOR_H
@@ -0,0 +1,105 @@
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE ArrowDetectorTest
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "arrow_detector.h"
+
+BOOST_AUTO_TEST_CASE(test_parse_detection_output) {
+	const int sizes[] = {1, 1, 4, 7};
+	cv::Mat output(4, sizes, CV_32F);
+	const float rows[4][7] = {
+		{0, 1, 0.9f, 0.1f, 0.2f, 0.3f, 0.4f},
+		{1, 2, 0.8f, 0.5f, 0.5f, 0.75f, 1.0f},
+		{1, 1, 0.2f, 0, 0, 1, 1},  // below the score threshold
+		{-1, 0, 0, 0, 0, 0, 0}};  // padding row
+	std::copy(&rows[0][0], &rows[0][0] + 28, output.ptr<float>());
+
+	const std::vector<cv::Size> face_sizes{{100, 200}, {256, 256}};
+	std::vector<std::vector<ArrowDetection>> detections(face_sizes.size());
+	BOOST_REQUIRE(parseDetectionOutput(output, 0.5f, face_sizes, &detections));
+
+	BOOST_REQUIRE_EQUAL(detections[0].size(), 1);
+	BOOST_REQUIRE_EQUAL(detections[1].size(), 1);
+	BOOST_CHECK_EQUAL(detections[0][0].class_id, 1);
+	BOOST_CHECK_CLOSE(detections[0][0].score, 0.9f, 0.0001);
+	BOOST_CHECK_CLOSE(detections[0][0].box.x, 10.0f, 0.001);
+	BOOST_CHECK_CLOSE(detections[0][0].box.y, 40.0f, 0.001);
+	BOOST_CHECK_CLOSE(detections[0][0].box.width, 20.0f, 0.001);
+	BOOST_CHECK_CLOSE(detections[0][0].box.height, 40.0f, 0.001);
+	BOOST_CHECK_EQUAL(detections[1][0].class_id, 2);
+	BOOST_CHECK_CLOSE(detections[1][0].box.x, 128.0f, 0.001);
+	BOOST_CHECK_CLOSE(detections[1][0].box.height, 128.0f, 0.001);
+}
+
+BOOST_AUTO_TEST_CASE(test_parse_object_detection_outputs) {
+	// Batch of two faces with two candidate boxes each.
+	const int box_sizes[] = {2, 2, 4};
+	cv::Mat boxes(3, box_sizes, CV_32F);
+	const float box_values[] = {
+		0.1f, 0.2f, 0.3f, 0.4f,  0, 0, 1, 1,
+		0.5f, 0.5f, 1.0f, 0.75f,  0, 0, 0.5f, 0.5f};
+	std::copy(box_values, box_values + 16, boxes.ptr<float>());
+	const cv::Mat scores = (cv::Mat_<float>(2, 2) << 0.9f, 0.1f, 0.3f, 0.7f);
+	const cv::Mat classes = (cv::Mat_<float>(2, 2) << 1, 1, 2, 3);
+
+	const std::vector<cv::Size> face_sizes{{200, 100}, {256, 256}};
+	std::vector<std::vector<ArrowDetection>> detections(face_sizes.size());
+	BOOST_REQUIRE(parseObjectDetectionOutputs(boxes, scores, classes, 0.5f, face_sizes, &detections));
+
+	BOOST_REQUIRE_EQUAL(detections[0].size(), 1);
+	BOOST_REQUIRE_EQUAL(detections[1].size(), 1);
+	// {ymin, xmin, ymax, xmax}
+	BOOST_CHECK_EQUAL(detections[0][0].class_id, 1);
+	BOOST_CHECK_CLOSE(detections[0][0].box.x, 40.0f, 0.001);
+	BOOST_CHECK_CLOSE(detections[0][0].box.y, 10.0f, 0.001);
+	BOOST_CHECK_CLOSE(detections[0][0].box.width, 40.0f, 0.001);
+	BOOST_CHECK_CLOSE(detections[0][0].box.height, 20.0f, 0.001);
+	BOOST_CHECK_EQUAL(detections[1][0].class_id, 3);
+	BOOST_CHECK_CLOSE(detections[1][0].score, 0.7f, 0.0001);
+	BOOST_CHECK_CLOSE(detections[1][0].box.width, 128.0f, 0.001);
+}
+
+BOOST_AUTO_TEST_CASE(test_mismatched_object_detection_outputs_are_rejected) {
+	const int box_sizes[] = {2, 2, 4};
+	const cv::Mat boxes(3, box_sizes, CV_32F, cv::Scalar(0));
+	const cv::Mat scores(2, 2, CV_32F, cv::Scalar(0.9));
+	const cv::Mat classes(2, 2, CV_32F, cv::Scalar(1));
+	const std::vector<cv::Size> face_sizes{{256, 256}, {256, 256}};
+	std::vector<std::vector<ArrowDetection>> detections(face_sizes.size());
+
+	// detection_multiclass_scores, [B, N, classes].
+	const int multiclass_sizes[] = {2, 2, 3};
+	const cv::Mat multiclass_scores(3, multiclass_sizes, CV_32F, cv::Scalar(0.9));
+	BOOST_CHECK(!parseObjectDetectionOutputs(boxes, multiclass_scores, classes, 0.5f,
+		face_sizes, &detections));
+	// raw_detection_boxes with more candidates than scores.
+	const int raw_sizes[] = {2, 5, 4};
+	const cv::Mat raw_boxes(3, raw_sizes, CV_32F, cv::Scalar(0));
+	BOOST_CHECK(!parseObjectDetectionOutputs(raw_boxes, scores, classes, 0.5f,
+		face_sizes, &detections));
+	// A batch of one face against outputs of two.
+	std::vector<std::vector<ArrowDetection>> single(1);
+	BOOST_CHECK(!parseObjectDetectionOutputs(boxes, scores, classes, 0.5f,
+		{{256, 256}}, &single));
+	BOOST_CHECK(detections[0].empty() && detections[1].empty() && single[0].empty());
+
+	BOOST_CHECK(!parseDetectionOutput(cv::Mat(1, 6, CV_32F, cv::Scalar(0)), 0.5f,
+		face_sizes, &detections));
+}
+
+BOOST_AUTO_TEST_CASE(test_default_parameters_follow_model_format) {
+	const ArrowDetectorParameters ssd = defaultArrowDetectorParameters("frozen_inference_graph.pb");
+	BOOST_CHECK_CLOSE(ssd.scale, 1.0 / 127.5, 0.0001);
+	BOOST_CHECK_EQUAL(ssd.mean[0], 127.5);
+	// TF2 object detection models normalize inside the graph.
+	const ArrowDetectorParameters onnx = defaultArrowDetectorParameters("model.onnx");
+	BOOST_CHECK_EQUAL(onnx.scale, 1.0);
+	BOOST_CHECK_EQUAL(onnx.mean[0], 0.0);
+}
@@ -0,0 +1,213 @@
+#include "autotune.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "target.h"
+#include "utils.h"
+
+// Input planes shared by every grid point of one frame.
+struct PreprocessedFrame {
+	cv::Mat img_resized;
+	cv::Mat hsv[3];
+	float preprocess_ms = 0;
+};
+
+size_t TuningGrid::size() const {
+	return smoothing.size() * threshold.size() * dilate.size() *
+		canny1.size() * canny2.size() * hough.size();
+}
+
+double tuningAccuracy(const RegressionMetrics &metrics) {
+	const double sum = metrics.recall + metrics.precision;
+	const double f1 = sum > 0 ? 2 * metrics.recall * metrics.precision / sum : 0;
+	return metrics.quad_detection_rate * f1;
+}
+
+// Grid points are numbered with hough varying fastest and smoothing slowest,
+// so all points sharing a blurred plane form one contiguous block.
+PipelineParameters gridParameters(const TuningGrid &grid,
+	const PipelineParameters &base, size_t index) {
+	PipelineParameters parameters = base;
+	parameters.hough = grid.hough[index % grid.hough.size()];
+	index /= grid.hough.size();
+	parameters.canny2 = grid.canny2[index % grid.canny2.size()];
+	index /= grid.canny2.size();
+	parameters.canny1 = grid.canny1[index % grid.canny1.size()];
+	index /= grid.canny1.size();
+	parameters.dilate = grid.dilate[index % grid.dilate.size()];
+	index /= grid.dilate.size();
+	parameters.threshold = grid.threshold[index % grid.threshold.size()];
+	index /= grid.threshold.size();
+	parameters.smoothing = grid.smoothing[index];
+	return parameters;
+}
+
+// Runs every grid point with one smoothing value on one frame.
+void sweepFrame(const LabeledFrame &frame,
+	const PreprocessedFrame &preprocessed,
+	const TuningGrid &grid,
+	const PipelineParameters &base,
+	size_t smoothing_index,
+	std::vector<std::vector<FrameEvaluation>> *evaluations,
+	size_t frame_index) {
+	TargetExtractorData data(base.target_size, base.scaled_input_size);
+	data.img = frame.image;
+	data.img_resized = preprocessed.img_resized;
+	for (int i = 0; i < 3; i++) {
+		data.hsv[i] = preprocessed.hsv[i];
+	}
+
+	const size_t lines_block = grid.canny1.size() * grid.canny2.size() * grid.hough.size();
+	const size_t smoothing_block = grid.threshold.size() * grid.dilate.size() * lines_block;
+	size_t index = smoothing_index * smoothing_block;
+
+	Stopwatch stopwatch;
+	smoothTargetInput(&data, grid.smoothing[smoothing_index]);
+	const float smoothing_ms = stopwatch.lap();
+
+	for (int threshold : grid.threshold) {
+		for (int dilate : grid.dilate) {
+			stopwatch.lap();
+			data.poly.clear();
+			data.homography.release();
+			extractSmoothedTargetFace(&data, dilate, threshold);
+			const float extract_ms = smoothing_ms + stopwatch.lap();
+			const bool quad_found = data.poly.size() == 4 && !data.homography.empty();
+
+			for (size_t lines = 0; lines < lines_block; lines++, index++) {
+				const PipelineParameters parameters = gridParameters(grid, base, index);
+				FrameEvaluation evaluation;
+				evaluation.stage_ms[STAGE_PREPROCESS] = preprocessed.preprocess_ms;
+				evaluation.stage_ms[STAGE_EXTRACT] = extract_ms;
+				if (quad_found) {
+					stopwatch.lap();
+					detectArrows(&data, parameters.canny1, parameters.canny2, parameters.hough);
+					evaluation.stage_ms[STAGE_DETECT] = stopwatch.lap();
+				}
+				scoreDetection(frame, parameters, data, &evaluation);
+				(*evaluations)[index][frame_index] = evaluation;
+			}
+		}
+	}
+}
+
+std::vector<TuningResult> sweepParameters(const std::vector<LabeledFrame> &dataset,
+	const TuningGrid &grid,
+	const PipelineParameters &base,
+	WorkStealingPool *pool) {
+	std::vector<PreprocessedFrame> preprocessed(dataset.size());
+	parallelFor(pool, dataset.size(), [&](int i) {
+		TargetExtractorData data(base.target_size, base.scaled_input_size);
+		Stopwatch stopwatch;
+		data.img = dataset[i].image;
+		preprocessInput(&data);
+		preprocessed[i].preprocess_ms = stopwatch.lap();
+		preprocessed[i].img_resized = data.img_resized;
+		for (int plane = 0; plane < 3; plane++) {
+			preprocessed[i].hsv[plane] = data.hsv[plane];
+		}
+	});
+
+	// Each task writes its own frame column of a disjoint block of rows.
+	std::vector<std::vector<FrameEvaluation>> evaluations(grid.size(),
+		std::vector<FrameEvaluation>(dataset.size()));
+	const int smoothings = grid.smoothing.size();
+	parallelFor(pool, dataset.size() * smoothings, [&](int task) {
+		const int frame = task / smoothings;
+		sweepFrame(dataset[frame], preprocessed[frame], grid, base,
+			task % smoothings, &evaluations, frame);
+	});
+
+	std::vector<TuningResult> results(grid.size());
+	for (size_t i = 0; i < grid.size(); i++) {
+		results[i].parameters = gridParameters(grid, base, i);
+		results[i].metrics = summarizeEvaluations(evaluations[i]);
+		results[i].accuracy = tuningAccuracy(results[i].metrics);
+		results[i].latency_ms = results[i].metrics.fps > 0 ? 1000.0 / results[i].metrics.fps : 0;
+	}
+	return results;
+}
+
+void measureLatency(const std::vector<LabeledFrame> &dataset,
+	std::vector<TuningResult> *results) {
+	for (auto &result : *results) {
+		const PipelineParameters &parameters = result.parameters;
+		TargetExtractorData data(parameters.target_size, parameters.scaled_input_size);
+		double total_ms = 0;
+		for (const auto &frame : dataset) {
+			Stopwatch stopwatch;
+			data.img = frame.image;
+			preprocessInput(&data);
+			data.poly.clear();
+			data.homography.release();
+			extractTargetFace(&data, parameters.smoothing, parameters.dilate, parameters.threshold);
+			if (data.poly.size() == 4 && !data.homography.empty()) {
+				detectArrows(&data, parameters.canny1, parameters.canny2, parameters.hough);
+			}
+			total_ms += stopwatch.lap();
+		}
+		result.latency_ms = dataset.empty() ? 0 : total_ms / dataset.size();
+	}
+}
+
+std::vector<TuningResult> paretoFront(std::vector<TuningResult> results) {
+	std::sort(results.begin(), results.end(), [](const auto &a, const auto &b) {
+		return a.latency_ms < b.latency_ms ||
+			(a.latency_ms == b.latency_ms && a.accuracy > b.accuracy);
+	});
+	std::vector<TuningResult> front;
+	for (const auto &result : results) {
+		if (front.empty() || result.accuracy > front.back().accuracy) {
+			front.push_back(result);
+		}
+	}
+	return front;
+}
+
+void printTuningResults(std::ostream &out, const std::vector<TuningResult> &results) {
+	out << std::fixed << std::setprecision(3)
+		<< "latency_ms accuracy quads recall precision"
+		<< " smoothing threshold dilate canny1 canny2 hough\n";
+	for (const auto &result : results) {
+		const PipelineParameters &parameters = result.parameters;
+		out << std::setw(10) << result.latency_ms
+			<< std::setw(9) << result.accuracy
+			<< std::setw(6) << result.metrics.quad_detection_rate
+			<< std::setw(7) << result.metrics.recall
+			<< std::setw(10) << result.metrics.precision
+			<< std::setw(10) << parameters.smoothing
+			<< std::setw(10) << (parameters.threshold == AUTO_THRESHOLD
+				? std::string("auto") : std::to_string(parameters.threshold))
+			<< std::setw(7) << parameters.dilate
+			<< std::setw(7) << parameters.canny1
+			<< std::setw(7) << parameters.canny2
+			<< std::setw(6) << parameters.hough << "\n";
+	}
+}
+
+void storeTuningResults(const std::string &filename, const std::vector<TuningResult> &results) {
+	cv::FileStorage storage(filename, cv::FileStorage::WRITE);
+	storage << "results" << "[";
+	for (const auto &result : results) {
+		const PipelineParameters &parameters = result.parameters;
+		storage << "{"
+			<< "latency_ms" << result.latency_ms
+			<< "accuracy" << result.accuracy
+			<< "quad_detection_rate" << result.metrics.quad_detection_rate
+			<< "recall" << result.metrics.recall
+			<< "precision" << result.metrics.precision
+			<< "smoothing" << parameters.smoothing
+			<< "threshold" << parameters.threshold
+			<< "dilate" << parameters.dilate
+			<< "canny1" << parameters.canny1
+			<< "canny2" << parameters.canny2
+			<< "hough" << parameters.hough
+			<< "}";
+	}
+	storage << "]";
+}
@@ -0,0 +1,60 @@
+#ifndef _AUTOTUNE_H
+#define _AUTOTUNE_H
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "regression.h"
+#include "target.h"
+#include "thread_pool.h"
+
+// Values tried for each extraction and detection parameter, the sweep runs
+// their full cartesian product.
+struct TuningGrid {
+	std::vector<int> smoothing{0, 3, 5, 7};
+	std::vector<int> threshold{AUTO_THRESHOLD, 200, 220, 240};
+	std::vector<int> dilate{0, 3, 5};
+	std::vector<int> canny1{30, 50, 80};
+	std::vector<int> canny2{150, 200, 250};
+	std::vector<int> hough{30, 50, 70};
+
+	size_t size() const;
+};
+
+struct TuningResult {
+	PipelineParameters parameters;
+	RegressionMetrics metrics;
+	double accuracy = 0;
+	double latency_ms = 0;
+};
+
+// Quad detection rate times the F1 score of arrow recall and precision.
+double tuningAccuracy(const RegressionMetrics &metrics);
+
+// Evaluates every grid point over the dataset on the pool. Each frame is
+// preprocessed once, each blurred plane is shared by all threshold and
+// dilate values and each extracted face by all line detection values.
+// Latency of a grid point is the sum of its stage times, measured on the
+// split stages while the pool runs other points; it only orders the grid,
+// measureLatency times the chosen points.
+std::vector<TuningResult> sweepParameters(const std::vector<LabeledFrame> &dataset,
+	const TuningGrid &grid,
+	const PipelineParameters &base,
+	WorkStealingPool *pool);
+
+// Replaces the latency of every result with its mean frame time over the
+// dataset, run one result after the other on the calling thread through
+// preprocessInput, the fused extractTargetFace and detectArrows as the stream
+// runs them.
+void measureLatency(const std::vector<LabeledFrame> &dataset,
+	std::vector<TuningResult> *results);
+
+// Results not dominated in both accuracy and latency, ordered by latency.
+std::vector<TuningResult> paretoFront(std::vector<TuningResult> results);
+
+void printTuningResults(std::ostream &out, const std::vector<TuningResult> &results);
+void storeTuningResults(const std::string &filename, const std::vector<TuningResult> &results);
+
+#endif  // _AUTOTUNE_H
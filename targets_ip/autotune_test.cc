@@ -0,0 +1,80 @@
+#include <vector>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE AutotuneTest
+
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "autotune.h"
+#include "regression.h"
+#include "thread_pool.h"
+
+TuningResult tuningResult(double latency_ms, double accuracy) {
+	TuningResult result;
+	result.latency_ms = latency_ms;
+	result.accuracy = accuracy;
+	return result;
+}
+
+BOOST_AUTO_TEST_CASE(test_pareto_front) {
+	const std::vector<TuningResult> front = paretoFront({
+		tuningResult(3, 0.9),
+		tuningResult(1, 0.5),
+		tuningResult(2, 0.4),
+		tuningResult(2, 0.7),
+		tuningResult(4, 0.8)});
+	BOOST_REQUIRE_EQUAL(front.size(), 3);
+	BOOST_CHECK_EQUAL(front[0].latency_ms, 1);
+	BOOST_CHECK_EQUAL(front[1].accuracy, 0.7);
+	BOOST_CHECK_EQUAL(front[2].accuracy, 0.9);
+}
+
+BOOST_AUTO_TEST_CASE(test_sweep_matches_independent_evaluation) {
+	const std::vector<LabeledFrame> dataset = syntheticDataset(6, 3, cv::Size(320, 240), 2);
+	TuningGrid grid;
+	grid.smoothing = {0, 3};
+	grid.threshold = {220, 240};
+	grid.dilate = {3};
+	grid.canny1 = {50};
+	grid.canny2 = {200};
+	grid.hough = {30, 50};
+
+	WorkStealingPool pool(3);
+	const std::vector<TuningResult> results = sweepParameters(dataset, grid, PipelineParameters(), &pool);
+	BOOST_REQUIRE_EQUAL(results.size(), grid.size());
+
+	for (const auto &result : results) {
+		const RegressionMetrics expected = evaluateDataset(dataset, result.parameters);
+		BOOST_CHECK_EQUAL(result.metrics.frames, expected.frames);
+		BOOST_CHECK_CLOSE(result.metrics.quad_detection_rate, expected.quad_detection_rate, 1e-9);
+		BOOST_CHECK_CLOSE(result.metrics.recall, expected.recall, 1e-9);
+		BOOST_CHECK_CLOSE(result.metrics.precision, expected.precision, 1e-9);
+		BOOST_CHECK_GT(result.latency_ms, 0);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_auto_threshold_is_tuned_and_timed) {
+	BOOST_CHECK_EQUAL(TuningGrid().threshold.front(), AUTO_THRESHOLD);
+
+	const std::vector<LabeledFrame> dataset = syntheticDataset(4, 5, cv::Size(320, 240), 2);
+	TuningGrid grid;
+	grid.smoothing = {3};
+	grid.threshold = {AUTO_THRESHOLD};
+	grid.dilate = {3};
+	grid.canny1 = {50};
+	grid.canny2 = {200};
+	grid.hough = {50};
+
+	WorkStealingPool pool(2);
+	std::vector<TuningResult> results = sweepParameters(dataset, grid, PipelineParameters(), &pool);
+	BOOST_REQUIRE_EQUAL(results.size(), 1);
+	const RegressionMetrics expected = evaluateDataset(dataset, results[0].parameters);
+	BOOST_CHECK_CLOSE(results[0].metrics.quad_detection_rate, expected.quad_detection_rate, 1e-9);
+
+	results[0].latency_ms = 0;
+	measureLatency(dataset, &results);
+	BOOST_CHECK_GT(results[0].latency_ms, 0);
+}
@@ -0,0 +1,229 @@
+#include "cache.h"
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include "io.h"
+#include "target.h"
+#include "target_model.h"
+
+namespace fs = boost::filesystem;
+
+// Bump whenever the stored format or the cached stages change meaning.
+const int CACHE_FORMAT_VERSION = 1;
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+uint64_t fnv1a(const uchar *data, size_t size, uint64_t hash) {
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+uint64_t contentHash(const std::vector<uchar> &bytes) {
+	return fnv1a(bytes.data(), bytes.size(), FNV_OFFSET_BASIS);
+}
+
+uint64_t contentHash(const cv::Mat &image) {
+	const int header[] = {image.rows, image.cols, image.type()};
+	uint64_t hash = fnv1a(reinterpret_cast<const uchar*>(header), sizeof(header),
+		FNV_OFFSET_BASIS);
+	const size_t row_size = image.cols * image.elemSize();
+	for (int row = 0; row < image.rows; row++) {
+		hash = fnv1a(image.ptr(row), row_size, hash);
+	}
+	return hash;
+}
+
+uint64_t lensHash(const LensCalibration &lens) {
+	if (lens.empty() && lens.image_size.area() == 0) {
+		return 0;
+	}
+	uint64_t hash = fnv1a(reinterpret_cast<const uchar*>(lens.camera_matrix.val),
+		sizeof(lens.camera_matrix.val), FNV_OFFSET_BASIS);
+	cv::Mat distortion;
+	if (!lens.distortion.empty()) {
+		lens.distortion.convertTo(distortion, CV_64F);
+		distortion = distortion.reshape(1, 1).clone();
+		hash = fnv1a(distortion.ptr(), distortion.total() * distortion.elemSize(), hash);
+	}
+	const int size[] = {lens.image_size.width, lens.image_size.height};
+	return fnv1a(reinterpret_cast<const uchar*>(size), sizeof(size), hash);
+}
+
+std::string hashToString(uint64_t content_hash) {
+	std::ostringstream stream;
+	stream << std::hex << std::setw(16) << std::setfill('0') << content_hash;
+	return stream.str();
+}
+
+std::string extractionKey(uint64_t content_hash, const ExtractionParameters &parameters) {
+	std::ostringstream stream;
+	stream << hashToString(content_hash)
+		<< "_extract_v" << CACHE_FORMAT_VERSION
+		<< "_i" << parameters.scaled_input_size
+		<< "_f" << parameters.target_size.width << "x" << parameters.target_size.height
+		<< "_s" << parameters.smoothing
+		<< "_d" << parameters.dilate
+		<< "_t" << parameters.threshold;
+	if (parameters.warp_from_original) {
+		stream << "_o";
+	}
+	if (parameters.lens_hash) {
+		stream << "_u" << hashToString(parameters.lens_hash);
+	}
+	return stream.str();
+}
+
+std::string poseKey(uint64_t content_hash, const FitParameters &parameters) {
+	std::ostringstream stream;
+	stream << hashToString(content_hash) << "_pose_v" << CACHE_FORMAT_VERSION
+		<< "_r" << FIT_MODEL_REVISION
+		<< "_e" << static_cast<int>(parameters.engine);
+	if (!parameters.quad.empty()) {
+		stream << "_q" << hashToString(fnv1a(
+			reinterpret_cast<const uchar*>(parameters.quad.data()),
+			parameters.quad.size() * sizeof(cv::Point2f), FNV_OFFSET_BASIS));
+	}
+	if (parameters.lens_hash) {
+		stream << "_l" << hashToString(parameters.lens_hash);
+	}
+	return stream.str();
+}
+
+//-----------------------------------------------------------------------------
+
+ResultCache::ResultCache(const std::string &directory, bool store_warped)
+	: directory(directory), store_warped(store_warped) {
+}
+
+std::string ResultCache::entryPath(const std::string &key, const std::string &suffix) const {
+	return (fs::path(directory) / key.substr(0, 2) / (key + suffix)).string();
+}
+
+// Writes through a temporary file and renames it, so that concurrent
+// readers never observe a partially written entry.
+template<typename W>
+void storeAtomically(const std::string &path, const std::string &extension, W writer) {
+	const fs::path target(path);
+	fs::create_directories(target.parent_path());
+	const fs::path temporary = target.parent_path() /
+		fs::unique_path("tmp_%%%%%%%%" + extension);
+	writer(temporary.string());
+	fs::rename(temporary, target);
+}
+
+bool ResultCache::loadExtraction(const std::string &key, CachedExtraction *entry) const {
+	const std::string path = entryPath(key, ".yml");
+	if (!fs::exists(path)) {
+		return false;
+	}
+	cv::FileStorage storage(path, cv::FileStorage::READ);
+	if (!storage.isOpened()) {
+		return false;
+	}
+	int has_warped = 0;
+	storage["poly"] >> entry->poly;
+	storage["homography"] >> entry->homography;
+	storage["has_warped"] >> has_warped;
+
+	entry->warped.release();
+	if (has_warped) {
+		entry->warped = cv::imread(entryPath(key, ".png"), cv::IMREAD_UNCHANGED);
+	}
+	return true;
+}
+
+void ResultCache::storeExtraction(const std::string &key, const CachedExtraction &entry) const {
+	const bool has_warped = store_warped && !entry.warped.empty();
+	if (has_warped) {
+		storeAtomically(entryPath(key, ".png"), ".png", [&entry](const std::string &path) {
+			cv::imwrite(path, entry.warped);
+		});
+	}
+	storeAtomically(entryPath(key, ".yml"), ".yml", [&](const std::string &path) {
+		cv::FileStorage storage(path, cv::FileStorage::WRITE);
+		storage << "poly" << entry.poly;
+		storage << "homography" << entry.homography;
+		storage << "has_warped" << static_cast<int>(has_warped);
+	});
+}
+
+bool ResultCache::loadPose(const std::string &key, std::vector<double> *pose) const {
+	const std::string path = entryPath(key, ".yml");
+	if (!fs::exists(path)) {
+		return false;
+	}
+	cv::FileStorage storage(path, cv::FileStorage::READ);
+	if (!storage.isOpened()) {
+		return false;
+	}
+	storage["pose"] >> *pose;
+	return true;
+}
+
+void ResultCache::storePose(const std::string &key, const std::vector<double> &pose) const {
+	storeAtomically(entryPath(key, ".yml"), ".yml", [&pose](const std::string &path) {
+		cv::FileStorage storage(path, cv::FileStorage::WRITE);
+		storage << "pose" << pose;
+	});
+}
+
+//-----------------------------------------------------------------------------
+
+bool extractTargetFaceCached(ResultCache *cache,
+	TargetExtractorData *data,
+	const std::string &filename,
+	int smoothing, int dilate, int threshold) {
+	const std::vector<uchar> bytes = loadFileBytes(filename);
+	const std::string key = extractionKey(contentHash(bytes),
+		{data->target_size, data->scaled_input_size, smoothing, dilate, threshold,
+			data->warp_from_original, data->lens.empty() ? 0 : lensHash(data->lens)});
+
+	CachedExtraction entry;
+	if (cache->loadExtraction(key, &entry)) {
+		data->poly = entry.poly;
+		data->homography = entry.homography;
+		data->warped = entry.warped;
+		if (data->warped.empty() && !data->homography.empty()) {
+			data->img = decodeImage(bytes);
+			preprocessInput(data);
+			warpTargetFace(data);
+		}
+		return true;
+	}
+
+	data->img = decodeImage(bytes);
+	preprocessInput(data);
+	data->poly.clear();
+	data->homography.release();
+	data->warped.release();
+	extractTargetFace(data, smoothing, dilate, threshold);
+	cache->storeExtraction(key, {data->poly, data->homography, data->warped});
+	return false;
+}
+
+std::vector<double> fitTargetModelPoseCached(ResultCache *cache,
+	const cv::Mat &camera_image,
+	const std::vector<cv::Point2f> &quad,
+	FitCostEngine engine,
+	const LensCalibration &lens) {
+	const std::string key = poseKey(contentHash(camera_image), {quad, engine, lensHash(lens)});
+	std::vector<double> pose;
+	if (cache->loadPose(key, &pose)) {
+		return pose;
+	}
+	pose = fit_target_model_pose(camera_image, quad, engine, lens);
+	cache->storePose(key, pose);
+	return pose;
+}
@@ -0,0 +1,89 @@
+#ifndef _CACHE_H
+#define _CACHE_H
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "lens.h"
+#include "target.h"
+#include "target_model.h"
+
+// Stage parameters which, together with the image content, determine the
+// result of loadAndPreprocessInput and extractTargetFace.
+struct ExtractionParameters {
+	cv::Size target_size;
+	int scaled_input_size;
+	int smoothing;
+	int dilate;
+	int threshold;
+	bool warp_from_original = false;
+	// lensHash of the calibration the face is undistorted with, 0 for none.
+	uint64_t lens_hash = 0;
+};
+
+// Parameters which, together with the image content and
+// FIT_MODEL_REVISION, determine the result of fit_target_model_pose.
+struct FitParameters {
+	std::vector<cv::Point2f> quad;
+	FitCostEngine engine = FitCostEngine::SAMPLED;
+	uint64_t lens_hash = 0;
+};
+
+struct CachedExtraction {
+	std::vector<cv::Point> poly;
+	cv::Mat homography;
+	cv::Mat warped;
+};
+
+// Persistent content-addressed cache of extraction and fit results. Every
+// entry is an OpenCV YAML file named by its key, warped faces are stored
+// as lossless PNG next to it. Entries are spread over 256 subdirectories
+// so that large archives do not end up in a single directory.
+class ResultCache {
+ private:
+	std::string directory;
+	bool store_warped;
+
+	std::string entryPath(const std::string &key, const std::string &suffix) const;
+
+ public:
+	explicit ResultCache(const std::string &directory, bool store_warped = true);
+
+	bool loadExtraction(const std::string &key, CachedExtraction *entry) const;
+	void storeExtraction(const std::string &key, const CachedExtraction &entry) const;
+
+	bool loadPose(const std::string &key, std::vector<double> *pose) const;
+	void storePose(const std::string &key, const std::vector<double> &pose) const;
+};
+
+// 64-bit FNV-1a hash of raw bytes and of image pixels.
+uint64_t contentHash(const std::vector<uchar> &bytes);
+uint64_t contentHash(const cv::Mat &image);
+// Hash of the camera matrix, distortion coefficients and image size, 0 for
+// an empty calibration.
+uint64_t lensHash(const LensCalibration &lens);
+
+std::string extractionKey(uint64_t content_hash, const ExtractionParameters &parameters);
+std::string poseKey(uint64_t content_hash, const FitParameters &parameters = FitParameters());
+
+// Cached counterpart of loadAndPreprocessInput followed by extractTargetFace.
+// On a hit the stored quad, homography and warped face are restored and the
+// image is decoded only when the warped face was not stored. Returns true on
+// cache hit.
+bool extractTargetFaceCached(ResultCache *cache,
+	TargetExtractorData *data,
+	const std::string &filename,
+	int smoothing, int dilate, int threshold);
+
+// Cached counterpart of fit_target_model_pose.
+std::vector<double> fitTargetModelPoseCached(ResultCache *cache,
+	const cv::Mat &camera_image,
+	const std::vector<cv::Point2f> &quad = {},
+	FitCostEngine engine = FitCostEngine::SAMPLED,
+	const LensCalibration &lens = LensCalibration());
+
+#endif  // _CACHE_H
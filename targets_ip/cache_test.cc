@@ -0,0 +1,120 @@
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE CacheTest
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "cache.h"
+#include "target.h"
+
+namespace fs = boost::filesystem;
+
+const char *target_image_0001 = "../testdata/img0001_scaled.jpg";
+
+struct TemporaryDirectory {
+	fs::path path;
+	TemporaryDirectory()
+		: path(fs::temp_directory_path() / fs::unique_path("targets_cache_%%%%%%%%")) {
+	}
+	~TemporaryDirectory() { fs::remove_all(path); }
+};
+
+BOOST_AUTO_TEST_CASE(test_keys_depend_on_content_and_parameters) {
+	const ExtractionParameters parameters{cv::Size(256, 256), 256, 3, 3, 240};
+	ExtractionParameters other_threshold = parameters;
+	other_threshold.threshold = 200;
+
+	const uint64_t hash_a = contentHash(std::vector<uchar>{1, 2, 3});
+	const uint64_t hash_b = contentHash(std::vector<uchar>{1, 2, 4});
+	BOOST_CHECK_NE(hash_a, hash_b);
+	BOOST_CHECK_EQUAL(extractionKey(hash_a, parameters), extractionKey(hash_a, parameters));
+	BOOST_CHECK_NE(extractionKey(hash_a, parameters), extractionKey(hash_b, parameters));
+	BOOST_CHECK_NE(extractionKey(hash_a, parameters), extractionKey(hash_a, other_threshold));
+	BOOST_CHECK_NE(extractionKey(hash_a, parameters), poseKey(hash_a));
+}
+
+BOOST_AUTO_TEST_CASE(test_keys_depend_on_lens_and_fit) {
+	LensCalibration lens;
+	lens.camera_matrix = cv::Matx33d(300, 0, 160, 0, 300, 120, 0, 0, 1);
+	lens.distortion = (cv::Mat_<double>(1, 5) << -0.3, 0.1, 0, 0, 0);
+	lens.image_size = cv::Size(320, 240);
+	LensCalibration other_lens = lens;
+	other_lens.distortion = (cv::Mat_<double>(1, 5) << -0.2, 0.1, 0, 0, 0);
+	BOOST_CHECK_EQUAL(lensHash(LensCalibration()), 0);
+	BOOST_CHECK_NE(lensHash(lens), lensHash(other_lens));
+
+	ExtractionParameters parameters{cv::Size(256, 256), 256, 3, 3, 240};
+	ExtractionParameters undistorted = parameters;
+	undistorted.lens_hash = lensHash(lens);
+	ExtractionParameters other_undistorted = parameters;
+	other_undistorted.lens_hash = lensHash(other_lens);
+	BOOST_CHECK_NE(extractionKey(1, parameters), extractionKey(1, undistorted));
+	BOOST_CHECK_NE(extractionKey(1, undistorted), extractionKey(1, other_undistorted));
+
+	FitParameters fit;
+	FitParameters seeded;
+	seeded.quad = {{10, 10}, {50, 12}, {48, 60}, {8, 55}};
+	FitParameters template_cost;
+	template_cost.engine = FitCostEngine::TEMPLATE;
+	FitParameters calibrated;
+	calibrated.lens_hash = lensHash(lens);
+	for (const FitParameters &other : {seeded, template_cost, calibrated}) {
+		BOOST_CHECK_NE(poseKey(1, fit), poseKey(1, other));
+	}
+	BOOST_CHECK_NE(poseKey(1, fit).find("_r" + std::to_string(FIT_MODEL_REVISION)),
+		std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_store_and_load_extraction) {
+	TemporaryDirectory directory;
+	ResultCache cache(directory.path.string());
+
+	CachedExtraction stored;
+	stored.poly = {{1, 2}, {3, 4}, {5, 6}, {7, 8}};
+	stored.homography = cv::Mat::eye(3, 3, CV_64F);
+	stored.warped = cv::Mat(16, 16, CV_8UC1, cv::Scalar(42));
+
+	const std::string key = extractionKey(123, {cv::Size(16, 16), 256, 3, 3, 240});
+	CachedExtraction loaded;
+	BOOST_CHECK(!cache.loadExtraction(key, &loaded));
+	cache.storeExtraction(key, stored);
+	BOOST_REQUIRE(cache.loadExtraction(key, &loaded));
+
+	BOOST_CHECK(loaded.poly == stored.poly);
+	BOOST_CHECK_EQUAL(cv::norm(loaded.homography, stored.homography), 0.0);
+	BOOST_CHECK_EQUAL(cv::norm(loaded.warped, stored.warped), 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_store_and_load_pose) {
+	TemporaryDirectory directory;
+	ResultCache cache(directory.path.string());
+
+	const std::vector<double> stored{1, 2, 300, 0.1, 0.2, 0.3};
+	std::vector<double> loaded;
+	cache.storePose(poseKey(7), stored);
+	BOOST_REQUIRE(cache.loadPose(poseKey(7), &loaded));
+	BOOST_CHECK(loaded == stored);
+}
+
+BOOST_AUTO_TEST_CASE(test_cached_extraction_matches_uncached) {
+	TemporaryDirectory directory;
+	ResultCache cache(directory.path.string(), false);
+
+	TargetExtractorData first(cv::Size(256, 256), 256);
+	BOOST_CHECK(!extractTargetFaceCached(&cache, &first, target_image_0001, 3, 3, 240));
+
+	TargetExtractorData second(cv::Size(256, 256), 256);
+	BOOST_CHECK(extractTargetFaceCached(&cache, &second, target_image_0001, 3, 3, 240));
+
+	BOOST_CHECK(first.poly == second.poly);
+	BOOST_CHECK_EQUAL(first.warped.empty(), second.warped.empty());
+	if (!first.warped.empty()) {
+		BOOST_CHECK_EQUAL(cv::norm(first.warped, second.warped), 0.0);
+	}
+}
@@ -0,0 +1,484 @@
+#include "daemon.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "result_log.h"
+#include "target.h"
+#include "utils.h"
+
+bool sendAll(int fd, const void *data, size_t size) {
+	const uint8_t *bytes = static_cast<const uint8_t*>(data);
+	while (size) {
+		const ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR) {
+			continue;
+		}
+		if (sent <= 0) {
+			return false;
+		}
+		bytes += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+bool receiveAll(int fd, void *data, size_t size) {
+	uint8_t *bytes = static_cast<uint8_t*>(data);
+	while (size) {
+		const ssize_t received = recv(fd, bytes, size, 0);
+		if (received < 0 && errno == EINTR) {
+			continue;
+		}
+		if (received <= 0) {
+			return false;
+		}
+		bytes += received;
+		size -= received;
+	}
+	return true;
+}
+
+// A client with this much unsent output is not read from until it catches up.
+const size_t MAX_CLIENT_OUTPUT = 4 << 20;
+
+sockaddr_un socketAddress(const std::string &socket_path) {
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (socket_path.size() >= sizeof(address.sun_path)) {
+		std::cerr << "Socket path too long: " << socket_path << "\n";
+		abort();
+	}
+	std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+	return address;
+}
+
+// Set while the thread copies from a client mapping.
+thread_local sigjmp_buf *shared_copy_guard = nullptr;
+
+void sharedCopyFault(int number) {
+	if (shared_copy_guard) {
+		siglongjmp(*shared_copy_guard, 1);
+	}
+	// Not a truncated client object, fail as usual.
+	signal(number, SIG_DFL);
+	raise(number);
+}
+
+bool copySharedFrame(const cv::Mat &shared, cv::Mat *frame) {
+	static std::once_flag installed;
+	std::call_once(installed, [] {
+		struct sigaction action{};
+		action.sa_handler = sharedCopyFault;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGBUS, &action, nullptr);
+	});
+
+	frame->create(shared.rows, shared.cols, shared.type());
+	const size_t row_bytes = shared.cols * shared.elemSize();
+	sigjmp_buf guard;
+	if (sigsetjmp(guard, 1)) {
+		shared_copy_guard = nullptr;
+		return false;
+	}
+	shared_copy_guard = &guard;
+	for (int y = 0; y < shared.rows; y++) {
+		std::memcpy(frame->ptr(y), shared.ptr(y), row_bytes);
+	}
+	shared_copy_guard = nullptr;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+
+FrameDaemon::FrameDaemon(const DaemonOptions &options)
+	: options(options),
+	pool(options.workers, options.pin_threads),
+	stopping(false),
+	processed_frames(0) {
+	listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0) {
+		std::cerr << "Could not create socket: " << std::strerror(errno) << "\n";
+		abort();
+	}
+	const sockaddr_un address = socketAddress(options.socket_path);
+	unlink(options.socket_path.c_str());
+	if (bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+		listen(listen_fd, 64) != 0) {
+		std::cerr << "Could not listen on " << options.socket_path << ": "
+			<< std::strerror(errno) << "\n";
+		abort();
+	}
+	wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wake_fd < 0) {
+		std::cerr << "Could not create eventfd: " << std::strerror(errno) << "\n";
+		abort();
+	}
+	for (int i = 0; i < std::max(options.max_batch, 1); i++) {
+		slots.push_back(std::make_unique<TargetExtractorData>(
+			options.target_size, options.scaled_input_size));
+		slots.back()->lens = options.lens;
+	}
+}
+
+FrameDaemon::~FrameDaemon() {
+	for (const auto &client : clients) {
+		close(client.fd);
+	}
+	for (const auto &mapping : mappings) {
+		munmap(const_cast<uint8_t*>(mapping.second.address), mapping.second.size);
+	}
+	close(listen_fd);
+	close(wake_fd);
+	unlink(options.socket_path.c_str());
+}
+
+void FrameDaemon::stop() {
+	stopping = true;
+	const uint64_t one = 1;
+	(void)!write(wake_fd, &one, sizeof(one));
+}
+
+void FrameDaemon::acceptClient() {
+	const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (fd >= 0) {
+		clients.push_back({fd, {}, {}});
+	}
+}
+
+FrameDaemon::Client *FrameDaemon::findClient(int fd) {
+	auto it = std::find_if(clients.begin(), clients.end(),
+		[fd](const Client &client) { return client.fd == fd; });
+	return it == clients.end() ? nullptr : &*it;
+}
+
+bool FrameDaemon::readClient(Client *client) {
+	uint8_t chunk[16 * sizeof(FrameRequest)];
+	const ssize_t received = recv(client->fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+	if (received < 0) {
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	}
+	if (received == 0) {
+		return false;
+	}
+	client->buffer.insert(client->buffer.end(), chunk, chunk + received);
+
+	size_t consumed = 0;
+	while (client->buffer.size() - consumed >= sizeof(FrameRequest)) {
+		Pending request{client->fd, {}};
+		std::memcpy(&request.request, client->buffer.data() + consumed, sizeof(FrameRequest));
+		if (request.request.magic != FRAME_REQUEST_MAGIC) {
+			return false;
+		}
+		pending.push_back(request);
+		consumed += sizeof(FrameRequest);
+	}
+	client->buffer.erase(client->buffer.begin(), client->buffer.begin() + consumed);
+	return true;
+}
+
+bool FrameDaemon::writeClient(Client *client) {
+	size_t written = 0;
+	while (written < client->output.size()) {
+		const ssize_t sent = send(client->fd, client->output.data() + written,
+			client->output.size() - written, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR) {
+			continue;
+		}
+		if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		}
+		if (sent <= 0) {
+			return false;
+		}
+		written += sent;
+	}
+	client->output.erase(client->output.begin(), client->output.begin() + written);
+	return true;
+}
+
+bool FrameDaemon::mapFrame(const FrameRequest &request, cv::Mat *frame) {
+	if (request.shm_name[sizeof(request.shm_name) - 1] != 0 ||
+		request.type != CV_8UC3 || request.rows <= 0 || request.cols <= 0 ||
+		request.step < static_cast<uint64_t>(request.cols) * 3) {
+		return false;
+	}
+	// Checked without forming offset + span, which a request can overflow.
+	const uint64_t span = static_cast<uint64_t>(request.rows - 1) * request.step +
+		static_cast<uint64_t>(request.cols) * 3;
+
+	// The object is reopened per request, a client may have replaced it
+	// under the same name; the mapping is reused while it is the same object.
+	const std::string name(request.shm_name);
+	const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat stat_buffer;
+	if (fstat(fd, &stat_buffer) != 0 || stat_buffer.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+	auto it = mappings.find(name);
+	if (it != mappings.end() &&
+		(it->second.inode != stat_buffer.st_ino ||
+			it->second.size != static_cast<size_t>(stat_buffer.st_size))) {
+		munmap(const_cast<uint8_t*>(it->second.address), it->second.size);
+		mappings.erase(it);
+		it = mappings.end();
+	}
+	if (it == mappings.end()) {
+		void *address = mmap(nullptr, stat_buffer.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (address == MAP_FAILED) {
+			close(fd);
+			return false;
+		}
+		it = mappings.emplace(name, Mapping{static_cast<const uint8_t*>(address),
+			static_cast<size_t>(stat_buffer.st_size), stat_buffer.st_ino}).first;
+	}
+	close(fd);
+	if (request.offset > it->second.size || it->second.size - request.offset < span) {
+		return false;
+	}
+	*frame = cv::Mat(request.rows, request.cols, request.type,
+		const_cast<uint8_t*>(it->second.address + request.offset), request.step);
+	return true;
+}
+
+void FrameDaemon::processBatch() {
+	const size_t count = std::min(pending.size(), slots.size());
+	std::vector<cv::Mat> frames(count);
+	std::vector<uint32_t> status(count, REPLY_OK);
+	for (size_t i = 0; i < count; i++) {
+		if (!mapFrame(pending[i].request, &frames[i])) {
+			status[i] = REPLY_INVALID_FRAME;
+		}
+	}
+
+	std::vector<std::vector<uint8_t>> records(count);
+	parallelFor(&pool, count, [&](int i) {
+		if (status[i] != REPLY_OK) {
+			return;
+		}
+		TargetExtractorData *data = slots[i].get();
+		Stopwatch stopwatch;
+		float stage_ms[STAGE_COUNT] = {};
+		// The slot keeps its copy buffer, the client may shrink its object
+		// at any time.
+		if (!copySharedFrame(frames[i], &data->img)) {
+			status[i] = REPLY_INVALID_FRAME;
+			return;
+		}
+		preprocessInput(data);
+		stage_ms[STAGE_PREPROCESS] = stopwatch.lap();
+
+		data->poly.clear();
+		data->homography.release();
+		data->warped.release();
+		extractTargetFace(data, options.smoothing, options.dilate, options.threshold);
+		stage_ms[STAGE_EXTRACT] = stopwatch.lap();
+
+		data->lines.clear();
+		if (data->poly.size() == 4 && !data->homography.empty()) {
+			detectArrows(data, options.canny1, options.canny2, options.hough);
+			stage_ms[STAGE_DETECT] = stopwatch.lap();
+		}
+
+		FrameResult result = makeFrameResult(*data, pending[i].request.request_id,
+			pending[i].request.capture_timestamp_us);
+		std::copy(std::begin(stage_ms), std::end(stage_ms), result.stage_ms);
+		records[i] = encodeFrameResult(result);
+	});
+
+	processed_frames += count;
+	for (size_t i = 0; i < count; i++) {
+		Client *client = findClient(pending[i].client_fd);
+		if (!client) {
+			continue;
+		}
+		const FrameReplyHeader header{FRAME_REPLY_MAGIC, status[i],
+			pending[i].request.request_id, static_cast<uint32_t>(records[i].size()), 0};
+		const uint8_t *header_bytes = reinterpret_cast<const uint8_t*>(&header);
+		client->output.insert(client->output.end(), header_bytes, header_bytes + sizeof(header));
+		client->output.insert(client->output.end(), records[i].begin(), records[i].end());
+	}
+	pending.erase(pending.begin(), pending.begin() + count);
+
+	// Whatever does not fit the sockets now is written on POLLOUT. A failed
+	// send means the client went away, it is dropped on its next poll.
+	for (auto &client : clients) {
+		if (!client.output.empty() && !writeClient(&client)) {
+			client.output.clear();
+		}
+	}
+}
+
+void FrameDaemon::run() {
+	std::vector<pollfd> fds;
+	while (!stopping) {
+		fds.clear();
+		fds.push_back({listen_fd, POLLIN, 0});
+		fds.push_back({wake_fd, POLLIN, 0});
+		for (const auto &client : clients) {
+			short events = 0;
+			if (client.output.size() < MAX_CLIENT_OUTPUT) {
+				events |= POLLIN;
+			}
+			if (!client.output.empty()) {
+				events |= POLLOUT;
+			}
+			fds.push_back({client.fd, events, 0});
+		}
+		if (poll(fds.data(), fds.size(), -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			std::cerr << "poll failed: " << std::strerror(errno) << "\n";
+			abort();
+		}
+		if (stopping) {
+			break;
+		}
+
+		// Gather every request which arrived since the last round.
+		std::vector<int> closed;
+		for (size_t i = 2; i < fds.size(); i++) {
+			Client *client = &clients[i - 2];
+			if (((fds[i].revents & POLLOUT) && !writeClient(client)) ||
+				((fds[i].revents & ~POLLOUT) && !readClient(client))) {
+				closed.push_back(client->fd);
+			}
+		}
+		for (int fd : closed) {
+			pending.erase(std::remove_if(pending.begin(), pending.end(),
+				[fd](const Pending &request) { return request.client_fd == fd; }), pending.end());
+			clients.erase(std::remove_if(clients.begin(), clients.end(),
+				[fd](const Client &client) { return client.fd == fd; }), clients.end());
+			close(fd);
+		}
+		if (fds[0].revents & POLLIN) {
+			acceptClient();
+		}
+
+		while (!pending.empty()) {
+			processBatch();
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+
+SharedFrameBuffer::SharedFrameBuffer(const std::string &name, size_t capacity)
+	: name(name), address(nullptr), capacity(capacity) {
+	const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+	if (fd < 0 || ftruncate(fd, capacity) != 0) {
+		std::cerr << "Could not create shared memory " << name << ": "
+			<< std::strerror(errno) << "\n";
+		abort();
+	}
+	void *mapping = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		std::cerr << "Could not map shared memory " << name << "\n";
+		abort();
+	}
+	address = static_cast<uint8_t*>(mapping);
+}
+
+SharedFrameBuffer::~SharedFrameBuffer() {
+	munmap(address, capacity);
+	shm_unlink(name.c_str());
+}
+
+cv::Mat SharedFrameBuffer::frame(int rows, int cols, int type, size_t offset) {
+	if (offset + static_cast<size_t>(rows) * cols * CV_ELEM_SIZE(type) > capacity) {
+		std::cerr << "Frame does not fit shared memory " << name << "\n";
+		abort();
+	}
+	return cv::Mat(rows, cols, type, address + offset);
+}
+
+DaemonClient::DaemonClient(const std::string &socket_path)
+	: next_request_id(0) {
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	const sockaddr_un address = socketAddress(socket_path);
+	if (fd < 0 ||
+		connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+		std::cerr << "Could not connect to " << socket_path << ": "
+			<< std::strerror(errno) << "\n";
+		abort();
+	}
+}
+
+DaemonClient::~DaemonClient() {
+	close(fd);
+}
+
+uint64_t DaemonClient::submit(const SharedFrameBuffer &buffer, const cv::Mat &frame,
+	int64_t capture_timestamp_us) {
+	const uint8_t *begin = buffer.data();
+	if (frame.data < begin || frame.dataend > begin + buffer.size()) {
+		std::cerr << "Frame is not in shared memory " << buffer.shmName() << "\n";
+		abort();
+	}
+	FrameRequest request{};
+	request.magic = FRAME_REQUEST_MAGIC;
+	request.request_id = next_request_id++;
+	request.capture_timestamp_us = capture_timestamp_us;
+	std::strncpy(request.shm_name, buffer.shmName().c_str(), sizeof(request.shm_name) - 1);
+	request.offset = frame.data - begin;
+	request.rows = frame.rows;
+	request.cols = frame.cols;
+	request.type = frame.type();
+	request.step = frame.step[0];
+	if (!sendAll(fd, &request, sizeof(request))) {
+		std::cerr << "Could not send frame request\n";
+		abort();
+	}
+	return request.request_id;
+}
+
+bool DaemonClient::receive(FrameResult *result, uint64_t *request_id) {
+	FrameReplyHeader header;
+	if (!receiveAll(fd, &header, sizeof(header)) || header.magic != FRAME_REPLY_MAGIC) {
+		std::cerr << "Invalid frame reply\n";
+		abort();
+	}
+	std::vector<uint8_t> record(header.size);
+	if (!receiveAll(fd, record.data(), record.size())) {
+		std::cerr << "Truncated frame reply\n";
+		abort();
+	}
+	if (request_id) {
+		*request_id = header.request_id;
+	}
+	if (header.status != REPLY_OK) {
+		return false;
+	}
+	*result = decodeFrameResult(record.data(), record.size());
+	return true;
+}
+
+bool DaemonClient::process(const SharedFrameBuffer &buffer, const cv::Mat &frame,
+	FrameResult *result) {
+	submit(buffer, frame);
+	return receive(result);
+}
@@ -0,0 +1,174 @@
+#ifndef _DAEMON_H
+#define _DAEMON_H
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "lens.h"
+#include "result_log.h"
+#include "target.h"
+#include "thread_pool.h"
+
+const uint32_t FRAME_REQUEST_MAGIC = 0x52465054;  // "TPFR"
+const uint32_t FRAME_REPLY_MAGIC = 0x50525054;  // "TPRP"
+
+// Sent by a client over the socket. The frame is rows x cols of OpenCV
+// type with step bytes per row, stored at offset in the named POSIX shared
+// memory object. It must stay unchanged until the reply arrives. The
+// daemon copies each frame out of the mapping before processing it, under a
+// SIGBUS guard: a client which shrinks its object while a request is in
+// flight gets REPLY_INVALID_FRAME instead of taking the daemon down.
+struct FrameRequest {
+	uint32_t magic;
+	uint32_t reserved;
+	uint64_t request_id;
+	int64_t capture_timestamp_us;
+	char shm_name[64];
+	uint64_t offset;
+	int32_t rows;
+	int32_t cols;
+	int32_t type;
+	uint32_t step;
+};
+static_assert(sizeof(FrameRequest) == 112, "unexpected frame request layout");
+
+enum FrameReplyStatus : uint32_t {
+	REPLY_OK = 0,
+	REPLY_INVALID_FRAME = 1
+};
+
+// Followed by size bytes of encodeFrameResult record.
+struct FrameReplyHeader {
+	uint32_t magic;
+	uint32_t status;
+	uint64_t request_id;
+	uint32_t size;
+	uint32_t reserved;
+};
+static_assert(sizeof(FrameReplyHeader) == 24, "unexpected frame reply layout");
+
+struct DaemonOptions {
+	std::string socket_path;
+	int workers = 4;
+	bool pin_threads = false;
+	int max_batch = 16;
+	cv::Size target_size{256, 256};
+	int scaled_input_size = 256;
+	// Given to every batch slot, frames are undistorted with it if set.
+	LensCalibration lens;
+	int smoothing = 3;
+	int dilate = 3;
+	int threshold = 240;
+	int canny1 = 50;
+	int canny2 = 200;
+	int hough = 50;
+};
+
+// Long running frame processing server on a Unix domain socket. One thread
+// polls the listening socket and all clients, requests which arrived from
+// any client since the last round are processed as one batch on the pool
+// and answered in arrival order. Replies are queued per client and written
+// without blocking as its socket drains, so a client which does not read
+// them delays no other client. Shared memory objects stay mapped between
+// requests and every batch slot keeps its extraction buffers.
+class FrameDaemon {
+ private:
+	struct Client {
+		int fd;
+		std::vector<uint8_t> buffer;
+		std::vector<uint8_t> output;
+	};
+	struct Mapping {
+		const uint8_t *address;
+		size_t size;
+		uint64_t inode;
+	};
+	struct Pending {
+		int client_fd;
+		FrameRequest request;
+	};
+
+	DaemonOptions options;
+	int listen_fd;
+	int wake_fd;
+	std::vector<Client> clients;
+	std::vector<Pending> pending;
+	std::map<std::string, Mapping> mappings;
+	std::vector<std::unique_ptr<TargetExtractorData>> slots;
+	WorkStealingPool pool;
+	std::atomic<bool> stopping;
+	std::atomic<uint64_t> processed_frames;
+
+	void acceptClient();
+	Client *findClient(int fd);
+	bool readClient(Client *client);
+	bool writeClient(Client *client);
+	bool mapFrame(const FrameRequest &request, cv::Mat *frame);
+	void processBatch();
+
+ public:
+	explicit FrameDaemon(const DaemonOptions &options);
+	FrameDaemon(const FrameDaemon&) = delete;
+	FrameDaemon &operator=(const FrameDaemon&) = delete;
+	~FrameDaemon();
+
+	// Serves until stop is called.
+	void run();
+	// Safe to call from other threads and signal handlers.
+	void stop();
+	uint64_t processed() const { return processed_frames; }
+};
+
+// Copies a frame out of memory shared with a client, false if the pages
+// vanished under the copy because the client shrank the object.
+bool copySharedFrame(const cv::Mat &shared, cv::Mat *frame);
+
+// Client owned shared memory object frames are written to. The object is
+// unlinked on destruction.
+class SharedFrameBuffer {
+ private:
+	std::string name;
+	uint8_t *address;
+	size_t capacity;
+
+ public:
+	SharedFrameBuffer(const std::string &name, size_t capacity);
+	SharedFrameBuffer(const SharedFrameBuffer&) = delete;
+	SharedFrameBuffer &operator=(const SharedFrameBuffer&) = delete;
+	~SharedFrameBuffer();
+
+	// Header over the buffer at offset, capture or decode straight into it.
+	cv::Mat frame(int rows, int cols, int type, size_t offset = 0);
+	const std::string &shmName() const { return name; }
+	const uint8_t *data() const { return address; }
+	size_t size() const { return capacity; }
+};
+
+class DaemonClient {
+ private:
+	int fd;
+	uint64_t next_request_id;
+
+ public:
+	explicit DaemonClient(const std::string &socket_path);
+	DaemonClient(const DaemonClient&) = delete;
+	DaemonClient &operator=(const DaemonClient&) = delete;
+	~DaemonClient();
+
+	// Sends a frame living in buffer, returns its request id. Several
+	// frames may be in flight, replies come in submission order.
+	uint64_t submit(const SharedFrameBuffer &buffer, const cv::Mat &frame,
+		int64_t capture_timestamp_us = 0);
+	// Blocks for the next reply, returns false on an invalid frame.
+	bool receive(FrameResult *result, uint64_t *request_id = nullptr);
+	bool process(const SharedFrameBuffer &buffer, const cv::Mat &frame, FrameResult *result);
+};
+
+#endif  // _DAEMON_H
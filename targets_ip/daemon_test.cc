@@ -0,0 +1,224 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE DaemonTest
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "daemon.h"
+#include "result_log.h"
+#include "synthetic.h"
+#include "target.h"
+
+namespace fs = boost::filesystem;
+
+struct DaemonFixture {
+	std::string socket_path;
+	DaemonOptions options;
+	std::unique_ptr<FrameDaemon> daemon;
+	std::thread server;
+
+	DaemonFixture() {
+		socket_path = (fs::temp_directory_path() / fs::unique_path("targets_ip_%%%%%%.sock")).string();
+		options.socket_path = socket_path;
+		options.workers = 2;
+		options.max_batch = 4;
+		daemon = std::make_unique<FrameDaemon>(options);
+		server = std::thread([this]() { daemon->run(); });
+	}
+
+	~DaemonFixture() {
+		daemon->stop();
+		server.join();
+	}
+};
+
+std::string shmName(const std::string &suffix) {
+	return "/targets_ip_test_" + std::to_string(getpid()) + "_" + suffix;
+}
+
+cv::Mat syntheticImage(uint64 seed) {
+	SyntheticTargetRenderer renderer(512, seed);
+	cv::RNG rng(seed);
+	return renderer.render(randomSyntheticScene(&rng, cv::Size(320, 240), 2)).image;
+}
+
+FrameResult localResult(const cv::Mat &image, const DaemonOptions &options) {
+	TargetExtractorData data(options.target_size, options.scaled_input_size);
+	data.img = image;
+	preprocessInput(&data);
+	extractTargetFace(&data, options.smoothing, options.dilate, options.threshold);
+	if (data.poly.size() == 4) {
+		detectArrows(&data, options.canny1, options.canny2, options.hough);
+	}
+	return makeFrameResult(data, 0, 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_frame_is_processed_from_shared_memory, DaemonFixture) {
+	const cv::Mat image = syntheticImage(1);
+	SharedFrameBuffer buffer(shmName("single"), image.total() * image.elemSize());
+	cv::Mat frame = buffer.frame(image.rows, image.cols, image.type());
+	image.copyTo(frame);
+
+	DaemonClient client(socket_path);
+	FrameResult result;
+	BOOST_REQUIRE(client.process(buffer, frame, &result));
+
+	const FrameResult expected = localResult(image, options);
+	BOOST_REQUIRE_EQUAL(result.quad.size(), 4);
+	BOOST_CHECK(result.quad == expected.quad);
+	BOOST_CHECK(result.segments == expected.segments);
+	BOOST_CHECK_EQUAL(daemon->processed(), 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_concurrent_clients_get_their_replies, DaemonFixture) {
+	const int frames_per_client = 6;
+	std::vector<std::thread> clients;
+	std::vector<int> received(3, 0);
+	for (int c = 0; c < 3; c++) {
+		clients.emplace_back([this, c, &received]() {
+			const cv::Mat image = syntheticImage(10 + c);
+			const size_t frame_size = image.total() * image.elemSize();
+			SharedFrameBuffer buffer(shmName("client" + std::to_string(c)),
+				frame_size * frames_per_client);
+			DaemonClient client(socket_path);
+			for (int i = 0; i < frames_per_client; i++) {
+				cv::Mat frame = buffer.frame(image.rows, image.cols, image.type(), i * frame_size);
+				image.copyTo(frame);
+				client.submit(buffer, frame, i);
+			}
+			for (int i = 0; i < frames_per_client; i++) {
+				FrameResult result;
+				uint64_t request_id;
+				if (client.receive(&result, &request_id) &&
+					request_id == static_cast<uint64_t>(i) &&
+					result.capture_timestamp_us == i &&
+					result.quad.size() == 4) {
+					received[c]++;
+				}
+			}
+		});
+	}
+	for (auto &client : clients) {
+		client.join();
+	}
+	for (int count : received) {
+		BOOST_CHECK_EQUAL(count, frames_per_client);
+	}
+	BOOST_CHECK_EQUAL(daemon->processed(), 3 * frames_per_client);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_invalid_frame_is_rejected, DaemonFixture) {
+	SharedFrameBuffer buffer(shmName("gray"), 64 * 64);
+	cv::Mat frame = buffer.frame(64, 64, CV_8UC1);
+	frame.setTo(0);
+
+	DaemonClient client(socket_path);
+	FrameResult result;
+	BOOST_CHECK(!client.process(buffer, frame, &result));
+
+	// The connection stays usable.
+	BOOST_CHECK(!client.process(buffer, frame, &result));
+}
+
+BOOST_FIXTURE_TEST_CASE(test_overflowing_offset_is_rejected, DaemonFixture) {
+	SharedFrameBuffer buffer(shmName("overflow"), 64 * 64 * 3);
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+	BOOST_REQUIRE_EQUAL(connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)), 0);
+
+	// offset + span wraps around to a small size.
+	FrameRequest request{};
+	request.magic = FRAME_REQUEST_MAGIC;
+	std::strncpy(request.shm_name, buffer.shmName().c_str(), sizeof(request.shm_name) - 1);
+	request.rows = 64;
+	request.cols = 64;
+	request.type = CV_8UC3;
+	request.step = 64 * 3;
+	request.offset = std::numeric_limits<uint64_t>::max() - 100;
+	BOOST_REQUIRE_EQUAL(send(fd, &request, sizeof(request), 0), sizeof(request));
+
+	FrameReplyHeader header;
+	BOOST_REQUIRE_EQUAL(recv(fd, &header, sizeof(header), MSG_WAITALL), sizeof(header));
+	BOOST_CHECK_EQUAL(header.magic, FRAME_REPLY_MAGIC);
+	BOOST_CHECK_EQUAL(header.status, REPLY_INVALID_FRAME);
+	close(fd);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_client_not_reading_replies_does_not_block_others, DaemonFixture) {
+	SharedFrameBuffer stalled_buffer(shmName("stalled"), 16 * 16 * 3);
+	cv::Mat stalled_frame = stalled_buffer.frame(16, 16, CV_8UC3);
+	stalled_frame.setTo(0);
+	// Far more replies than fit the socket buffers, none of them read.
+	DaemonClient stalled(socket_path);
+	for (int i = 0; i < 2000; i++) {
+		stalled.submit(stalled_buffer, stalled_frame);
+	}
+
+	const cv::Mat image = syntheticImage(1);
+	SharedFrameBuffer buffer(shmName("served"), image.total() * image.elemSize());
+	cv::Mat frame = buffer.frame(image.rows, image.cols, image.type());
+	image.copyTo(frame);
+	DaemonClient client(socket_path);
+	FrameResult result;
+	BOOST_REQUIRE(client.process(buffer, frame, &result));
+	BOOST_CHECK_EQUAL(result.quad.size(), 4);
+}
+
+void shrinkSharedMemory(const SharedFrameBuffer &buffer, size_t size) {
+	const int fd = shm_open(buffer.shmName().c_str(), O_RDWR, 0);
+	BOOST_REQUIRE_GE(fd, 0);
+	BOOST_REQUIRE_EQUAL(ftruncate(fd, size), 0);
+	close(fd);
+}
+
+BOOST_AUTO_TEST_CASE(test_copy_from_shrunk_object_fails) {
+	SharedFrameBuffer buffer(shmName("copy"), 64 * 64 * 3);
+	cv::Mat frame = buffer.frame(64, 64, CV_8UC3);
+	frame.setTo(cv::Scalar(1, 2, 3));
+	cv::Mat copy;
+	BOOST_REQUIRE(copySharedFrame(frame, &copy));
+	BOOST_CHECK_EQUAL(cv::norm(copy, frame, cv::NORM_INF), 0.0);
+
+	// The mapping stays, its pages are gone.
+	shrinkSharedMemory(buffer, 0);
+	BOOST_CHECK(!copySharedFrame(frame, &copy));
+}
+
+BOOST_FIXTURE_TEST_CASE(test_shrunk_shared_memory_is_rejected, DaemonFixture) {
+	const cv::Mat image = syntheticImage(1);
+	SharedFrameBuffer buffer(shmName("shrunk"), image.total() * image.elemSize());
+	cv::Mat frame = buffer.frame(image.rows, image.cols, image.type());
+	image.copyTo(frame);
+	DaemonClient client(socket_path);
+	FrameResult result;
+	BOOST_REQUIRE(client.process(buffer, frame, &result));
+
+	shrinkSharedMemory(buffer, 4096);
+	BOOST_CHECK(!client.process(buffer, frame, &result));
+
+	// The daemon survived and serves others.
+	SharedFrameBuffer other_buffer(shmName("other"), image.total() * image.elemSize());
+	cv::Mat other_frame = other_buffer.frame(image.rows, image.cols, image.type());
+	image.copyTo(other_frame);
+	DaemonClient other(socket_path);
+	BOOST_REQUIRE(other.process(other_buffer, other_frame, &result));
+	BOOST_CHECK_EQUAL(result.quad.size(), 4);
+}
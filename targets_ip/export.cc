@@ -0,0 +1,159 @@
+#include "export.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include "annotations.h"
+#include "io.h"
+#include "target.h"
+#include "tfrecord.h"
+
+namespace fs = boost::filesystem;
+
+std::string shardFilename(const std::string &prefix, int shard, int shards) {
+	char suffix[32];
+	std::snprintf(suffix, sizeof(suffix), "-%05d-of-%05d", shard, shards);
+	return prefix + suffix;
+}
+
+// Annotated box in source image coordinates, or empty for shapes which do
+// not describe an object.
+std::vector<cv::Point2f> annotatedBox(const AnnotatedShape &shape, int point_to_rect) {
+	if (shape.shape_type == "point" && !shape.points.empty()) {
+		const cv::Point2f point = shape.points[0];
+		const cv::Point2f offset(point_to_rect, point_to_rect);
+		return {point - offset, point + offset};
+	}
+	if (shape.shape_type == "rectangle" && shape.points.size() == 2) {
+		return shape.points;
+	}
+	return {};
+}
+
+// Expects the annotated image in data->img.
+bool createFaceExample(const Annotation &annotation,
+	const std::map<std::string, int> &label_map,
+	const ExportOptions &options,
+	TargetExtractorData *data,
+	TFExample *example) {
+	preprocessInput(data);
+	data->poly.clear();
+	data->homography.release();
+	extractTargetFace(data, options.smoothing, options.dilate, options.threshold);
+	if (data->homography.empty()) {
+		return false;
+	}
+
+	const float scale = data->img_resized.cols / static_cast<float>(data->img.cols);
+	const cv::Rect2f face(0, 0, data->target_size.width, data->target_size.height);
+	std::vector<float> xmins, xmaxs, ymins, ymaxs;
+	std::vector<std::string> classes_text;
+	std::vector<int64_t> classes;
+	for (const auto &shape : annotation.shapes) {
+		const auto label = label_map.find(shape.label);
+		const std::vector<cv::Point2f> box = annotatedBox(shape, options.point_to_rect);
+		if (label == label_map.end() || box.empty()) {
+			continue;
+		}
+		const cv::Point2f min_corner(std::min(box[0].x, box[1].x), std::min(box[0].y, box[1].y));
+		const cv::Point2f max_corner(std::max(box[0].x, box[1].x), std::max(box[0].y, box[1].y));
+		const std::vector<cv::Point2f> corners{
+			min_corner * scale,
+			cv::Point2f(max_corner.x, min_corner.y) * scale,
+			max_corner * scale,
+			cv::Point2f(min_corner.x, max_corner.y) * scale};
+		std::vector<cv::Point2f> face_corners;
+		cv::perspectiveTransform(corners, face_corners, data->homography);
+
+		const cv::Rect2f face_box = cv::boundingRect(face_corners) & cv::Rect(face);
+		if (face_box.area() <= 0) {
+			continue;
+		}
+		xmins.push_back(face_box.x / face.width);
+		xmaxs.push_back((face_box.x + face_box.width) / face.width);
+		ymins.push_back(face_box.y / face.height);
+		ymaxs.push_back((face_box.y + face_box.height) / face.height);
+		classes_text.push_back(shape.label);
+		classes.push_back(label->second);
+	}
+
+	std::vector<uchar> encoded;
+	cv::imencode(".png", data->warped, encoded);
+	const std::string filename = fs::path(annotation.image_path).filename().string();
+
+	example->addInt64s("image/height", {data->warped.rows});
+	example->addInt64s("image/width", {data->warped.cols});
+	example->addBytes("image/filename", {filename});
+	example->addBytes("image/source_id", {filename});
+	example->addBytes("image/encoded", {std::string(encoded.begin(), encoded.end())});
+	example->addBytes("image/format", {"png"});
+	example->addFloats("image/object/bbox/xmin", xmins);
+	example->addFloats("image/object/bbox/xmax", xmaxs);
+	example->addFloats("image/object/bbox/ymin", ymins);
+	example->addFloats("image/object/bbox/ymax", ymaxs);
+	example->addBytes("image/object/class/text", classes_text);
+	example->addInt64s("image/object/class/label", classes);
+	return true;
+}
+
+ExportSummary exportTFRecords(const ExportOptions &options) {
+	const std::vector<std::string> annotations = listAnnotations(options.annotation_dir);
+	const std::map<std::string, int> label_map = loadLabelMap(options.label_map_file);
+
+	std::atomic<int> next_shard{0};
+	std::atomic<int> examples{0};
+	std::atomic<int> skipped{0};
+	std::atomic<int> unreadable{0};
+	auto worker = [&]() {
+		TargetExtractorData data(options.target_size, options.scaled_input_size);
+		for (int shard = next_shard++; shard < options.shards; shard = next_shard++) {
+			TFRecordWriter writer(shardFilename(options.output_prefix, shard, options.shards));
+			for (size_t i = shard; i < annotations.size(); i += options.shards) {
+				const Annotation annotation = loadAnnotation(annotations[i]);
+				data.img = cv::imread(annotation.image_path);
+				if (data.img.empty()) {
+					std::cerr << "Could not read image " << annotation.image_path << std::endl;
+					unreadable++;
+					continue;
+				}
+				TFExample example;
+				if (createFaceExample(annotation, label_map, options, &data, &example)) {
+					writer.write(example.serialize());
+					examples++;
+				} else {
+					std::cerr << "No target face found in " << annotations[i] << std::endl;
+					skipped++;
+				}
+			}
+			if (!writer.good()) {
+				std::cerr << "Could not write shard " << shard << std::endl;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < std::max(1, std::min(options.workers, options.shards)); i++) {
+		threads.emplace_back(worker);
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	ExportSummary summary;
+	summary.examples = examples;
+	summary.skipped = skipped;
+	summary.unreadable = unreadable;
+	return summary;
+}
@@ -0,0 +1,41 @@
+#ifndef _EXPORT_H
+#define _EXPORT_H
+#pragma once
+
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+struct ExportOptions {
+	std::string annotation_dir;
+	std::string output_prefix;
+	std::string label_map_file;
+	int shards = 16;
+	int workers = 4;
+	cv::Size target_size{256, 256};
+	int scaled_input_size = 256;
+	int smoothing = 3;
+	int dilate = 3;
+	int threshold = 240;
+	int point_to_rect = 15;  // half size of boxes around point annotations
+};
+
+struct ExportSummary {
+	int examples = 0;
+	int skipped = 0;  // no target face found
+	int unreadable = 0;  // image could not be read
+};
+
+// TensorFlow shard naming, prefix-00003-of-00016.
+std::string shardFilename(const std::string &prefix, int shard, int shards);
+
+// Extracts and rectifies the target face of every labelme annotated image
+// and writes the faces with their boxes mapped into face coordinates as
+// tf.train.Example records with the features used by
+// targets_tf/generate_tfrecord.py. Images are distributed round-robin over
+// the shards and each shard is produced by a single worker, so shards are
+// written in parallel without any locking. Images which cannot be read are
+// reported and counted, the export goes on without them.
+ExportSummary exportTFRecords(const ExportOptions &options);
+
+#endif  // _EXPORT_H
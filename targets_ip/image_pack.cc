@@ -0,0 +1,210 @@
+#include "image_pack.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include "annotations.h"
+#include "io.h"
+
+namespace fs = boost::filesystem;
+
+const char PACK_MAGIC[8] = {'T', 'G', 'T', 'S', 'P', 'A', 'C', 'K'};
+const uint32_t PACK_VERSION = 1;
+const uint64_t PACK_ALIGNMENT = 64;
+
+struct PackHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t count;
+	uint64_t index_offset;
+	uint64_t strings_offset;
+	uint64_t strings_size;
+	uint8_t padding[16];
+};
+static_assert(sizeof(PackHeader) == 64, "unexpected pack header layout");
+
+static_assert(sizeof(PackIndexEntry) == 40, "unexpected pack index layout");
+
+namespace {
+
+void writePadding(std::ofstream *file, uint64_t *offset) {
+	static const char zeros[PACK_ALIGNMENT] = {};
+	const uint64_t padding = (PACK_ALIGNMENT - *offset % PACK_ALIGNMENT) % PACK_ALIGNMENT;
+	file->write(zeros, padding);
+	*offset += padding;
+}
+
+}  // namespace
+
+ImagePackWriter::ImagePackWriter(const std::string &filename)
+	: file(filename, std::ios::binary | std::ios::trunc), offset(sizeof(PackHeader)) {
+	if (!file) {
+		std::cerr << "Could not create image pack " << filename << std::endl;
+		abort();
+	}
+	// Placeholder until finish.
+	const PackHeader header{};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void ImagePackWriter::add(const std::string &name, const std::vector<uchar> &bytes,
+	const std::string &label, cv::Size image_size) {
+	if (image_size.area() == 0) {
+		image_size = decodeImage(bytes).size();
+	}
+	writePadding(&file, &offset);
+	file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+
+	index.push_back({offset, bytes.size(), strings.size(),
+		static_cast<uint32_t>(name.size()), static_cast<uint32_t>(label.size()),
+		static_cast<uint32_t>(image_size.width), static_cast<uint32_t>(image_size.height)});
+	offset += bytes.size();
+	strings += name;
+	strings += label;
+}
+
+bool ImagePackWriter::finish() {
+	writePadding(&file, &offset);
+	PackHeader header{};
+	std::memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+	header.version = PACK_VERSION;
+	header.count = index.size();
+	header.index_offset = offset;
+	header.strings_offset = offset + index.size() * sizeof(PackIndexEntry);
+	header.strings_size = strings.size();
+
+	file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(PackIndexEntry));
+	file.write(strings.data(), strings.size());
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.flush();
+	return file.good();
+}
+
+//-----------------------------------------------------------------------------
+
+ImagePackReader::ImagePackReader(const std::string &filename)
+	: fd(-1), mapping(nullptr), mapping_size(0) {
+	fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		std::cerr << "Could not open image pack " << filename << std::endl;
+		abort();
+	}
+	struct stat file_stat;
+	fstat(fd, &file_stat);
+	mapping_size = file_stat.st_size;
+	if (mapping_size < sizeof(PackHeader)) {
+		std::cerr << "Not an image pack " << filename << std::endl;
+		abort();
+	}
+	void *file_mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (file_mapping == MAP_FAILED) {
+		std::cerr << "Could not map image pack " << filename << std::endl;
+		abort();
+	}
+	mapping = static_cast<const uint8_t*>(file_mapping);
+
+	PackHeader header;
+	std::memcpy(&header, mapping, sizeof(header));
+	if (std::memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 ||
+		header.version != PACK_VERSION ||
+		header.index_offset + header.count * sizeof(PackIndexEntry) > mapping_size ||
+		header.strings_offset + header.strings_size > mapping_size) {
+		std::cerr << "Not an image pack " << filename << std::endl;
+		abort();
+	}
+
+	const char *strings = reinterpret_cast<const char*>(mapping + header.strings_offset);
+	entries.reserve(header.count);
+	for (uint64_t i = 0; i < header.count; i++) {
+		PackIndexEntry index;
+		std::memcpy(&index, mapping + header.index_offset + i * sizeof(PackIndexEntry), sizeof(index));
+		if (index.offset + index.size > header.index_offset ||
+			index.name_offset + index.name_size + index.label_size > header.strings_size) {
+			std::cerr << "Corrupt image pack " << filename << std::endl;
+			abort();
+		}
+		const char *name = strings + index.name_offset;
+		entries.push_back({std::string(name, index.name_size),
+			std::string(name + index.name_size, index.label_size),
+			cv::Size(index.width, index.height),
+			mapping + index.offset,
+			index.size});
+	}
+	// Batch runs read the images front to back.
+	madvise(const_cast<uint8_t*>(mapping), mapping_size, MADV_SEQUENTIAL);
+}
+
+ImagePackReader::~ImagePackReader() {
+	munmap(const_cast<uint8_t*>(mapping), mapping_size);
+	close(fd);
+}
+
+cv::Mat ImagePackReader::decode(size_t index, int flags) const {
+	const PackEntry &packed = entries[index];
+	const cv::Mat bytes(1, static_cast<int>(packed.size), CV_8UC1,
+		const_cast<uchar*>(packed.bytes));
+	cv::Mat image = cv::imdecode(bytes, flags);
+	if (!image.data) {
+		std::cerr << "Could not decode " << packed.name << std::endl;
+		abort();
+	}
+	return image;
+}
+
+//-----------------------------------------------------------------------------
+
+bool isImageFile(const std::string &filename) {
+	std::string extension = fs::path(filename).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == ".jpg" || extension == ".jpeg" || extension == ".png" ||
+		extension == ".bmp" || extension == ".tif" || extension == ".tiff";
+}
+
+int packDirectory(const std::string &directory, const std::string &filename) {
+	ImagePackWriter writer(filename);
+	int images = 0;
+	const std::vector<std::string> annotations = listAnnotations(directory);
+	if (!annotations.empty()) {
+		for (const auto &annotation_file : annotations) {
+			const Annotation annotation = loadAnnotation(annotation_file);
+			const std::vector<uchar> json = loadFileBytes(annotation_file);
+			writer.add(fs::path(annotation.image_path).filename().string(),
+				loadFileBytes(annotation.image_path),
+				std::string(json.begin(), json.end()),
+				annotation.image_size);
+			images++;
+		}
+	} else {
+		std::vector<std::string> image_files;
+		for (const auto &entry : fs::directory_iterator(directory)) {
+			if (isImageFile(entry.path().string())) {
+				image_files.push_back(entry.path().string());
+			}
+		}
+		std::sort(image_files.begin(), image_files.end());
+		for (const auto &image_file : image_files) {
+			writer.add(fs::path(image_file).filename().string(), loadFileBytes(image_file));
+			images++;
+		}
+	}
+	if (!writer.finish()) {
+		std::cerr << "Could not write image pack " << filename << std::endl;
+		abort();
+	}
+	return images;
+}
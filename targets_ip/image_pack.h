@@ -0,0 +1,85 @@
+#ifndef _IMAGE_PACK_H
+#define _IMAGE_PACK_H
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+// Many compressed images in one file. A fixed header is followed by the
+// encoded images, each starting on a 64 byte boundary, then an index of
+// fixed size entries and a string table with the name and label of every
+// image. The label is free text, for annotated datasets the labelme JSON
+// of the image. Numbers are stored in host (little-endian) byte order.
+
+struct PackEntry {
+	std::string name;
+	std::string label;
+	cv::Size image_size;
+	const uchar *bytes;  // encoded image inside the mapping
+	size_t size;
+};
+
+// On-disk index entry.
+struct PackIndexEntry {
+	uint64_t offset;
+	uint64_t size;
+	uint64_t name_offset;  // into the string table, label follows the name
+	uint32_t name_size;
+	uint32_t label_size;
+	uint32_t width;
+	uint32_t height;
+};
+
+class ImagePackWriter {
+ private:
+	std::ofstream file;
+	uint64_t offset;
+	std::vector<PackIndexEntry> index;
+	std::string strings;
+
+ public:
+	explicit ImagePackWriter(const std::string &filename);
+	ImagePackWriter(const ImagePackWriter&) = delete;
+	ImagePackWriter &operator=(const ImagePackWriter&) = delete;
+
+	// bytes is an encoded image, its size is read from the decoded image
+	// when image_size is empty.
+	void add(const std::string &name, const std::vector<uchar> &bytes,
+		const std::string &label = "", cv::Size image_size = cv::Size());
+	// Writes the index and header, the pack is unreadable before.
+	bool finish();
+};
+
+// Memory mapped pack. Entries point into the mapping, decoding reads the
+// mapped bytes without copying them.
+class ImagePackReader {
+ private:
+	int fd;
+	const uint8_t *mapping;
+	size_t mapping_size;
+	std::vector<PackEntry> entries;
+
+ public:
+	explicit ImagePackReader(const std::string &filename);
+	ImagePackReader(const ImagePackReader&) = delete;
+	ImagePackReader &operator=(const ImagePackReader&) = delete;
+	~ImagePackReader();
+
+	size_t size() const { return entries.size(); }
+	const PackEntry &entry(size_t index) const { return entries[index]; }
+	cv::Mat decode(size_t index, int flags = cv::IMREAD_COLOR) const;
+};
+
+bool isImageFile(const std::string &filename);
+
+// Packs the images of a labelme annotated directory with the annotations
+// as labels, or every image file of the directory without labels. Returns
+// the number of packed images.
+int packDirectory(const std::string &directory, const std::string &filename);
+
+#endif  // _IMAGE_PACK_H
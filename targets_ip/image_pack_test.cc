@@ -0,0 +1,62 @@
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE ImagePackTest
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "annotations.h"
+#include "image_pack.h"
+
+const std::string PACK_FILE = "/tmp/targets_ip_image_pack_test.pack";
+
+std::vector<uchar> encodedImage(cv::Size size, int seed, cv::Mat *image) {
+	*image = cv::Mat(size, CV_8UC3);
+	cv::RNG(seed).fill(*image, cv::RNG::UNIFORM, 0, 256);
+	std::vector<uchar> bytes;
+	cv::imencode(".png", *image, bytes);
+	return bytes;
+}
+
+BOOST_AUTO_TEST_CASE(test_pack_round_trip) {
+	cv::Mat first, second;
+	const std::vector<uchar> first_bytes = encodedImage(cv::Size(33, 21), 1, &first);
+	const std::vector<uchar> second_bytes = encodedImage(cv::Size(16, 40), 2, &second);
+	{
+		ImagePackWriter writer(PACK_FILE);
+		writer.add("first.png", first_bytes);
+		writer.add("second.png", second_bytes, "label");
+		BOOST_REQUIRE(writer.finish());
+	}
+
+	const ImagePackReader pack(PACK_FILE);
+	BOOST_REQUIRE_EQUAL(pack.size(), 2);
+	BOOST_CHECK_EQUAL(pack.entry(0).name, "first.png");
+	BOOST_CHECK_EQUAL(pack.entry(0).label, "");
+	BOOST_CHECK_EQUAL(pack.entry(0).image_size, cv::Size(33, 21));
+	BOOST_CHECK_EQUAL(pack.entry(1).name, "second.png");
+	BOOST_CHECK_EQUAL(pack.entry(1).label, "label");
+	BOOST_CHECK_EQUAL(pack.entry(1).image_size, cv::Size(16, 40));
+	BOOST_CHECK_EQUAL(pack.entry(1).size, second_bytes.size());
+	BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(pack.entry(1).bytes) % 64, 0);
+
+	BOOST_CHECK_EQUAL(cv::norm(pack.decode(0), first, cv::NORM_INF), 0);
+	BOOST_CHECK_EQUAL(cv::norm(pack.decode(1), second, cv::NORM_INF), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_parse_packed_annotation) {
+	const std::string json = R"({"imagePath": "a.jpg", "imageWidth": 640, "imageHeight": 480,
+		"shapes": [{"label": "hit", "shape_type": "point", "points": [[10.5, 20]]}]})";
+	const Annotation annotation = parseAnnotation(json, "data");
+	BOOST_CHECK_EQUAL(annotation.image_path, "data/a.jpg");
+	BOOST_CHECK_EQUAL(annotation.image_size, cv::Size(640, 480));
+	BOOST_REQUIRE_EQUAL(annotation.shapes.size(), 1);
+	BOOST_CHECK_EQUAL(annotation.shapes[0].label, "hit");
+	BOOST_CHECK_CLOSE(annotation.shapes[0].points[0].x, 10.5, 0.0001);
+}
@@ -1,7 +1,10 @@
 #include "io.h"
 
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <string>
+#include <vector>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -22,6 +25,25 @@ cv::Mat loadImage(const std::string &filename) {
 	return image;
 }
 
+std::vector<uchar> loadFileBytes(const std::string &filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) {
+		std::cerr << "Could not open or find the file " << filename << std::endl;
+		abort();
+	}
+	return std::vector<uchar>(std::istreambuf_iterator<char>(file),
+		std::istreambuf_iterator<char>());
+}
+
+cv::Mat decodeImage(const std::vector<uchar> &bytes) {
+	cv::Mat image = cv::imdecode(bytes, cv::IMREAD_COLOR);
+	if (!image.data) {
+		std::cerr <<  "Could not decode the image" << std::endl;
+		abort();
+	}
+	return image;
+}
+
 void storeImage(const cv::Mat &mat, const std::string &filename) {
 	cv::imwrite(filename, mat);
 }
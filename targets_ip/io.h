@@ -10,6 +10,8 @@
 
 void drawLines(cv::Mat color_image, std::vector<cv::Vec2f> lines, std::string filename);
 cv::Mat loadImage(const std::string &filename);
+std::vector<uchar> loadFileBytes(const std::string &filename);
+cv::Mat decodeImage(const std::vector<uchar> &bytes);
 void storeImage(const cv::Mat &mat, const std::string &filename);
 
 #endif
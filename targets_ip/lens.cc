@@ -0,0 +1,149 @@
+#include "lens.h"
+
+#include <string>
+#include <vector>
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+bool LensCalibration::empty() const {
+	return distortion.empty() || cv::countNonZero(distortion) == 0;
+}
+
+LensCalibration LensCalibration::scaled(cv::Size size) const {
+	if (image_size.area() == 0 || size == image_size) {
+		return *this;
+	}
+	const double scale_x = size.width / static_cast<double>(image_size.width);
+	const double scale_y = size.height / static_cast<double>(image_size.height);
+	LensCalibration lens = *this;
+	lens.camera_matrix = cv::Matx33d(
+		scale_x, 0, 0,
+		0, scale_y, 0,
+		0, 0, 1) * camera_matrix;
+	lens.image_size = size;
+	return lens;
+}
+
+bool loadLensCalibration(const std::string &filename, LensCalibration *lens) {
+	cv::FileStorage storage(filename, cv::FileStorage::READ);
+	if (!storage.isOpened()) {
+		return false;
+	}
+	cv::Mat camera_matrix;
+	storage["camera_matrix"] >> camera_matrix;
+	storage["distortion_coefficients"] >> lens->distortion;
+	if (camera_matrix.size() != cv::Size(3, 3)) {
+		return false;
+	}
+	camera_matrix.convertTo(camera_matrix, CV_64F);
+	lens->camera_matrix = cv::Matx33d(camera_matrix);
+	lens->distortion.convertTo(lens->distortion, CV_64F);
+	lens->distortion = lens->distortion.reshape(1, 1);
+	lens->image_size = cv::Size(
+		static_cast<int>(storage["image_width"]), static_cast<int>(storage["image_height"]));
+	return true;
+}
+
+void storeLensCalibration(const std::string &filename, const LensCalibration &lens) {
+	cv::FileStorage storage(filename, cv::FileStorage::WRITE);
+	storage << "image_width" << lens.image_size.width;
+	storage << "image_height" << lens.image_size.height;
+	storage << "camera_matrix" << cv::Mat(lens.camera_matrix);
+	storage << "distortion_coefficients" << lens.distortion;
+}
+
+std::vector<cv::Point2f> undistortImagePoints(const LensCalibration &lens,
+	const std::vector<cv::Point2f> &points) {
+	if (lens.empty() || points.empty()) {
+		return points;
+	}
+	std::vector<cv::Point2f> undistorted;
+	const cv::Mat camera_matrix(lens.camera_matrix);
+	cv::undistortPoints(points, undistorted, camera_matrix, lens.distortion,
+		cv::noArray(), camera_matrix);
+	return undistorted;
+}
+
+std::vector<cv::Point2f> distortImagePoints(const LensCalibration &lens,
+	const std::vector<cv::Point2f> &points) {
+	if (lens.empty() || points.empty()) {
+		return points;
+	}
+	const cv::Matx33d inverse = lens.camera_matrix.inv();
+	std::vector<cv::Point3f> rays;
+	rays.reserve(points.size());
+	for (const auto &point : points) {
+		const cv::Vec3d ray = inverse * cv::Vec3d(point.x, point.y, 1);
+		rays.emplace_back(ray[0] / ray[2], ray[1] / ray[2], 1);
+	}
+	std::vector<cv::Point2f> distorted;
+	cv::projectPoints(rays, cv::Vec3d(), cv::Vec3d(), cv::Mat(lens.camera_matrix),
+		lens.distortion, distorted);
+	return distorted;
+}
+
+DistortionMap buildDistortionMap(const LensCalibration &lens, cv::Size image_size) {
+	const LensCalibration scaled = lens.scaled(image_size);
+	const int width = image_size.width;
+	const int height = image_size.height;
+
+	// Undistorted footprint of the image border, the lattice is its
+	// bounding box. Strong barrel distortion stretches the corners far out,
+	// so the box is limited to three times the image.
+	const int border_steps = 32;
+	std::vector<cv::Point2f> border;
+	for (int i = 0; i <= border_steps; i++) {
+		const float x = width * i / static_cast<float>(border_steps);
+		const float y = height * i / static_cast<float>(border_steps);
+		border.insert(border.end(), {{x, 0}, {x, static_cast<float>(height)},
+			{0, y}, {static_cast<float>(width), y}});
+	}
+	const cv::Rect limit(-width, -height, 3 * width, 3 * height);
+	const cv::Rect footprint = cv::boundingRect(undistortImagePoints(scaled, border));
+	const cv::Rect domain = (footprint + cv::Size(4, 4) - cv::Point(2, 2)) & limit;
+
+	const cv::Matx33d &camera = scaled.camera_matrix;
+	const cv::Matx33d inverse = camera.inv();
+	std::vector<cv::Point3f> rays;
+	rays.reserve(domain.area());
+	for (int y = 0; y < domain.height; y++) {
+		for (int x = 0; x < domain.width; x++) {
+			const cv::Vec3d ray = inverse * cv::Vec3d(domain.x + x, domain.y + y, 1);
+			rays.emplace_back(ray[0] / ray[2], ray[1] / ray[2], 1);
+		}
+	}
+	std::vector<cv::Point2f> sources;
+	cv::projectPoints(rays, cv::Vec3d(), cv::Vec3d(), cv::Mat(camera), scaled.distortion, sources);
+
+	DistortionMap distortion;
+	distortion.map = cv::Mat(domain.size(), CV_32FC2, sources.data()).clone();
+	distortion.origin = cv::Point2d(domain.x, domain.y);
+	distortion.image_size = image_size;
+	return distortion;
+}
+
+void composeFaceRemap(const DistortionMap &distortion, const cv::Mat &homography,
+	cv::Size face_size, cv::Mat *map1, cv::Mat *map2) {
+	cv::Mat face_homography;
+	homography.convertTo(face_homography, CV_64F);
+	// Lattice index to undistorted image coordinates, then to the face.
+	const cv::Matx33d lattice_to_image(
+		1, 0, distortion.origin.x,
+		0, 1, distortion.origin.y,
+		0, 0, 1);
+	const cv::Mat lattice_to_face = face_homography * cv::Mat(lattice_to_image);
+
+	// Face pixels outside the lattice sample outside the image.
+	cv::Mat map;
+	cv::warpPerspective(distortion.map, map, lattice_to_face, face_size,
+		cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar(-1, -1));
+	cv::convertMaps(map, cv::noArray(), *map1, *map2, CV_16SC2);
+}
+
+void buildFaceRemap(const LensCalibration &lens, const cv::Mat &homography,
+	cv::Size face_size, cv::Mat *map1, cv::Mat *map2) {
+	composeFaceRemap(buildDistortionMap(lens, lens.image_size), homography, face_size,
+		map1, map2);
+}
@@ -0,0 +1,62 @@
+#ifndef _LENS_H
+#define _LENS_H
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// Calibrated camera lens, as written by the OpenCV calibration sample:
+// camera_matrix, distortion_coefficients (k1, k2, p1, p2[, k3]),
+// image_width and image_height.
+struct LensCalibration {
+	cv::Matx33d camera_matrix = cv::Matx33d::eye();
+	cv::Mat distortion;
+	cv::Size image_size;
+
+	// No distortion to correct.
+	bool empty() const;
+	// The calibration of the same lens for images resized to size.
+	LensCalibration scaled(cv::Size size) const;
+};
+
+bool loadLensCalibration(const std::string &filename, LensCalibration *lens);
+void storeLensCalibration(const std::string &filename, const LensCalibration &lens);
+
+// Ideal pinhole coordinates of distorted image points.
+std::vector<cv::Point2f> undistortImagePoints(const LensCalibration &lens,
+	const std::vector<cv::Point2f> &points);
+// Distorted image points of ideal pinhole coordinates, the inverse of
+// undistortImagePoints.
+std::vector<cv::Point2f> distortImagePoints(const LensCalibration &lens,
+	const std::vector<cv::Point2f> &points);
+
+// Distorted image position of every undistorted pixel of an image:
+// map(y, x) (CV_32FC2) is the distortion of the undistorted point
+// origin + (x, y). The lattice covers the undistortion of the whole image.
+struct DistortionMap {
+	cv::Mat map;
+	cv::Point2d origin;
+	cv::Size image_size;
+
+	bool empty() const { return map.empty(); }
+};
+
+// Distortion map of the lens for images of image_size. It only depends on
+// the calibration, so it is built once and composed with every homography.
+DistortionMap buildDistortionMap(const LensCalibration &lens, cv::Size image_size);
+
+// Remap table of the face rectification of a distorted image: face pixel
+// (x, y) samples the distorted image at the distortion of
+// homography^-1 * (x, y), the homography mapping undistorted image
+// coordinates to the face. The table is a single perspective warp of the
+// distortion map, undistortion and warp are then a single cv::remap of the
+// fixed point (CV_16SC2, CV_16UC1) maps.
+void composeFaceRemap(const DistortionMap &distortion, const cv::Mat &homography,
+	cv::Size face_size, cv::Mat *map1, cv::Mat *map2);
+// composeFaceRemap with the distortion map of images of lens.image_size.
+void buildFaceRemap(const LensCalibration &lens, const cv::Mat &homography,
+	cv::Size face_size, cv::Mat *map1, cv::Mat *map2);
+
+#endif  // _LENS_H
@@ -0,0 +1,98 @@
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LensTest
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "lens.h"
+
+LensCalibration testLens() {
+	LensCalibration lens;
+	lens.camera_matrix = cv::Matx33d(
+		300, 0, 160,
+		0, 300, 120,
+		0, 0, 1);
+	lens.distortion = (cv::Mat_<double>(1, 5) << -0.3, 0.1, 0, 0, 0);
+	lens.image_size = cv::Size(320, 240);
+	return lens;
+}
+
+BOOST_AUTO_TEST_CASE(test_scaled_calibration) {
+	const LensCalibration half = testLens().scaled(cv::Size(160, 120));
+	BOOST_CHECK_CLOSE(half.camera_matrix(0, 0), 150.0, 0.0001);
+	BOOST_CHECK_CLOSE(half.camera_matrix(1, 2), 60.0, 0.0001);
+	BOOST_CHECK(!half.empty());
+	BOOST_CHECK(LensCalibration().empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_store_and_load) {
+	const std::string filename = "/tmp/targets_ip_lens_test.yml";
+	storeLensCalibration(filename, testLens());
+	LensCalibration lens;
+	BOOST_REQUIRE(loadLensCalibration(filename, &lens));
+	BOOST_CHECK_EQUAL(lens.image_size, cv::Size(320, 240));
+	BOOST_CHECK_CLOSE(lens.camera_matrix(0, 2), 160.0, 0.0001);
+	BOOST_CHECK_CLOSE(lens.distortion.at<double>(0), -0.3, 0.0001);
+	BOOST_CHECK(!loadLensCalibration("/tmp/targets_ip_missing_lens.yml", &lens));
+}
+
+BOOST_AUTO_TEST_CASE(test_face_remap_matches_undistort_and_warp) {
+	const LensCalibration lens = testLens();
+	cv::Mat image(lens.image_size, CV_8UC1);
+	cv::RNG(3).fill(image, cv::RNG::UNIFORM, 0, 256);
+	cv::GaussianBlur(image, image, cv::Size(9, 9), 3);
+
+	const cv::Size face_size(64, 64);
+	const cv::Mat homography = cv::getPerspectiveTransform(
+		std::vector<cv::Point2f>{{100, 70}, {220, 80}, {210, 170}, {90, 160}},
+		std::vector<cv::Point2f>{{0, 0}, {64, 0}, {64, 64}, {0, 64}});
+
+	cv::Mat map1, map2, remapped;
+	buildFaceRemap(lens, homography, face_size, &map1, &map2);
+	BOOST_CHECK_EQUAL(map1.type(), CV_16SC2);
+	cv::remap(image, remapped, map1, map2, cv::INTER_LINEAR);
+
+	cv::Mat undistorted, warped;
+	cv::undistort(image, undistorted, cv::Mat(lens.camera_matrix), lens.distortion);
+	cv::warpPerspective(undistorted, warped, homography, face_size, cv::INTER_LINEAR);
+
+	// Two resamplings against one, compare away from the face border.
+	const cv::Rect inner(4, 4, 56, 56);
+	BOOST_CHECK_LT(cv::norm(remapped(inner), warped(inner), cv::NORM_L1) / inner.area(), 3.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_undistort_points_round_trip) {
+	const LensCalibration lens = testLens();
+	const std::vector<cv::Point2f> points{{20, 30}, {300, 200}, {160, 120}};
+	const std::vector<cv::Point2f> undistorted = undistortImagePoints(lens, points);
+	const std::vector<cv::Point2f> distorted = distortImagePoints(lens, undistorted);
+	for (size_t i = 0; i < points.size(); i++) {
+		BOOST_CHECK_SMALL(cv::norm(distorted[i] - points[i]), 0.1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_distortion_map_covers_image) {
+	const LensCalibration lens = testLens();
+	const DistortionMap distortion = buildDistortionMap(lens, cv::Size(160, 120));
+	BOOST_CHECK_EQUAL(distortion.image_size, cv::Size(160, 120));
+
+	// Image corners undistort outside the image under barrel distortion, the
+	// map takes them back to the corners.
+	const LensCalibration half = lens.scaled(cv::Size(160, 120));
+	const std::vector<cv::Point2f> corners{{0, 0}, {159, 119}};
+	const std::vector<cv::Point2f> undistorted = undistortImagePoints(half, corners);
+	for (size_t i = 0; i < corners.size(); i++) {
+		const cv::Point2f lattice = undistorted[i] - cv::Point2f(distortion.origin);
+		BOOST_REQUIRE(cv::Rect(0, 0, distortion.map.cols - 1, distortion.map.rows - 1)
+			.contains(lattice));
+		cv::Mat sample;
+		cv::getRectSubPix(distortion.map, cv::Size(1, 1), lattice, sample);
+		BOOST_CHECK_SMALL(cv::norm(sample.at<cv::Point2f>(0) - corners[i]), 0.05);
+	}
+}
@@ -0,0 +1,198 @@
+#include "line_detector.h"
+
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#if __has_include(<opencv2/ximgproc.hpp>)
+#include <opencv2/ximgproc.hpp>
+#define HAVE_XIMGPROC
+#endif
+
+#define OPENCV_VERSION_AT_LEAST(major, minor, revision) \
+	(CV_VERSION_MAJOR > (major) || (CV_VERSION_MAJOR == (major) && \
+		(CV_VERSION_MINOR > (minor) || \
+			(CV_VERSION_MINOR == (minor) && CV_VERSION_REVISION >= (revision)))))
+
+// LSD was removed for licensing reasons in 3.4.6 and 4.1.0 and restored in
+// 3.4.15 and 4.5.1, 3.4.6 - 3.4.14 and 4.1.0 - 4.5.0 keep only a throwing
+// stub. 4.0.x still has it.
+#if (OPENCV_VERSION_AT_LEAST(3, 0, 0) && !OPENCV_VERSION_AT_LEAST(3, 4, 6)) || \
+	(OPENCV_VERSION_AT_LEAST(3, 4, 15) && !OPENCV_VERSION_AT_LEAST(4, 1, 0)) || \
+	OPENCV_VERSION_AT_LEAST(4, 5, 1)
+#define HAVE_LSD
+#endif
+
+// EdgeDrawing was added to ximgproc in opencv_contrib 4.5.2, which is
+// released together with the core of the same version.
+#if defined(HAVE_XIMGPROC) && OPENCV_VERSION_AT_LEAST(4, 5, 2)
+#define HAVE_EDGE_DRAWING
+#endif
+
+#include "target.h"
+#include "trace.h"
+
+bool insideMask(const cv::Mat &mask, float x, float y) {
+	const int col = cvRound(x);
+	const int row = cvRound(y);
+	if (row < 0 || row >= mask.rows || col < 0 || col >= mask.cols) {
+		return false;
+	}
+	return mask.at<uchar>(row, col) != 0;
+}
+
+// Keeps long enough float segments inside the mask.
+void filterSegments(const std::vector<cv::Vec4f> &segments, const cv::Mat &mask,
+	int min_length, std::vector<cv::Vec4i> *lines) {
+	lines->clear();
+	for (const auto &segment : segments) {
+		const float length = std::hypot(segment[2] - segment[0], segment[3] - segment[1]);
+		if (length < min_length ||
+			!insideMask(mask, segment[0], segment[1]) ||
+			!insideMask(mask, segment[2], segment[3])) {
+			continue;
+		}
+		lines->push_back(cv::Vec4i(cvRound(segment[0]), cvRound(segment[1]),
+			cvRound(segment[2]), cvRound(segment[3])));
+	}
+}
+
+void HoughLineDetector::detect(const cv::Mat &face, const cv::Mat &mask,
+	std::vector<cv::Vec4i> *lines, cv::Mat *edges) {
+	cv::Canny(face, *edges, parameters.canny1, parameters.canny2, 3);
+	if (!mask.empty()) {
+		cv::bitwise_and(*edges, mask, *edges);
+	}
+	cv::HoughLinesP(*edges, *lines, 1, 0.01, parameters.hough,
+		parameters.min_length, parameters.max_gap);
+}
+
+#ifdef HAVE_LSD
+// Line segment detector (von Gioi et al.), no edge map or accumulator.
+class LsdLineDetector : public LineDetector {
+	LineDetectorParameters parameters;
+	cv::Ptr<cv::LineSegmentDetector> lsd;
+
+ public:
+	explicit LsdLineDetector(const LineDetectorParameters &parameters)
+		: parameters(parameters),
+		lsd(cv::createLineSegmentDetector(cv::LSD_REFINE_STD)) {
+	}
+	std::string name() const override { return "lsd"; }
+	void detect(const cv::Mat &face, const cv::Mat &mask,
+		std::vector<cv::Vec4i> *lines, cv::Mat *edges) override {
+		std::vector<cv::Vec4f> segments;
+		lsd->detect(face, segments);
+		filterSegments(segments, mask, parameters.min_length, lines);
+		edges->release();
+	}
+};
+#endif
+
+#ifdef HAVE_XIMGPROC
+// Lee et al. fast line detector, Canny thresholds shared with Hough.
+class FastLineDetector : public LineDetector {
+	LineDetectorParameters parameters;
+	cv::Ptr<cv::ximgproc::FastLineDetector> fld;
+
+ public:
+	explicit FastLineDetector(const LineDetectorParameters &parameters)
+		: parameters(parameters),
+		fld(cv::ximgproc::createFastLineDetector(parameters.min_length, 1.414f,
+			parameters.canny1, parameters.canny2, 3, true)) {
+	}
+	std::string name() const override { return "fld"; }
+	void detect(const cv::Mat &face, const cv::Mat &mask,
+		std::vector<cv::Vec4i> *lines, cv::Mat *edges) override {
+		std::vector<cv::Vec4f> segments;
+		fld->detect(face, segments);
+		filterSegments(segments, mask, parameters.min_length, lines);
+		edges->release();
+	}
+};
+#endif
+
+#ifdef HAVE_EDGE_DRAWING
+// Edge drawing, anchors linked into edge chains which are fitted by lines.
+class EdgeDrawingLineDetector : public LineDetector {
+	LineDetectorParameters parameters;
+	cv::Ptr<cv::ximgproc::EdgeDrawing> edge_drawing;
+
+ public:
+	explicit EdgeDrawingLineDetector(const LineDetectorParameters &parameters)
+		: parameters(parameters),
+		edge_drawing(cv::ximgproc::createEdgeDrawing()) {
+		edge_drawing->params.MinLineLength = parameters.min_length;
+	}
+	std::string name() const override { return "edge_drawing"; }
+	void detect(const cv::Mat &face, const cv::Mat &mask,
+		std::vector<cv::Vec4i> *lines, cv::Mat *edges) override {
+		std::vector<cv::Vec4f> segments;
+		edge_drawing->detectEdges(face);
+		edge_drawing->getEdgeImage(*edges);
+		edge_drawing->detectLines(segments);
+		filterSegments(segments, mask, parameters.min_length, lines);
+	}
+};
+#endif
+
+std::vector<std::string> availableLineDetectors() {
+	std::vector<std::string> names{"hough"};
+#ifdef HAVE_LSD
+	names.push_back("lsd");
+#endif
+#ifdef HAVE_XIMGPROC
+	names.push_back("fld");
+#endif
+#ifdef HAVE_EDGE_DRAWING
+	names.push_back("edge_drawing");
+#endif
+	return names;
+}
+
+std::unique_ptr<LineDetector> createLineDetector(const std::string &name,
+	const LineDetectorParameters &parameters) {
+	if (name == "hough") {
+		return std::make_unique<HoughLineDetector>(parameters);
+	}
+#ifdef HAVE_LSD
+	if (name == "lsd") {
+		return std::make_unique<LsdLineDetector>(parameters);
+	}
+#endif
+#ifdef HAVE_XIMGPROC
+	if (name == "fld") {
+		return std::make_unique<FastLineDetector>(parameters);
+	}
+#endif
+#ifdef HAVE_EDGE_DRAWING
+	if (name == "edge_drawing") {
+		return std::make_unique<EdgeDrawingLineDetector>(parameters);
+	}
+#endif
+	std::cerr << "Line detector " << name << " is not available\n";
+	abort();
+}
+
+cv::Mat faceMask(cv::Size size, float margin) {
+	cv::Mat mask = cv::Mat::zeros(size, CV_8UC1);
+	const int border_x = cvRound(size.width * margin);
+	const int border_y = cvRound(size.height * margin);
+	mask(cv::Rect(border_x, border_y,
+		size.width - 2 * border_x, size.height - 2 * border_y)).setTo(255);
+	return mask;
+}
+
+void detectArrows(TargetExtractorData *data, LineDetector *detector) {
+	TRACE_SPAN("detect_arrows");
+	if (data->face_mask.size() != data->warped.size()) {
+		data->face_mask = faceMask(data->warped.size());
+	}
+	detector->detect(data->warped, data->face_mask, &data->lines, &data->warped_edges);
+	drawSegments(data);
+}
@@ -0,0 +1,61 @@
+#ifndef _LINE_DETECTOR_H
+#define _LINE_DETECTOR_H
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "target.h"
+
+struct LineDetectorParameters {
+	int canny1 = 50;
+	int canny2 = 200;
+	int hough = 50;
+	// Segments shorter than this are dropped by every backend.
+	int min_length = 30;
+	int max_gap = 10;
+};
+
+// Line segment detection on the warped target face. Only segments with both
+// end points inside the mask are returned.
+class LineDetector {
+ public:
+	virtual ~LineDetector() = default;
+	virtual std::string name() const = 0;
+	// Backends without an explicit edge map leave edges empty.
+	virtual void detect(const cv::Mat &face, const cv::Mat &mask,
+		std::vector<cv::Vec4i> *lines, cv::Mat *edges) = 0;
+};
+
+// Canny followed by probabilistic Hough transform, the detectArrows path.
+class HoughLineDetector : public LineDetector {
+	LineDetectorParameters parameters;
+
+ public:
+	explicit HoughLineDetector(const LineDetectorParameters &parameters)
+		: parameters(parameters) {
+	}
+	std::string name() const override { return "hough"; }
+	void detect(const cv::Mat &face, const cv::Mat &mask,
+		std::vector<cv::Vec4i> *lines, cv::Mat *edges) override;
+};
+
+// Names accepted by createLineDetector in this build. lsd needs OpenCV
+// outside 3.4.6 - 3.4.14 and 4.1.0 - 4.5.0, fld needs the ximgproc contrib
+// module and edge_drawing ximgproc 4.5.2+.
+std::vector<std::string> availableLineDetectors();
+// Aborts on a name which is unknown or unavailable in this build.
+std::unique_ptr<LineDetector> createLineDetector(const std::string &name,
+	const LineDetectorParameters &parameters);
+
+// Face square without a border of margin times its size, which removes
+// edges of the warp boundary and of the background around the face.
+cv::Mat faceMask(cv::Size size, float margin = 0.03f);
+
+// detectArrows with a chosen backend, restricted to faceMask.
+void detectArrows(TargetExtractorData *data, LineDetector *detector);
+
+#endif  // _LINE_DETECTOR_H
@@ -0,0 +1,67 @@
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LineDetectorTest
+
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "line_detector.h"
+#include "target.h"
+#include "utils.h"
+
+// Face with one arrow shaft and a dark warp border on the left.
+cv::Mat syntheticFace() {
+	cv::Mat face(256, 256, CV_8UC1, cv::Scalar(200));
+	cv::line(face, cv::Point(60, 80), cv::Point(180, 150), cv::Scalar(20), 3);
+	face.colRange(0, 3).setTo(0);
+	return face;
+}
+
+BOOST_AUTO_TEST_CASE(test_face_mask) {
+	const cv::Mat mask = faceMask(cv::Size(200, 100), 0.05f);
+	BOOST_CHECK_EQUAL(mask.at<uchar>(0, 0), 0);
+	BOOST_CHECK_EQUAL(mask.at<uchar>(4, 50), 0);
+	BOOST_CHECK_EQUAL(mask.at<uchar>(50, 9), 0);
+	BOOST_CHECK_EQUAL(mask.at<uchar>(50, 10), 255);
+	BOOST_CHECK_EQUAL(mask.at<uchar>(94, 189), 255);
+	BOOST_CHECK_EQUAL(mask.at<uchar>(95, 189), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_detectors_find_shaft_inside_mask) {
+	const cv::Mat face = syntheticFace();
+	const cv::Mat mask = faceMask(face.size());
+	const cv::Vec2f hit(60, 80), tail(180, 150);
+
+	for (const auto &name : availableLineDetectors()) {
+		BOOST_TEST_CONTEXT(name) {
+			auto detector = createLineDetector(name, LineDetectorParameters());
+			BOOST_CHECK_EQUAL(detector->name(), name);
+
+			std::vector<cv::Vec4i> lines;
+			cv::Mat edges;
+			detector->detect(face, mask, &lines, &edges);
+			BOOST_REQUIRE(!lines.empty());
+			for (const auto &line : lines) {
+				BOOST_CHECK(mask.at<uchar>(line[1], line[0]));
+				BOOST_CHECK(mask.at<uchar>(line[3], line[2]));
+				BOOST_CHECK_LT(pointSegmentDistance(cv::Vec2f(line[0], line[1]), hit, tail), 4.0f);
+				BOOST_CHECK_LT(pointSegmentDistance(cv::Vec2f(line[2], line[3]), hit, tail), 4.0f);
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_detect_arrows_with_backend) {
+	TargetExtractorData data(cv::Size(256, 256), 256);
+	data.warped = syntheticFace();
+	auto detector = createLineDetector("hough", LineDetectorParameters());
+	detectArrows(&data, detector.get());
+	BOOST_CHECK(!data.lines.empty());
+	BOOST_CHECK_EQUAL(data.face_mask.size(), data.warped.size());
+	BOOST_CHECK_EQUAL(data.lines_drawing.size(), data.warped.size());
+}
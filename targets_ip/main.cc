@@ -1,14 +1,39 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <optional>
 #include <functional>
+#include <thread>
+#include <vector>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc.hpp>
 
 #include <boost/program_options.hpp>
 
+#include "arrow_detector.h"
+#include "autotune.h"
+#include "cache.h"
+#include "daemon.h"
+#include "export.h"
+#include "image_pack.h"
 #include "io.h"
+#include "lens.h"
+#include "line_detector.h"
+#include "motion.h"
+#include "multi_face.h"
+#include "quality.h"
+#include "regression.h"
+#include "result_log.h"
+#include "stream_scheduler.h"
 #include "target.h"
+#include "target_model.h"
+#include "thread_pool.h"
+#include "trace.h"
 #include "utils.h"
 #include "video.h"
 
@@ -18,12 +43,42 @@ enum class Action {
 	NONE,
 	HELP,
 	EXTRACT_TARGET,
-	STREAM
+	STREAM,
+	MULTISTREAM,
+	EXPORT,
+	AUTOTUNE,
+	SERVE,
+	PACK
 };
 
 struct Operations {
 	std::string input_file;
 	std::string output_file;
+	std::string cache_dir;
+	std::string log_file;
+	std::string detector_model;
+	std::string detector_config;
+	// Unset takes the preprocessing of the model format.
+	std::optional<double> detector_scale;
+	std::optional<double> detector_mean;
+	std::string labels_file;
+	int shards = 16;
+	int workers = 4;
+	std::vector<std::string> sources;
+	int queue_capacity = 2;
+	bool pin_threads = false;
+	bool motion_gate = false;
+	bool quality_gate = false;
+	int burst = 0;
+	bool incremental_arrows = false;
+	bool warp_from_original = false;
+	std::string line_detector;
+	int threshold = AUTO_THRESHOLD;
+	std::string calibration_file;
+	std::string trace_file;
+	bool multi_face = false;
+	bool fit = false;
+	std::string socket_path = "/tmp/targets_ip.sock";
 	Action action = Action::NONE;
 };
 
@@ -32,6 +87,16 @@ Action stringToAction(std::string action_str) {
 		return Action::EXTRACT_TARGET;
 	} else if (action_str == "stream") {
 		return Action::STREAM;
+	} else if (action_str == "multistream") {
+		return Action::MULTISTREAM;
+	} else if (action_str == "export") {
+		return Action::EXPORT;
+	} else if (action_str == "autotune") {
+		return Action::AUTOTUNE;
+	} else if (action_str == "serve") {
+		return Action::SERVE;
+	} else if (action_str == "pack") {
+		return Action::PACK;
 	}
 	return Action::NONE;
 }
@@ -46,6 +111,103 @@ void configureOperations(
 		operations->output_file = variables_map["output"].as<std::string>();
 	}
 
+	if (variables_map.count("cache")) {
+		operations->cache_dir = variables_map["cache"].as<std::string>();
+	}
+
+	if (variables_map.count("log")) {
+		operations->log_file = variables_map["log"].as<std::string>();
+	}
+
+	if (variables_map.count("detector-model")) {
+		operations->detector_model = variables_map["detector-model"].as<std::string>();
+	}
+
+	if (variables_map.count("detector-config")) {
+		operations->detector_config = variables_map["detector-config"].as<std::string>();
+	}
+
+	if (variables_map.count("detector-scale")) {
+		operations->detector_scale = variables_map["detector-scale"].as<double>();
+	}
+
+	if (variables_map.count("detector-mean")) {
+		operations->detector_mean = variables_map["detector-mean"].as<double>();
+	}
+
+	if (variables_map.count("labels")) {
+		operations->labels_file = variables_map["labels"].as<std::string>();
+	}
+
+	if (variables_map.count("shards")) {
+		operations->shards = variables_map["shards"].as<int>();
+	}
+
+	if (variables_map.count("workers")) {
+		operations->workers = variables_map["workers"].as<int>();
+	}
+
+	if (variables_map.count("source")) {
+		operations->sources = variables_map["source"].as<std::vector<std::string>>();
+	}
+
+	if (variables_map.count("queue")) {
+		operations->queue_capacity = variables_map["queue"].as<int>();
+	}
+
+	if (variables_map.count("pin")) {
+		operations->pin_threads = true;
+	}
+
+	if (variables_map.count("motion-gate")) {
+		operations->motion_gate = true;
+	}
+
+	if (variables_map.count("quality-gate")) {
+		operations->quality_gate = true;
+	}
+
+	if (variables_map.count("burst")) {
+		operations->burst = variables_map["burst"].as<int>();
+	}
+
+	if (variables_map.count("incremental")) {
+		operations->incremental_arrows = true;
+	}
+
+	if (variables_map.count("full-res-warp")) {
+		operations->warp_from_original = true;
+	}
+
+	if (variables_map.count("line-detector")) {
+		operations->line_detector = variables_map["line-detector"].as<std::string>();
+	}
+
+	if (variables_map.count("threshold")) {
+		const std::string threshold = variables_map["threshold"].as<std::string>();
+		operations->threshold = threshold == "auto" ? AUTO_THRESHOLD : std::stoi(threshold);
+	}
+
+	if (variables_map.count("calibration")) {
+		operations->calibration_file = variables_map["calibration"].as<std::string>();
+	}
+
+	if (variables_map.count("multi-face")) {
+		operations->multi_face = true;
+	}
+
+	if (variables_map.count("fit")) {
+		operations->fit = true;
+	}
+
+	if (variables_map.count("trace")) {
+		operations->trace_file = variables_map["trace"].as<std::string>();
+	}
+
+	if (variables_map.count("socket")) {
+		operations->socket_path = variables_map["socket"].as<std::string>();
+	}
+
 	if (variables_map.count("action")) {
 		operations->action = stringToAction(variables_map["action"].as<std::string>());
 	}
@@ -61,7 +223,32 @@ void setupOperationsFromArguments(Operations* operations, int argc, char** argv)
 		("help", "produce help message")
 		("action", po::value<std::string>(), "set action")
 		("output", po::value<std::string>(), "set output file")
-		("input", po::value<std::string>(), "set input file");
+		("input", po::value<std::string>(), "set input file")
+		("cache", po::value<std::string>(), "set directory of extraction result cache")
+		("log", po::value<std::string>(), "append per-frame stream results to binary log, one log per multistream source")
+		("detector-model", po::value<std::string>(), "set arrow detector model (.pb, .onnx)")
+		("detector-config", po::value<std::string>(), "set arrow detector config (.pbtxt)")
+		("detector-scale", po::value<double>(), "arrow detector input scale, by default 1/127.5 for .pb and 1 for .onnx")
+		("detector-mean", po::value<double>(), "arrow detector input mean, by default 127.5 for .pb and 0 for .onnx")
+		("labels", po::value<std::string>(), "set label map (.pbtxt) for export")
+		("shards", po::value<int>(), "set number of exported TFRecord shards")
+		("workers", po::value<int>(), "set number of worker threads")
+		("source", po::value<std::vector<std::string>>()->multitoken(),
+			"set camera devices, stream urls or video files for multistream")
+		("queue", po::value<int>(), "set per-source frame queue capacity")
+		("pin", "pin worker threads to cpus")
+		("motion-gate", "process stream frames only on motion and keyframes")
+		("quality-gate", "skip blurred and badly exposed stream frames after preprocessing")
+		("burst", po::value<int>(), "process only the sharpest acceptable stream frame of every burst of frames")
+		("incremental", "detect only new arrows in stream, 'r' starts a new end")
+		("full-res-warp", "find the target at low resolution, warp the face from the full resolution frame")
+		("line-detector", po::value<std::string>(), "set stream line detector (hough, lsd, fld, edge_drawing)")
+		("threshold", po::value<std::string>(), "set face threshold, 0-255 or auto (default)")
+		("calibration", po::value<std::string>(), "set lens calibration (.yml) of the input images")
+		("multi-face", "extract every target face of the input, output gets a face index suffix")
+		("fit", "fit the target pose of every face in multi-face mode and of every stream frame, logged with --log")
+		("trace", po::value<std::string>(), "write a chrome trace of stream spans on exit, 't' writes it in stream")
+		("socket", po::value<std::string>(), "set unix socket of the serve daemon");
 
 	auto parsed_options = po::parse_command_line(argc, argv, options_description);
 
@@ -77,37 +264,238 @@ void setupOperationsFromArguments(Operations* operations, int argc, char** argv)
 	}
 }
 
+void configureLens(const Operations &operations, LensCalibration *lens) {
+	if (operations.calibration_file.empty()) {
+		return;
+	}
+	if (!loadLensCalibration(operations.calibration_file, lens)) {
+		std::cerr << "Could not load lens calibration " << operations.calibration_file << std::endl;
+		abort();
+	}
+}
+
+void storeTrace(const Operations &operations) {
+	if (operations.trace_file.empty()) {
+		return;
+	}
+	if (storeChromeTrace(operations.trace_file)) {
+		std::cout << "Trace written to " << operations.trace_file << "\n";
+	} else {
+		std::cerr << "Could not write trace " << operations.trace_file << std::endl;
+	}
+}
+
+std::unique_ptr<ArrowDetector> createArrowDetector(const Operations &operations) {
+	if (operations.detector_model.empty()) {
+		return nullptr;
+	}
+	ArrowDetectorParameters parameters = defaultArrowDetectorParameters(operations.detector_model);
+	if (operations.detector_scale) {
+		parameters.scale = *operations.detector_scale;
+	}
+	if (operations.detector_mean) {
+		parameters.mean = cv::Scalar::all(*operations.detector_mean);
+	}
+	return std::make_unique<ArrowDetector>(operations.detector_model,
+		operations.detector_config, parameters);
+}
+
+// Output file of one of several faces or sources, index before the
+// extension.
+std::string indexedOutputFile(const std::string &output_file, int face) {
+	const size_t extension = output_file.rfind('.');
+	const size_t directory = output_file.rfind('/');
+	const size_t split = extension == std::string::npos ||
+		(directory != std::string::npos && extension < directory)
+		? output_file.size() : extension;
+	return output_file.substr(0, split) + "_" + std::to_string(face) + output_file.substr(split);
+}
+
+void extractTargets(Operations* operations, TargetExtractorData *data) {
+	MultiFaceOptions options;
+	options.threshold = operations->threshold;
+	options.fit = operations->fit;
+	WorkStealingPool pool(operations->workers, operations->pin_threads);
+	auto detector = createArrowDetector(*operations);
+
+	loadAndPreprocessInput(data, operations->input_file);
+	for (const FaceResult &face : processTargetFaces(data, options, &pool, detector.get())) {
+		if (face.warped.empty()) {
+			continue;
+		}
+		storeImage(face.warped, indexedOutputFile(operations->output_file, face.face));
+		std::cout << "face " << face.face << " corners";
+		for (const auto &corner : face.corners) {
+			std::cout << " " << corner;
+		}
+		std::cout << " segments " << face.lines.size();
+		for (const auto &detection : face.detections) {
+			std::cout << " detection " << detection.class_id << " " << detection.score
+				<< " " << detection.box;
+		}
+		if (!face.pose.empty()) {
+			std::cout << " pose";
+			for (double value : face.pose) {
+				std::cout << " " << value;
+			}
+		}
+		std::cout << "\n";
+	}
+}
+
 void extractTarget(Operations* operations) {
 	const cv::Size target_size(256, 256);
 	const int scaled_input_size = 256;
 
 	const int smoothing = 3;
 	const int dilate = 3;
-	const int threshold = 240;
+	const int threshold = operations->threshold;
 
 	TargetExtractorData data(target_size, scaled_input_size);
-	loadAndPreprocessInput(&data, operations->input_file);
-	extractTargetFace(&data, smoothing, dilate, threshold);
+	data.warp_from_original = operations->warp_from_original;
+	configureLens(*operations, &data.lens);
+	if (operations->multi_face) {
+		extractTargets(operations, &data);
+		return;
+	}
+	if (!operations->cache_dir.empty()) {
+		ResultCache cache(operations->cache_dir);
+		extractTargetFaceCached(&cache, &data, operations->input_file,
+			smoothing, dilate, threshold);
+	} else {
+		loadAndPreprocessInput(&data, operations->input_file);
+		extractTargetFace(&data, smoothing, dilate, threshold);
+	}
 	storeImage(data.warped, operations->output_file);
+
+	auto detector = createArrowDetector(*operations);
+	if (detector && !data.warped.empty()) {
+		if (data.img.empty()) {
+			// Cache hit with a stored face, the color face needs the image.
+			loadAndPreprocessInput(&data, operations->input_file);
+		}
+		cv::Mat color_face;
+		warpColorTargetFace(&data, &color_face);
+		for (const auto &detection : detector->detect(color_face)) {
+			std::cout << detection.class_id << " " << detection.score
+				<< " " << detection.box << "\n";
+		}
+	}
 }
 
 void stream(Operations* operations) {
 	const cv::Size target_size(256, 256);
 	const int scaled_input_size = 256;
 	TargetExtractorData data(target_size, scaled_input_size);
+	data.warp_from_original = operations->warp_from_original;
+	configureLens(*operations, &data.lens);
+
+	std::unique_ptr<ResultLogWriter> log;
+	if (!operations->log_file.empty()) {
+		log = std::make_unique<ResultLogWriter>(operations->log_file);
+	}
+	uint64_t frame_index = 0;
+	auto detector = createArrowDetector(*operations);
+	cv::Mat face_drawing;
+	std::unique_ptr<MotionGate> motion_gate;
+	if (operations->motion_gate) {
+		motion_gate = std::make_unique<MotionGate>();
+	}
+	const bool quality_gate = operations->quality_gate;
+	std::unique_ptr<BurstSelector> burst;
+	if (operations->burst > 1) {
+		burst = std::make_unique<BurstSelector>(operations->burst);
+	}
+	const bool incremental_arrows = operations->incremental_arrows;
+	const int threshold = operations->threshold;
+	const bool fit = operations->fit;
+	std::vector<double> pose;
+	ArrowTrackingState arrow_tracking;
+	std::unique_ptr<LineDetector> line_detector;
+	if (!operations->line_detector.empty()) {
+		line_detector = createLineDetector(operations->line_detector, LineDetectorParameters());
+	}
 
 	captureCameraImage("/dev/video0", &data.img,
-		[&data](const cv::Mat &frame) {
+		[&data, &log, &frame_index, &detector, &face_drawing, &motion_gate, quality_gate, &burst,
+			incremental_arrows, &arrow_tracking, &line_detector, threshold, fit, &pose](const cv::Mat &frame) {
 			const int smoothing = 3;
 			const int dilate = 3;
-			const int threshold = 200;
+
+			const int canny1 = 50;
+			const int canny2 = 200;
+			const int hough = 50;
+
+			const int64_t capture_timestamp_us =
+				std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::system_clock::now().time_since_epoch()).count();
+			Stopwatch stopwatch;
+			float stage_ms[STAGE_COUNT] = {};
+
+			// Keeps the results of the last processed frame.
+			auto skipFrame = [&]() {
+				if (log) {
+					log->append(makeFrameResult(data, frame_index, capture_timestamp_us, pose));
+				}
+				frame_index++;
+			};
+
+			// Static scene.
+			if (motion_gate && !motion_gate->shouldProcess(frame)) {
+				skipFrame();
+				return;
+			}
 
 			preprocessInput(&data);
+			if (burst) {
+				if (!burst->offer(data.img, data.quality)) {
+					skipFrame();
+					return;
+				}
+				const cv::Mat best = burst->take();
+				if (best.empty()) {
+					skipFrame();
+					return;
+				}
+				best.copyTo(data.img);
+				preprocessInput(&data);
+			} else if (quality_gate && !data.quality.acceptable) {
+				skipFrame();
+				return;
+			}
+			stage_ms[STAGE_PREPROCESS] = stopwatch.lap();
 			extractTargetFace(&data, smoothing, dilate, threshold);
+			stage_ms[STAGE_EXTRACT] = stopwatch.lap();
 
 			if (data.poly.size() == 4) {
-				cv::imshow("opencv", data.warped);
+				if (incremental_arrows) {
+					detectNewArrows(&data, &arrow_tracking, canny1, canny2, hough);
+				} else if (line_detector) {
+					detectArrows(&data, line_detector.get());
+				} else {
+					detectArrows(&data, canny1, canny2, hough);
+				}
+				if (detector) {
+					warpColorTargetFace(&data, &face_drawing);
+					drawDetections(&face_drawing, detector->detect(face_drawing));
+				} else {
+					face_drawing = data.warped;
+				}
+				stage_ms[STAGE_DETECT] = stopwatch.lap();
+				if (fit) {
+					pose = fit_target_model_pose(data.img, faceCorners(data),
+						FitCostEngine::SAMPLED, data.lens);
+					stage_ms[STAGE_FIT] = stopwatch.lap();
+				}
+				cv::imshow("opencv", face_drawing);
 			} else {
+				// Target hidden, e.g. while arrows are pulled, starts a new end.
+				resetArrowTracking(&arrow_tracking);
+				data.lines.clear();
+				pose.clear();
+				// The intermediates are materialized only to be shown here.
+				blurThresholdDilate(data.hsv[2], smoothing, resolveThreshold(data, threshold), dilate,
+					&data.dilated, &data.smoothed, &data.thresholded);
 				showStack({&data.hsv[2],
 					&data.smoothed,
 					&data.thresholded,
@@ -115,13 +503,198 @@ void stream(Operations* operations) {
 					&data.curve_drawing,
 					&data.poly_drawing}, 3, false);
 			}
+
+			if (log) {
+				FrameResult result = makeFrameResult(data, frame_index, capture_timestamp_us, pose);
+				std::copy(std::begin(stage_ms), std::end(stage_ms), result.stage_ms);
+				log->append(result);
+			}
+			frame_index++;
+		},
+		[incremental_arrows, &arrow_tracking, operations](int key) {
+			if (incremental_arrows && key == 'r') {
+				resetArrowTracking(&arrow_tracking);
+			}
+			if (key == 't') {
+				storeTrace(*operations);
+			}
 		});
+	storeTrace(*operations);
+}
+
+volatile std::sig_atomic_t interrupted = 0;
+
+void multistream(Operations* operations) {
+	const cv::Size target_size(256, 256);
+	const int scaled_input_size = 256;
+	TargetExtractorData prototype(target_size, scaled_input_size);
+	prototype.warp_from_original = operations->warp_from_original;
+	configureLens(*operations, &prototype.lens);
+
+	// Each source is processed by one task at a time, so per-source gates
+	// need no locking.
+	std::vector<MotionGate> motion_gates(operations->sources.size());
+	const bool motion_gate = operations->motion_gate;
+	const bool quality_gate = operations->quality_gate;
+	const int threshold = operations->threshold;
+
+	// One result log per source, the source index before the extension.
+	std::vector<std::unique_ptr<ResultLogWriter>> logs(operations->sources.size());
+	std::vector<uint64_t> frame_indices(operations->sources.size());
+	const bool fit = operations->fit;
+	std::vector<std::vector<double>> poses(operations->sources.size());
+	if (!operations->log_file.empty()) {
+		for (size_t i = 0; i < logs.size(); i++) {
+			logs[i] = std::make_unique<ResultLogWriter>(
+				indexedOutputFile(operations->log_file, i));
+		}
+	}
+
+	WorkStealingPool pool(operations->workers, operations->pin_threads);
+	StreamScheduler scheduler(operations->sources, prototype, &pool,
+		operations->queue_capacity,
+		[&motion_gates, motion_gate, quality_gate, threshold, &logs, &frame_indices, fit, &poses](
+			int source, TargetExtractorData *data) {
+			const int smoothing = 3;
+			const int dilate = 3;
+
+			const int canny1 = 50;
+			const int canny2 = 200;
+			const int hough = 50;
+
+			const int64_t capture_timestamp_us =
+				std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::system_clock::now().time_since_epoch()).count();
+			Stopwatch stopwatch;
+			float stage_ms[STAGE_COUNT] = {};
+			ResultLogWriter *log = logs[source].get();
+			uint64_t &frame_index = frame_indices[source];
+			std::vector<double> &pose = poses[source];
+
+			// Gated frames keep the results of the last processed frame.
+			const bool gated = motion_gate && !motion_gates[source].shouldProcess(data->img);
+			if (!gated) {
+				preprocessInput(data);
+				stage_ms[STAGE_PREPROCESS] = stopwatch.lap();
+			}
+			if (!gated && !(quality_gate && !data->quality.acceptable)) {
+				extractTargetFace(data, smoothing, dilate, threshold);
+				stage_ms[STAGE_EXTRACT] = stopwatch.lap();
+				pose.clear();
+				if (data->poly.size() == 4) {
+					detectArrows(data, canny1, canny2, hough);
+					stage_ms[STAGE_DETECT] = stopwatch.lap();
+					if (fit) {
+						pose = fit_target_model_pose(data->img, faceCorners(*data),
+							FitCostEngine::SAMPLED, data->lens);
+						stage_ms[STAGE_FIT] = stopwatch.lap();
+					}
+				}
+			}
+
+			if (log) {
+				FrameResult result = makeFrameResult(*data, frame_index, capture_timestamp_us, pose);
+				std::copy(std::begin(stage_ms), std::end(stage_ms), result.stage_ms);
+				log->append(result);
+			}
+			frame_index++;
+		});
+
+	std::signal(SIGINT, [](int) { interrupted = 1; });
+	scheduler.start();
+	for (int seconds = 1; !interrupted && !scheduler.finished(); seconds++) {
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		if (seconds % 5 == 0) {
+			printSourceStats(std::cout, scheduler.stats());
+		}
+	}
+	scheduler.stop();
+	for (auto &log : logs) {
+		if (log) {
+			log->flush();
+		}
+	}
+	printSourceStats(std::cout, scheduler.stats());
+	storeTrace(*operations);
+}
+
+void exportRecords(Operations* operations) {
+	ExportOptions options;
+	options.annotation_dir = operations->input_file;
+	options.output_prefix = operations->output_file;
+	options.label_map_file = operations->labels_file;
+	options.shards = operations->shards;
+	options.workers = operations->workers;
+
+	ExportSummary summary = exportTFRecords(options);
+	std::cout << "Exported " << summary.examples << " faces, skipped "
+		<< summary.skipped << " images without a face and "
+		<< summary.unreadable << " unreadable images\n";
+}
+
+// Sweeps extraction and detection parameters over labelme annotated images
+// in the input directory or image pack (.pack), or over synthetic frames
+// without input, and prints the accuracy/latency Pareto front.
+void autotune(Operations* operations) {
+	const std::string &input = operations->input_file;
+	const bool packed = input.size() > 5 && input.compare(input.size() - 5, 5, ".pack") == 0;
+	const std::vector<LabeledFrame> dataset = input.empty()
+		? syntheticDataset(100, 1, cv::Size(512, 384), 3)
+		: packed ? packDataset(input) : labelmeDataset(input);
+
+	TuningGrid grid;
+	std::cout << "Evaluating " << grid.size() << " parameter sets on "
+		<< dataset.size() << " images\n";
+	WorkStealingPool pool(operations->workers, operations->pin_threads);
+	std::vector<TuningResult> front =
+		paretoFront(sweepParameters(dataset, grid, PipelineParameters(), &pool));
+	// The sweep latencies only preselect, the front is re-timed serially.
+	measureLatency(dataset, &front);
+	front = paretoFront(front);
+
+	printTuningResults(std::cout, front);
+	if (!operations->output_file.empty()) {
+		storeTuningResults(operations->output_file, front);
+	}
+}
+
+FrameDaemon *serving_daemon = nullptr;
+
+// Keeps the pipeline warm between requests from local clients, see daemon.h.
+void serve(Operations* operations) {
+	DaemonOptions options;
+	options.socket_path = operations->socket_path;
+	options.workers = operations->workers;
+	options.pin_threads = operations->pin_threads;
+	options.threshold = operations->threshold;
+	configureLens(*operations, &options.lens);
+	options.max_batch = std::max(operations->workers * 2, 1);
+
+	FrameDaemon daemon(options);
+	serving_daemon = &daemon;
+	std::signal(SIGINT, [](int) { serving_daemon->stop(); });
+	std::signal(SIGTERM, [](int) { serving_daemon->stop(); });
+	std::cout << "Serving on " << options.socket_path << "\n";
+	daemon.run();
+	std::cout << "Processed " << daemon.processed() << " frames\n";
+}
+
+// Packs the images of the input directory, with their labelme annotations
+// if there are any, into one memory mapped file for batch runs.
+void packImages(Operations* operations) {
+	const int images = packDirectory(operations->input_file, operations->output_file);
+	std::cout << "Packed " << images << " images into " << operations->output_file << "\n";
 }
 
 void runOperations(Operations *operations) {
 	std::map<Action, std::function<void(Operations*)>> actions_map {
 		{Action::EXTRACT_TARGET, extractTarget},
-		{Action::STREAM, stream}
+		{Action::STREAM, stream},
+		{Action::MULTISTREAM, multistream},
+		{Action::EXPORT, exportRecords},
+		{Action::AUTOTUNE, autotune},
+		{Action::SERVE, serve},
+		{Action::PACK, packImages}
 	};
 	actions_map[operations->action](operations);
 }
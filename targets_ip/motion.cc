@@ -0,0 +1,47 @@
+#include "motion.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "utils.h"
+
+MotionGate::MotionGate(int width, int pixel_threshold,
+	double changed_fraction, int keyframe_interval)
+	: width(width),
+		pixel_threshold(pixel_threshold),
+		changed_fraction(changed_fraction),
+		keyframe_interval(keyframe_interval),
+		frames_since_processed(0) {
+}
+
+void MotionGate::reset() {
+	reference.release();
+	frames_since_processed = 0;
+}
+
+bool MotionGate::shouldProcess(const cv::Mat &frame) {
+	// Area averaging lets every pixel count, point sampling would alias and
+	// miss motion between the samples. The small blur suppresses what is
+	// left of sensor noise.
+	cv::resize(frame, sampled, getSizeKeepRatio(frame, width, 0), 0, 0, cv::INTER_AREA);
+	if (sampled.channels() == 3) {
+		cv::cvtColor(sampled, luma, cv::COLOR_BGR2GRAY);
+	} else {
+		sampled.copyTo(luma);
+	}
+	cv::blur(luma, luma, cv::Size(3, 3));
+
+	bool process = reference.empty() || reference.size() != luma.size() ||
+		++frames_since_processed >= keyframe_interval;
+	if (!process) {
+		cv::absdiff(luma, reference, difference);
+		cv::threshold(difference, difference, pixel_threshold, 255, cv::THRESH_BINARY);
+		process = cv::countNonZero(difference) > changed_fraction * difference.total();
+	}
+
+	if (process) {
+		cv::swap(luma, reference);
+		frames_since_processed = 0;
+	}
+	return process;
+}
@@ -0,0 +1,33 @@
+#ifndef _MOTION_H
+#define _MOTION_H
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+// Front-end gate deciding whether a frame needs the full pipeline. The frame
+// is area averaged into a tiny luma image and compared to the luma image of
+// the last processed frame, so slow changes accumulate until they count as
+// motion. Every keyframe_interval-th frame passes regardless.
+class MotionGate {
+ private:
+	int width;
+	int pixel_threshold;
+	double changed_fraction;
+	int keyframe_interval;
+	int frames_since_processed;
+	cv::Mat sampled;
+	cv::Mat luma;
+	cv::Mat reference;
+	cv::Mat difference;
+
+ public:
+	explicit MotionGate(int width = 96, int pixel_threshold = 16,
+		double changed_fraction = 0.001, int keyframe_interval = 30);
+
+	// True when the frame shows motion or is a keyframe. The frame then
+	// becomes the new reference.
+	bool shouldProcess(const cv::Mat &frame);
+	void reset();
+};
+
+#endif  // _MOTION_H
@@ -0,0 +1,44 @@
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE MotionTest
+
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "motion.h"
+
+cv::Mat staticFrame() {
+	cv::Mat frame(480, 640, CV_8UC3, cv::Scalar(60, 70, 60));
+	cv::rectangle(frame, cv::Rect(200, 120, 240, 240), cv::Scalar(255, 255, 255), -1);
+	return frame;
+}
+
+BOOST_AUTO_TEST_CASE(test_static_scene_is_skipped) {
+	MotionGate gate(96, 16, 0.001, 1000);
+	const cv::Mat frame = staticFrame();
+	BOOST_CHECK(gate.shouldProcess(frame));
+	for (int i = 0; i < 10; i++) {
+		BOOST_CHECK(!gate.shouldProcess(frame));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_motion_is_processed) {
+	MotionGate gate(96, 16, 0.001, 1000);
+	cv::Mat frame = staticFrame();
+	BOOST_CHECK(gate.shouldProcess(frame));
+	cv::line(frame, cv::Point(250, 200), cv::Point(400, 260), cv::Scalar(20, 20, 20), 8);
+	BOOST_CHECK(gate.shouldProcess(frame));
+	BOOST_CHECK(!gate.shouldProcess(frame));
+}
+
+BOOST_AUTO_TEST_CASE(test_keyframes_pass) {
+	MotionGate gate(96, 16, 0.001, 5);
+	const cv::Mat frame = staticFrame();
+	int processed = 0;
+	for (int i = 0; i < 21; i++) {
+		processed += gate.shouldProcess(frame);
+	}
+	BOOST_CHECK_EQUAL(processed, 5);
+}
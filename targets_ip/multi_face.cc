@@ -0,0 +1,103 @@
+#include "multi_face.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "target.h"
+#include "target_model.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+std::vector<std::vector<cv::Point>> findFaceQuads(const cv::Mat &mask,
+	double min_area, int max_faces) {
+	// Outer contours only, the rings inside a face are not faces.
+	std::vector<std::vector<cv::Point>> contours;
+	cv::findContours(mask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+	std::vector<std::pair<double, std::vector<cv::Point>>> quads;
+	for (const auto &contour : contours) {
+		const double area = cv::contourArea(contour);
+		if (area < min_area) {
+			continue;
+		}
+		std::vector<cv::Point> poly;
+		cv::approxPolyDP(contour, poly, 30.0, true);
+		if (poly.size() == 4 && cv::isContourConvex(poly)) {
+			quads.emplace_back(area, poly);
+		}
+	}
+	std::sort(quads.begin(), quads.end(),
+		[](const auto &a, const auto &b) { return a.first > b.first; });
+
+	std::vector<std::vector<cv::Point>> result;
+	for (size_t i = 0; i < quads.size() && static_cast<int>(i) < max_faces; i++) {
+		result.push_back(quads[i].second);
+	}
+	return result;
+}
+
+std::vector<FaceResult> processTargetFaces(TargetExtractorData *data,
+	const MultiFaceOptions &options, WorkStealingPool *pool,
+	ArrowDetector *detector) {
+	TRACE_SPAN("process_faces");
+	blurThresholdDilate(data->hsv[2], options.smoothing,
+		resolveThreshold(*data, options.threshold), options.dilate, &data->mask);
+	const std::vector<std::vector<cv::Point>> quads = findFaceQuads(data->mask,
+		options.min_face_fraction * data->mask.total(), options.max_faces);
+
+	// Faces share the distortion map instead of building it per face.
+	prepareFaceWarp(data);
+	std::vector<FaceResult> results(quads.size());
+	std::vector<cv::Mat> color_faces(quads.size());
+	parallelFor(pool, quads.size(), [&](int i) {
+		TRACE_SPAN("process_face");
+		TargetExtractorData face(data->target_size, data->scaled_input_size);
+		face.img = data->img;
+		face.img_resized = data->img_resized;
+		std::copy(std::begin(data->hsv), std::end(data->hsv), std::begin(face.hsv));
+		face.warp_from_original = data->warp_from_original;
+		face.lens = data->lens;
+		face.distortion_map = data->distortion_map;
+		face.poly = quads[i];
+
+		warpPolygonToSquare(&face);
+		FaceResult &result = results[i];
+		result.face = i;
+		result.poly = face.poly;
+		result.homography = face.homography;
+		if (face.homography.empty()) {
+			return;
+		}
+		detectArrows(&face, options.canny1, options.canny2, options.hough);
+		result.corners = faceCorners(face);
+		result.warped = face.warped;
+		result.lines = face.lines;
+		if (detector) {
+			warpColorTargetFace(&face, &color_faces[i]);
+		}
+		if (options.fit && !face.img.empty()) {
+			result.pose = fit_target_model_pose(face.img, result.corners,
+				FitCostEngine::SAMPLED, face.lens);
+		}
+	});
+
+	if (detector) {
+		// The network is not shared between threads, one batch for all faces.
+		std::vector<cv::Mat> batch;
+		std::vector<int> batch_faces;
+		for (size_t i = 0; i < color_faces.size(); i++) {
+			if (!color_faces[i].empty()) {
+				batch.push_back(color_faces[i]);
+				batch_faces.push_back(i);
+			}
+		}
+		const auto detections = detector->detect(batch);
+		for (size_t i = 0; i < batch_faces.size(); i++) {
+			results[batch_faces[i]].detections = detections[i];
+		}
+	}
+	return results;
+}
@@ -0,0 +1,54 @@
+#ifndef _MULTI_FACE_H
+#define _MULTI_FACE_H
+#pragma once
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "arrow_detector.h"
+#include "target.h"
+#include "thread_pool.h"
+
+struct MultiFaceOptions {
+	int smoothing = 3;
+	int dilate = 3;
+	int threshold = AUTO_THRESHOLD;
+	int canny1 = 50;
+	int canny2 = 200;
+	int hough = 50;
+	bool fit = false;
+	// Smallest face area as a fraction of the resized image.
+	double min_face_fraction = 0.01;
+	int max_faces = 4;
+};
+
+// One face of a frame. The quad and homography are in resized image
+// coordinates as TargetExtractorData::poly and homography, corners in img
+// coordinates as faceCorners.
+struct FaceResult {
+	int face;  // index in order of decreasing area
+	std::vector<cv::Point> poly;
+	std::vector<cv::Point2f> corners;
+	cv::Mat homography;
+	cv::Mat warped;
+	std::vector<cv::Vec4i> lines;
+	std::vector<double> pose;  // empty unless fitted
+	std::vector<ArrowDetection> detections;  // empty without a detector
+};
+
+// Four sided convex outer contours of the mask of at least min_area pixels,
+// largest first.
+std::vector<std::vector<cv::Point>> findFaceQuads(const cv::Mat &mask,
+	double min_area, int max_faces);
+
+// Finds every face in the preprocessed data and rectifies, detects arrows
+// and optionally fits the pose of each face as a task of the pool. data
+// keeps the shared mask; per-face work uses its own TargetExtractorData
+// sharing the input planes. With a detector, the color faces of all faces
+// are detected in a single batch once the face tasks are done.
+std::vector<FaceResult> processTargetFaces(TargetExtractorData *data,
+	const MultiFaceOptions &options, WorkStealingPool *pool,
+	ArrowDetector *detector = nullptr);
+
+#endif  // _MULTI_FACE_H
@@ -0,0 +1,70 @@
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE MultiFaceTest
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "multi_face.h"
+#include "synthetic.h"
+#include "target.h"
+#include "thread_pool.h"
+
+// Faces side by side, each rendered into its own half of the frame.
+cv::Mat syntheticFaces(int faces) {
+	SyntheticTargetRenderer renderer;
+	std::vector<cv::Mat> halves;
+	for (int i = 0; i < faces; i++) {
+		SyntheticScene scene;
+		scene.pose = {0, 0, 420.0 + 40 * i, 0, 0.1 * i, 0};
+		scene.image_size = cv::Size(320, 320);
+		halves.push_back(renderer.render(scene).image);
+	}
+	cv::Mat frame;
+	cv::hconcat(halves, frame);
+	return frame;
+}
+
+BOOST_AUTO_TEST_CASE(test_find_face_quads) {
+	cv::Mat mask(200, 300, CV_8UC1, cv::Scalar(0));
+	cv::rectangle(mask, cv::Rect(10, 10, 80, 80), cv::Scalar(255), -1);
+	cv::rectangle(mask, cv::Rect(150, 40, 120, 120), cv::Scalar(255), -1);
+	cv::rectangle(mask, cv::Rect(110, 180, 5, 5), cv::Scalar(255), -1);
+	// Hole in the larger face, not a face of its own.
+	cv::rectangle(mask, cv::Rect(180, 70, 60, 60), cv::Scalar(0), -1);
+
+	const auto quads = findFaceQuads(mask, 100, 4);
+	BOOST_REQUIRE_EQUAL(quads.size(), 2);
+	BOOST_CHECK_GT(cv::contourArea(quads[0]), cv::contourArea(quads[1]));
+	BOOST_CHECK_EQUAL(findFaceQuads(mask, 100, 1).size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_process_faces_on_pool) {
+	TargetExtractorData data(cv::Size(128, 128), 256);
+	data.img = syntheticFaces(3);
+	preprocessInput(&data);
+
+	WorkStealingPool pool(3);
+	const std::vector<FaceResult> faces = processTargetFaces(&data, MultiFaceOptions(), &pool);
+	BOOST_REQUIRE_EQUAL(faces.size(), 3);
+	for (size_t i = 0; i < faces.size(); i++) {
+		BOOST_CHECK_EQUAL(faces[i].face, i);
+		BOOST_CHECK_EQUAL(faces[i].corners.size(), 4);
+		BOOST_CHECK_EQUAL(faces[i].warped.size(), cv::Size(128, 128));
+		BOOST_CHECK(faces[i].pose.empty());
+	}
+	// Faces are in separate thirds of the frame.
+	std::vector<float> centers;
+	for (const auto &face : faces) {
+		centers.push_back((face.corners[0].x + face.corners[2].x) / 2 / 320);
+	}
+	std::sort(centers.begin(), centers.end());
+	for (size_t i = 0; i < centers.size(); i++) {
+		BOOST_CHECK_EQUAL(static_cast<int>(centers[i]), i);
+	}
+}
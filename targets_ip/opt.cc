@@ -3,6 +3,8 @@
 #include <gsl/gsl_multimin.h>
 #include <iostream>
 
+#include "trace.h"
+
 gsl_vector *create_init_vector(const std::vector<double> &values) {
 	gsl_vector *vector = gsl_vector_alloc(values.size());
 	for (int i = 0; i < values.size(); i++) {
@@ -48,7 +50,8 @@ int optimize(const std::vector<double> &initial_solution,
 	const std::vector<double> &initial_step_size,
 	void *parameters,
 	double (*optimized_function)(const gsl_vector *, void *),
-	std::vector<double> *result) {
+	std::vector<double> *result,
+	double size_tolerance) {
 	gsl_multimin_function minex_func;
 	gsl_multimin_fminimizer *minimizer = create_minimizer(initial_solution,
 		initial_step_size,
@@ -58,6 +61,7 @@ int optimize(const std::vector<double> &initial_solution,
 
 	int iter;
 	for (iter = 0; iter < 1000; iter++) {
+		TRACE_SPAN("optimizer_iteration");
 		int iterate_status = gsl_multimin_fminimizer_iterate(minimizer);
 
 		if (iterate_status) {
@@ -65,7 +69,7 @@ int optimize(const std::vector<double> &initial_solution,
 		}
 
 		double size = gsl_multimin_fminimizer_size(minimizer);
-		int status = gsl_multimin_test_size(size, 1e-1);
+		int status = gsl_multimin_test_size(size, size_tolerance);
 
 		if (status != GSL_CONTINUE) {
 			break;
@@ -10,6 +10,7 @@ int optimize(const std::vector<double> &initial_solution,
 	const std::vector<double> &initial_step_size,
 	void* parameters,
 	double (*optimized_function)(const gsl_vector *, void *),
-	std::vector<double> *result);
+	std::vector<double> *result,
+	double size_tolerance = 1e-1);
 
 #endif  // _OPT_H
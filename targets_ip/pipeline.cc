@@ -0,0 +1,154 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "target.h"
+#include "utils.h"
+
+int StageGraph::addStage(const std::string &name,
+	const std::vector<int> &inputs,
+	const std::vector<std::string> &parameters,
+	Compute compute) {
+	for (int input : inputs) {
+		if (input < 0 || input >= size()) {
+			std::cerr << "Stage " << name << " has unknown input " << input << "\n";
+			abort();
+		}
+	}
+	Stage stage;
+	stage.name = name;
+	stage.inputs = inputs;
+	stage.parameters = parameters;
+	stage.compute = compute;
+	stages.push_back(stage);
+	return stages.size() - 1;
+}
+
+void StageGraph::setParameter(const std::string &name, int value) {
+	parameters[name] = value;
+}
+
+int StageGraph::parameter(const std::string &name) const {
+	auto it = parameters.find(name);
+	if (it == parameters.end()) {
+		std::cerr << "Unset stage parameter " << name << "\n";
+		abort();
+	}
+	return it->second;
+}
+
+void StageGraph::invalidate(int stage) {
+	stages[stage].dirty = true;
+}
+
+uint64_t StageGraph::evaluate(int index) {
+	std::vector<uint64_t> input_versions;
+	for (int input : stages[index].inputs) {
+		input_versions.push_back(evaluate(input));
+	}
+	std::vector<int> parameter_values;
+	for (const auto &name : stages[index].parameters) {
+		parameter_values.push_back(parameter(name));
+	}
+
+	Stage &stage = stages[index];
+	if (stage.dirty ||
+		input_versions != stage.input_versions ||
+		parameter_values != stage.parameter_values) {
+		Stopwatch stopwatch;
+		stage.compute();
+		stage.timing.last_ms = stopwatch.lap();
+		stage.timing.total_ms += stage.timing.last_ms;
+		stage.timing.runs++;
+		stage.dirty = false;
+		stage.input_versions = input_versions;
+		stage.parameter_values = parameter_values;
+		stage.version++;
+	}
+	return stage.version;
+}
+
+void printStageTimings(std::ostream &out, const StageGraph &graph) {
+	out << std::fixed << std::setprecision(3);
+	for (int stage = 0; stage < graph.size(); stage++) {
+		const StageGraph::Timing &timing = graph.timing(stage);
+		out << std::setw(12) << graph.name(stage)
+			<< " runs " << std::setw(6) << timing.runs
+			<< " last " << std::setw(9) << timing.last_ms << " ms"
+			<< " mean " << std::setw(9) << timing.total_ms / std::max(timing.runs, 1) << " ms\n";
+	}
+}
+
+//-----------------------------------------------------------------------------
+
+bool sameImage(const cv::Mat &a, const cv::Mat &b) {
+	if (a.size() != b.size() || a.type() != b.type()) {
+		return false;
+	}
+	const size_t row_bytes = a.cols * a.elemSize();
+	for (int y = 0; y < a.rows; y++) {
+		if (std::memcmp(a.ptr(y), b.ptr(y), row_bytes) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+TargetPipeline::TargetPipeline(TargetExtractorData *data)
+	: data(data),
+	preprocess_stage(graph.addStage("preprocess", {}, {}, [this]() {
+		this->data->img = input;
+		preprocessInput(this->data);
+	})),
+	smooth_stage(graph.addStage("smooth", {preprocess_stage}, {"smoothing"}, [this]() {
+		smoothTargetInput(this->data, graph.parameter("smoothing"));
+	})),
+	face_stage(graph.addStage("face", {smooth_stage}, {"dilate", "threshold"}, [this]() {
+		this->data->poly.clear();
+		this->data->homography.release();
+		this->data->warped.release();
+		extractSmoothedTargetFace(this->data,
+			graph.parameter("dilate"), graph.parameter("threshold"));
+	})),
+	edges_stage(graph.addStage("edges", {face_stage}, {"canny1", "canny2"}, [this]() {
+		if (this->data->warped.empty()) {
+			this->data->warped_edges.release();
+			return;
+		}
+		detectEdges(this->data, graph.parameter("canny1"), graph.parameter("canny2"));
+	})),
+	lines_stage(graph.addStage("lines", {edges_stage}, {"hough"}, [this]() {
+		if (this->data->warped_edges.empty()) {
+			this->data->lines.clear();
+			this->data->lines_drawing.release();
+			return;
+		}
+		detectLines(this->data, graph.parameter("hough"));
+	})) {
+	setParameters(3, 3, 240, 50, 200, 50);
+}
+
+void TargetPipeline::setInput(const cv::Mat &frame) {
+	if (sameImage(frame, input)) {
+		return;
+	}
+	frame.copyTo(input);
+	graph.invalidate(preprocess_stage);
+}
+
+void TargetPipeline::setParameters(int smoothing, int dilate, int threshold,
+	int canny1, int canny2, int hough) {
+	graph.setParameter("smoothing", smoothing);
+	graph.setParameter("dilate", dilate);
+	graph.setParameter("threshold", threshold);
+	graph.setParameter("canny1", canny1);
+	graph.setParameter("canny2", canny2);
+	graph.setParameter("hough", hough);
+}
@@ -0,0 +1,100 @@
+#ifndef _PIPELINE_H
+#define _PIPELINE_H
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "target.h"
+
+// Lazily evaluated graph of stages. A stage declares the stages and named
+// integer parameters it reads and is recomputed on evaluation only when it
+// was invalidated, an input stage was recomputed or one of its parameters
+// changed since its last run.
+class StageGraph {
+ public:
+	using Compute = std::function<void()>;
+
+	struct Timing {
+		int runs = 0;
+		float last_ms = 0;
+		double total_ms = 0;
+	};
+
+ private:
+	struct Stage {
+		std::string name;
+		std::vector<int> inputs;
+		std::vector<std::string> parameters;
+		Compute compute;
+		bool dirty = true;
+		uint64_t version = 0;
+		std::vector<uint64_t> input_versions;
+		std::vector<int> parameter_values;
+		Timing timing;
+	};
+
+	std::vector<Stage> stages;
+	std::map<std::string, int> parameters;
+
+ public:
+	// Inputs must be added before the stage, which keeps the graph acyclic.
+	int addStage(const std::string &name,
+		const std::vector<int> &inputs,
+		const std::vector<std::string> &parameters,
+		Compute compute);
+	void setParameter(const std::string &name, int value);
+	int parameter(const std::string &name) const;
+	// Forces the stage to run on next evaluation, for stages reading data
+	// from outside of the graph.
+	void invalidate(int stage);
+	// Brings the stage and its inputs up to date and returns its version,
+	// which increments with every run.
+	uint64_t evaluate(int stage);
+
+	int size() const { return stages.size(); }
+	const std::string &name(int stage) const { return stages[stage].name; }
+	const Timing &timing(int stage) const { return stages[stage].timing; }
+};
+
+void printStageTimings(std::ostream &out, const StageGraph &graph);
+
+// extractTargetFace and detectArrows as a stage graph over
+// TargetExtractorData, so that changing canny1 reruns only edge and line
+// detection and setting an identical frame reruns nothing.
+class TargetPipeline {
+	TargetExtractorData *data;
+	StageGraph graph;
+	cv::Mat input;
+
+ public:
+	const int preprocess_stage;
+	const int smooth_stage;
+	const int face_stage;
+	const int edges_stage;
+	const int lines_stage;
+
+	explicit TargetPipeline(TargetExtractorData *data);
+	TargetPipeline(const TargetPipeline&) = delete;
+	TargetPipeline &operator=(const TargetPipeline&) = delete;
+
+	// The frame is copied, a frame equal to the previous one keeps all
+	// cached stage results.
+	void setInput(const cv::Mat &frame);
+	void setParameters(int smoothing, int dilate, int threshold,
+		int canny1, int canny2, int hough);
+
+	void extractTargetFace() { graph.evaluate(face_stage); }
+	void detectArrows() { graph.evaluate(lines_stage); }
+
+	StageGraph &stages() { return graph; }
+	const StageGraph &stages() const { return graph; }
+};
+
+#endif  // _PIPELINE_H
@@ -0,0 +1,79 @@
+#include <vector>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE PipelineTest
+
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "pipeline.h"
+#include "synthetic.h"
+#include "target.h"
+
+BOOST_AUTO_TEST_CASE(test_stage_graph_recomputes_downstream_only) {
+	StageGraph graph;
+	int a_runs = 0, b_runs = 0, c_runs = 0;
+	const int a = graph.addStage("a", {}, {"x"}, [&a_runs]() { a_runs++; });
+	const int b = graph.addStage("b", {a}, {"y"}, [&b_runs]() { b_runs++; });
+	const int c = graph.addStage("c", {b}, {}, [&c_runs]() { c_runs++; });
+	graph.setParameter("x", 1);
+	graph.setParameter("y", 1);
+
+	graph.evaluate(c);
+	graph.evaluate(c);
+	BOOST_CHECK_EQUAL(a_runs, 1);
+	BOOST_CHECK_EQUAL(b_runs, 1);
+	BOOST_CHECK_EQUAL(c_runs, 1);
+
+	graph.setParameter("y", 2);
+	graph.evaluate(c);
+	BOOST_CHECK_EQUAL(a_runs, 1);
+	BOOST_CHECK_EQUAL(b_runs, 2);
+	BOOST_CHECK_EQUAL(c_runs, 2);
+
+	graph.setParameter("x", 1);
+	graph.evaluate(c);
+	BOOST_CHECK_EQUAL(a_runs, 1);
+
+	graph.invalidate(a);
+	graph.evaluate(b);
+	BOOST_CHECK_EQUAL(a_runs, 2);
+	BOOST_CHECK_EQUAL(b_runs, 3);
+	BOOST_CHECK_EQUAL(c_runs, 2);
+	BOOST_CHECK_EQUAL(graph.timing(b).runs, 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_target_pipeline_matches_direct_calls) {
+	SyntheticTargetRenderer renderer(512, 1);
+	SyntheticScene scene;
+	scene.pose = {10, -10, 300, 0.2, 0.1, 0.3};
+	scene.arrows.push_back({cv::Vec2f{0.2f, -0.1f}, 0.5f, 0.5f});
+	const cv::Mat frame = renderer.render(scene).image;
+
+	TargetExtractorData expected(cv::Size(256, 256), 256);
+	expected.img = frame;
+	preprocessInput(&expected);
+	extractTargetFace(&expected, 3, 3, 240);
+	detectArrows(&expected, 80, 200, 50);
+
+	TargetExtractorData data(cv::Size(256, 256), 256);
+	TargetPipeline pipeline(&data);
+	pipeline.setParameters(3, 3, 240, 50, 200, 50);
+	pipeline.setInput(frame);
+	pipeline.detectArrows();
+
+	pipeline.setParameters(3, 3, 240, 80, 200, 50);
+	pipeline.setInput(frame.clone());
+	pipeline.detectArrows();
+
+	const StageGraph &stages = pipeline.stages();
+	BOOST_CHECK_EQUAL(stages.timing(pipeline.preprocess_stage).runs, 1);
+	BOOST_CHECK_EQUAL(stages.timing(pipeline.face_stage).runs, 1);
+	BOOST_CHECK_EQUAL(stages.timing(pipeline.edges_stage).runs, 2);
+	BOOST_CHECK_EQUAL(stages.timing(pipeline.lines_stage).runs, 2);
+
+	BOOST_CHECK(data.poly == expected.poly);
+	BOOST_CHECK(data.lines == expected.lines);
+}
@@ -0,0 +1,51 @@
+#include "quality.h"
+
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+FrameQuality assessFrameQuality(const cv::Mat &value, const PlaneStatistics &statistics,
+	const QualityThresholds &thresholds) {
+	FrameQuality quality;
+	quality.highlight = statistics.percentile(0.99);
+	quality.median = statistics.percentile(0.5);
+
+	// Exposure comes from the histogram for free, the Laplacian pass is
+	// skipped for frames which fail it.
+	if (quality.highlight < thresholds.min_highlight || quality.median > thresholds.max_median) {
+		return quality;
+	}
+	cv::Mat laplacian;
+	cv::Laplacian(value, laplacian, CV_16S);
+	cv::Scalar mean, std_dev;
+	cv::meanStdDev(laplacian, mean, std_dev);
+	quality.sharpness = std_dev[0] * std_dev[0];
+	quality.acceptable = quality.sharpness >= thresholds.min_sharpness;
+	return quality;
+}
+
+BurstSelector::BurstSelector(int burst_size)
+	: burst_size(std::max(burst_size, 1)), offered(0) {
+}
+
+bool BurstSelector::offer(const cv::Mat &frame, const FrameQuality &quality) {
+	if (quality.acceptable &&
+		(best_frame.empty() || quality.sharpness > best_quality.sharpness)) {
+		// The capture buffer is reused for the next frame.
+		frame.copyTo(best_frame);
+		best_quality = quality;
+	}
+	return ++offered >= burst_size;
+}
+
+cv::Mat BurstSelector::take(FrameQuality *quality) {
+	cv::Mat frame = best_frame;
+	if (quality) {
+		*quality = best_quality;
+	}
+	best_frame = cv::Mat();
+	best_quality = FrameQuality();
+	offered = 0;
+	return frame;
+}
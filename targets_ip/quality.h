@@ -0,0 +1,49 @@
+#ifndef _QUALITY_H
+#define _QUALITY_H
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include "stats.h"
+
+struct QualityThresholds {
+	// Variance of the Laplacian of the resized V plane.
+	double min_sharpness = 20;
+	// The brightest percent of the frame must reach this value...
+	int min_highlight = 64;
+	// ...and at most half of it may be saturated.
+	int max_median = 250;
+};
+
+struct FrameQuality {
+	double sharpness = 0;
+	int highlight = 0;  // 99th percentile of V
+	int median = 0;
+	bool acceptable = false;
+};
+
+// Sharpness and exposure of a resized 8-bit V plane, statistics being its
+// distribution.
+FrameQuality assessFrameQuality(const cv::Mat &value, const PlaneStatistics &statistics,
+	const QualityThresholds &thresholds);
+
+// Picks the sharpest acceptable frame of every burst_size offered frames.
+class BurstSelector {
+ private:
+	int burst_size;
+	int offered;
+	cv::Mat best_frame;
+	FrameQuality best_quality;
+
+ public:
+	explicit BurstSelector(int burst_size);
+
+	// Copies the frame if it is the best of the burst so far. Returns true
+	// once the burst is complete.
+	bool offer(const cv::Mat &frame, const FrameQuality &quality);
+	// Best frame of the completed burst, empty if no frame was acceptable,
+	// and starts the next burst.
+	cv::Mat take(FrameQuality *quality = nullptr);
+};
+
+#endif  // _QUALITY_H
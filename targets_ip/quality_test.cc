@@ -0,0 +1,72 @@
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE QualityTest
+
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "quality.h"
+#include "stats.h"
+
+cv::Mat checkerboard(int cell, uchar dark, uchar bright) {
+	cv::Mat plane(192, 256, CV_8UC1, cv::Scalar(dark));
+	for (int y = 0; y < plane.rows; y += cell) {
+		for (int x = (y / cell) % 2 * cell; x < plane.cols; x += 2 * cell) {
+			plane(cv::Rect(x, y, cell, cell) & cv::Rect(0, 0, plane.cols, plane.rows)) = bright;
+		}
+	}
+	return plane;
+}
+
+FrameQuality assess(const cv::Mat &plane) {
+	PlaneStatistics statistics;
+	computePlaneStatistics(plane, &statistics);
+	return assessFrameQuality(plane, statistics, QualityThresholds());
+}
+
+BOOST_AUTO_TEST_CASE(test_blur_lowers_sharpness) {
+	const cv::Mat sharp = checkerboard(16, 40, 220);
+	cv::Mat blurred;
+	cv::GaussianBlur(sharp, blurred, cv::Size(0, 0), 6);
+
+	const FrameQuality sharp_quality = assess(sharp);
+	const FrameQuality blurred_quality = assess(blurred);
+	BOOST_CHECK(sharp_quality.acceptable);
+	BOOST_CHECK_GT(sharp_quality.sharpness, 10 * blurred_quality.sharpness);
+	BOOST_CHECK(!blurred_quality.acceptable);
+}
+
+BOOST_AUTO_TEST_CASE(test_exposure_rejects) {
+	const FrameQuality dark = assess(checkerboard(16, 0, 40));
+	BOOST_CHECK(!dark.acceptable);
+	BOOST_CHECK_EQUAL(dark.sharpness, 0);
+
+	const FrameQuality saturated = assess(cv::Mat(64, 64, CV_8UC1, cv::Scalar(255)));
+	BOOST_CHECK(!saturated.acceptable);
+}
+
+BOOST_AUTO_TEST_CASE(test_burst_selects_sharpest) {
+	const cv::Mat sharp = checkerboard(16, 40, 220);
+	cv::Mat soft, blurred;
+	cv::GaussianBlur(sharp, soft, cv::Size(0, 0), 1);
+	cv::GaussianBlur(sharp, blurred, cv::Size(0, 0), 6);
+
+	BurstSelector burst(3);
+	BOOST_CHECK(!burst.offer(soft, assess(soft)));
+	BOOST_CHECK(!burst.offer(sharp, assess(sharp)));
+	BOOST_CHECK(burst.offer(blurred, assess(blurred)));
+
+	FrameQuality quality;
+	const cv::Mat best = burst.take(&quality);
+	BOOST_CHECK_EQUAL(cv::norm(best, sharp, cv::NORM_INF), 0);
+	BOOST_CHECK_EQUAL(quality.sharpness, assess(sharp).sharpness);
+
+	// Nothing acceptable in the next burst.
+	const cv::Mat dark = checkerboard(16, 0, 40);
+	BOOST_CHECK(!burst.offer(dark, assess(dark)));
+	BOOST_CHECK(!burst.offer(blurred, assess(blurred)));
+	BOOST_CHECK(burst.offer(dark, assess(dark)));
+	BOOST_CHECK(burst.take().empty());
+}
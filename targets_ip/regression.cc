@@ -0,0 +1,396 @@
+#include "regression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include "annotations.h"
+#include "image_pack.h"
+#include "io.h"
+#include "synthetic.h"
+#include "target.h"
+#include "target_model.h"
+#include "utils.h"
+
+namespace fs = boost::filesystem;
+
+using cv::Point2f;
+using cv::Vec2f;
+using cv::Vec3f;
+
+// Latency changes below this many milliseconds are considered noise.
+const double LATENCY_NOISE_MS = 0.05;
+
+std::vector<LabeledFrame> syntheticDataset(int frames, uint64 seed,
+	cv::Size image_size, int max_arrows) {
+	SyntheticTargetRenderer renderer(512, seed);
+	cv::RNG rng(seed);
+	std::vector<LabeledFrame> dataset;
+	for (int i = 0; i < frames; i++) {
+		SyntheticFrame frame = renderer.render(
+			randomSyntheticScene(&rng, image_size, max_arrows));
+		dataset.push_back({frame.image, frame.quad, frame.pose, frame.hits, frame.shafts});
+	}
+	return dataset;
+}
+
+LabeledFrame labeledFrame(const cv::Mat &image, const Annotation &annotation) {
+	LabeledFrame frame;
+	frame.image = image;
+	for (const auto &shape : annotation.shapes) {
+		if (shape.shape_type == "point" && !shape.points.empty()) {
+			frame.hits.push_back(shape.points[0]);
+		} else if (shape.shape_type == "polygon" && shape.points.size() == 4) {
+			frame.quad = shape.points;
+		}
+	}
+	return frame;
+}
+
+std::vector<LabeledFrame> labelmeDataset(const std::string &directory) {
+	std::vector<LabeledFrame> dataset;
+	for (const auto &filename : listAnnotations(directory)) {
+		const Annotation annotation = loadAnnotation(filename);
+		dataset.push_back(labeledFrame(loadImage(annotation.image_path), annotation));
+	}
+	return dataset;
+}
+
+std::vector<LabeledFrame> packDataset(const std::string &filename) {
+	const ImagePackReader pack(filename);
+	std::vector<LabeledFrame> dataset;
+	for (size_t i = 0; i < pack.size(); i++) {
+		const std::string &label = pack.entry(i).label;
+		dataset.push_back(labeledFrame(pack.decode(i),
+			label.empty() ? Annotation() : parseAnnotation(label, "")));
+	}
+	return dataset;
+}
+
+//-----------------------------------------------------------------------------
+
+float quadCornerError(const std::vector<Point2f> &detected,
+	const std::vector<Point2f> &truth) {
+	float total_error = 0;
+	for (const auto &corner : detected) {
+		float nearest = std::numeric_limits<float>::max();
+		for (const auto &expected : truth) {
+			nearest = std::min(nearest, dist(Vec2f(corner), Vec2f(expected)));
+		}
+		total_error += nearest;
+	}
+	return total_error / detected.size();
+}
+
+// Matches detected segments in face coordinates against ground truth arrows
+// mapped through the face homography. With known shafts a segment must lie
+// along a shaft, otherwise it must pass close to a hit.
+void evaluateSegments(const LabeledFrame &frame, float scale,
+	const TargetExtractorData &data, float tolerance,
+	FrameEvaluation *evaluation) {
+	std::vector<Point2f> points;
+	for (const auto &shaft : frame.shafts) {
+		points.emplace_back(shaft[0] * scale, shaft[1] * scale);
+		points.emplace_back(shaft[2] * scale, shaft[3] * scale);
+	}
+	if (frame.shafts.empty()) {
+		for (const auto &hit : frame.hits) {
+			points.push_back(hit * scale);
+		}
+	}
+	std::vector<Point2f> face_points;
+	if (!points.empty()) {
+		cv::perspectiveTransform(points, face_points, data.homography);
+	}
+
+	std::vector<bool> recalled(evaluation->arrows, false);
+	for (const auto &line : data.lines) {
+		const Vec2f a(line[0], line[1]);
+		const Vec2f b(line[2], line[3]);
+		bool matched = false;
+		for (int arrow = 0; arrow < evaluation->arrows; arrow++) {
+			float distance;
+			if (!frame.shafts.empty()) {
+				const Vec2f hit(face_points[2 * arrow]);
+				const Vec2f tail(face_points[2 * arrow + 1]);
+				distance = std::max(pointSegmentDistance(a, hit, tail),
+					pointSegmentDistance(b, hit, tail));
+			} else {
+				distance = pointSegmentDistance(Vec2f(face_points[arrow]), a, b);
+			}
+			if (distance <= tolerance) {
+				matched = true;
+				recalled[arrow] = true;
+			}
+		}
+		evaluation->true_segments += matched;
+	}
+	evaluation->segments = data.lines.size();
+	evaluation->recalled_arrows = std::count(recalled.begin(), recalled.end(), true);
+}
+
+Vec3f targetNormal(const std::vector<double> &pose) {
+	const Vec3f angles(pose[3], pose[4], pose[5]);
+	return eulerAnglesToRotationMatrix(angles) * Vec3f{0, 0, -1};
+}
+
+void scoreDetection(const LabeledFrame &frame,
+	const PipelineParameters &parameters,
+	const TargetExtractorData &data,
+	FrameEvaluation *evaluation) {
+	evaluation->arrows = frame.shafts.empty() ? frame.hits.size() : frame.shafts.size();
+	evaluation->quad_found = data.poly.size() == 4 && !data.homography.empty();
+	if (!evaluation->quad_found) {
+		return;
+	}
+
+	const float scale = data.img_resized.cols / static_cast<float>(data.img.cols);
+	if (!frame.quad.empty()) {
+		std::vector<Point2f> detected;
+		for (const auto &corner : data.poly) {
+			detected.push_back(Point2f(corner) / scale);
+		}
+		evaluation->corner_evaluated = true;
+		evaluation->corner_error = quadCornerError(detected, frame.quad);
+	}
+	evaluateSegments(frame, scale, data, parameters.hit_tolerance, evaluation);
+}
+
+FrameEvaluation evaluateFrame(const LabeledFrame &frame,
+	const PipelineParameters &parameters,
+	TargetExtractorData *data,
+	LineDetector *line_detector) {
+	FrameEvaluation evaluation;
+	Stopwatch stopwatch;
+	data->img = frame.image;
+	preprocessInput(data);
+	evaluation.stage_ms[STAGE_PREPROCESS] = stopwatch.lap();
+
+	data->poly.clear();
+	data->homography.release();
+	extractTargetFace(data, parameters.smoothing, parameters.dilate, parameters.threshold);
+	evaluation.stage_ms[STAGE_EXTRACT] = stopwatch.lap();
+
+	evaluation.quad_found = data->poly.size() == 4 && !data->homography.empty();
+	if (evaluation.quad_found) {
+		if (line_detector) {
+			detectArrows(data, line_detector);
+		} else {
+			detectArrows(data, parameters.canny1, parameters.canny2, parameters.hough);
+		}
+		evaluation.stage_ms[STAGE_DETECT] = stopwatch.lap();
+	}
+	scoreDetection(frame, parameters, *data, &evaluation);
+
+	if (parameters.fit && frame.pose.size() == 6) {
+		stopwatch.lap();
+		const std::vector<double> pose = fit_target_model_pose(frame.image,
+			evaluation.quad_found ? faceCorners(*data) : std::vector<cv::Point2f>(),
+			parameters.template_cost ? FitCostEngine::TEMPLATE : FitCostEngine::SAMPLED);
+		evaluation.stage_ms[STAGE_FIT] = stopwatch.lap();
+
+		const Vec3f translation(pose[0] - frame.pose[0],
+			pose[1] - frame.pose[1],
+			pose[2] - frame.pose[2]);
+		const float cos_angle = targetNormal(pose).dot(targetNormal(frame.pose));
+		evaluation.pose_evaluated = true;
+		evaluation.translation_error = cv::norm(translation);
+		evaluation.rotation_error = std::acos(std::clamp(cos_angle, -1.0f, 1.0f));
+	}
+	return evaluation;
+}
+
+RegressionMetrics summarizeEvaluations(const std::vector<FrameEvaluation> &evaluations) {
+	RegressionMetrics metrics;
+	metrics.frames = evaluations.size();
+
+	double total_ms = 0;
+	int stage_counts[STAGE_COUNT] = {};
+	int quads = 0, corners = 0, poses = 0;
+	int arrows = 0, recalled_arrows = 0, segments = 0, true_segments = 0;
+	for (const auto &evaluation : evaluations) {
+		const bool stage_ran[STAGE_COUNT] = {
+			true, true, evaluation.quad_found, evaluation.pose_evaluated};
+		for (int stage = 0; stage < STAGE_COUNT; stage++) {
+			total_ms += evaluation.stage_ms[stage];
+			if (stage_ran[stage]) {
+				metrics.stage_ms[stage] += evaluation.stage_ms[stage];
+				stage_counts[stage]++;
+			}
+		}
+		quads += evaluation.quad_found;
+		if (evaluation.corner_evaluated) {
+			metrics.corner_error += evaluation.corner_error;
+			corners++;
+		}
+		if (evaluation.pose_evaluated) {
+			metrics.translation_error += evaluation.translation_error;
+			metrics.rotation_error += evaluation.rotation_error;
+			poses++;
+		}
+		arrows += evaluation.arrows;
+		recalled_arrows += evaluation.recalled_arrows;
+		segments += evaluation.segments;
+		true_segments += evaluation.true_segments;
+	}
+
+	for (int stage = 0; stage < STAGE_COUNT; stage++) {
+		metrics.stage_ms[stage] /= std::max(stage_counts[stage], 1);
+	}
+	metrics.fps = total_ms > 0 ? 1000.0 * metrics.frames / total_ms : 0;
+	metrics.quad_detection_rate = metrics.frames ? quads / static_cast<double>(metrics.frames) : 0;
+	metrics.corner_error /= std::max(corners, 1);
+	metrics.translation_error /= std::max(poses, 1);
+	metrics.rotation_error /= std::max(poses, 1);
+	metrics.recall = arrows ? recalled_arrows / static_cast<double>(arrows) : 1;
+	metrics.precision = segments ? true_segments / static_cast<double>(segments) : 1;
+	metrics.segments_per_face = quads ? segments / static_cast<double>(quads) : 0;
+	return metrics;
+}
+
+RegressionMetrics evaluateDataset(const std::vector<LabeledFrame> &dataset,
+	const PipelineParameters &parameters) {
+	TargetExtractorData data(parameters.target_size, parameters.scaled_input_size);
+	data.warp_from_original = parameters.warp_from_original;
+	LineDetectorParameters line_parameters;
+	line_parameters.canny1 = parameters.canny1;
+	line_parameters.canny2 = parameters.canny2;
+	line_parameters.hough = parameters.hough;
+	auto line_detector = createLineDetector(parameters.line_detector, line_parameters);
+
+	std::vector<FrameEvaluation> evaluations;
+	for (const auto &frame : dataset) {
+		evaluations.push_back(evaluateFrame(frame, parameters, &data, line_detector.get()));
+	}
+	return summarizeEvaluations(evaluations);
+}
+
+//-----------------------------------------------------------------------------
+
+bool loadMetrics(const std::string &filename, RegressionMetrics *metrics) {
+	if (!fs::exists(filename)) {
+		return false;
+	}
+	cv::FileStorage storage(filename, cv::FileStorage::READ);
+	if (!storage.isOpened()) {
+		return false;
+	}
+	storage["frames"] >> metrics->frames;
+	storage["fps"] >> metrics->fps;
+	for (int stage = 0; stage < STAGE_COUNT; stage++) {
+		storage[std::string(stageName(static_cast<Stage>(stage))) + "_ms"] >>
+			metrics->stage_ms[stage];
+	}
+	storage["quad_detection_rate"] >> metrics->quad_detection_rate;
+	storage["corner_error"] >> metrics->corner_error;
+	storage["translation_error"] >> metrics->translation_error;
+	storage["rotation_error"] >> metrics->rotation_error;
+	storage["recall"] >> metrics->recall;
+	storage["precision"] >> metrics->precision;
+	storage["segments_per_face"] >> metrics->segments_per_face;
+	return true;
+}
+
+void storeMetrics(const std::string &filename, const RegressionMetrics &metrics) {
+	cv::FileStorage storage(filename, cv::FileStorage::WRITE);
+	storage << "frames" << metrics.frames;
+	storage << "fps" << metrics.fps;
+	for (int stage = 0; stage < STAGE_COUNT; stage++) {
+		storage << std::string(stageName(static_cast<Stage>(stage))) + "_ms"
+			<< metrics.stage_ms[stage];
+	}
+	storage << "quad_detection_rate" << metrics.quad_detection_rate;
+	storage << "corner_error" << metrics.corner_error;
+	storage << "translation_error" << metrics.translation_error;
+	storage << "rotation_error" << metrics.rotation_error;
+	storage << "recall" << metrics.recall;
+	storage << "precision" << metrics.precision;
+	storage << "segments_per_face" << metrics.segments_per_face;
+}
+
+void printMetrics(std::ostream &out, const RegressionMetrics &metrics) {
+	out << std::fixed << std::setprecision(3)
+		<< "frames              " << metrics.frames << "\n"
+		<< "fps                 " << metrics.fps << "\n";
+	for (int stage = 0; stage < STAGE_COUNT; stage++) {
+		out << std::setw(20) << std::left
+			<< std::string(stageName(static_cast<Stage>(stage))) + " ms"
+			<< metrics.stage_ms[stage] << "\n";
+	}
+	out << "quad detection rate " << metrics.quad_detection_rate << "\n"
+		<< "corner error px     " << metrics.corner_error << "\n"
+		<< "translation error   " << metrics.translation_error << "\n"
+		<< "rotation error rad  " << metrics.rotation_error << "\n"
+		<< "hit recall          " << metrics.recall << "\n"
+		<< "hit precision       " << metrics.precision << "\n"
+		<< "segments per face   " << metrics.segments_per_face << "\n";
+}
+
+void compareLineDetectors(std::ostream &out,
+	const std::vector<LabeledFrame> &dataset,
+	const PipelineParameters &parameters) {
+	out << std::fixed << std::setprecision(3) << std::left
+		<< std::setw(14) << "detector"
+		<< std::setw(12) << "detect ms"
+		<< std::setw(12) << "segments"
+		<< std::setw(10) << "recall"
+		<< "precision\n";
+	for (const auto &name : availableLineDetectors()) {
+		PipelineParameters detector_parameters = parameters;
+		detector_parameters.line_detector = name;
+		const RegressionMetrics metrics = evaluateDataset(dataset, detector_parameters);
+		out << std::setw(14) << name
+			<< std::setw(12) << metrics.stage_ms[STAGE_DETECT]
+			<< std::setw(12) << metrics.segments_per_face
+			<< std::setw(10) << metrics.recall
+			<< metrics.precision << "\n";
+	}
+}
+
+std::vector<std::string> compareMetrics(const RegressionMetrics &current,
+	const RegressionMetrics &baseline,
+	const RegressionTolerances &tolerances) {
+	std::vector<std::string> failures;
+	auto check = [&failures](bool regressed, const std::string &name,
+		double current_value, double baseline_value) {
+		if (regressed) {
+			failures.push_back(name + " regressed: " + std::to_string(current_value) +
+				" (baseline " + std::to_string(baseline_value) + ")");
+		}
+	};
+
+	if (tolerances.check_throughput) {
+		check(current.fps < baseline.fps * (1 - tolerances.fps),
+			"fps", current.fps, baseline.fps);
+		for (int stage = 0; stage < STAGE_COUNT; stage++) {
+			const double limit = baseline.stage_ms[stage] * (1 + tolerances.latency) +
+				LATENCY_NOISE_MS;
+			check(baseline.stage_ms[stage] > 0 && current.stage_ms[stage] > limit,
+				std::string(stageName(static_cast<Stage>(stage))) + " latency",
+				current.stage_ms[stage], baseline.stage_ms[stage]);
+		}
+	}
+	check(current.quad_detection_rate < baseline.quad_detection_rate - tolerances.quad_detection_rate,
+		"quad detection rate", current.quad_detection_rate, baseline.quad_detection_rate);
+	check(current.corner_error > baseline.corner_error + tolerances.corner_error,
+		"corner error", current.corner_error, baseline.corner_error);
+	check(current.translation_error > baseline.translation_error + tolerances.translation_error,
+		"translation error", current.translation_error, baseline.translation_error);
+	check(current.rotation_error > baseline.rotation_error + tolerances.rotation_error,
+		"rotation error", current.rotation_error, baseline.rotation_error);
+	check(current.recall < baseline.recall - tolerances.recall,
+		"hit recall", current.recall, baseline.recall);
+	check(current.precision < baseline.precision - tolerances.precision,
+		"hit precision", current.precision, baseline.precision);
+	check(baseline.segments_per_face > 0 &&
+		current.segments_per_face > baseline.segments_per_face * (1 + tolerances.segments_per_face),
+		"segments per face", current.segments_per_face, baseline.segments_per_face);
+	return failures;
+}
@@ -0,0 +1,129 @@
+#ifndef _REGRESSION_H
+#define _REGRESSION_H
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "line_detector.h"
+#include "result_log.h"
+#include "target.h"
+
+// Image with ground truth in image coordinates. Pose and shafts are known
+// only for synthetic frames, annotated photos carry quad corners and hits.
+struct LabeledFrame {
+	cv::Mat image;
+	std::vector<cv::Point2f> quad;
+	std::vector<double> pose;
+	std::vector<cv::Point2f> hits;
+	std::vector<cv::Vec4f> shafts;
+};
+
+std::vector<LabeledFrame> syntheticDataset(int frames, uint64 seed,
+	cv::Size image_size, int max_arrows);
+
+// Loads labelme annotations (*.json) as produced for targets_tf. Point
+// shapes are arrow hits, a four point polygon is the target face.
+std::vector<LabeledFrame> labelmeDataset(const std::string &directory);
+// Frames of an image pack built from a labelme annotated directory.
+std::vector<LabeledFrame> packDataset(const std::string &filename);
+
+struct PipelineParameters {
+	cv::Size target_size{256, 256};
+	int scaled_input_size = 256;
+	int smoothing = 3;
+	int dilate = 3;
+	int threshold = 240;
+	int canny1 = 50;
+	int canny2 = 200;
+	int hough = 50;
+	std::string line_detector = "hough";
+	bool warp_from_original = false;
+	bool fit = false;
+	bool template_cost = false;  // fit with FitCostEngine::TEMPLATE
+	float hit_tolerance = 6.0f;  // face pixels
+};
+
+struct FrameEvaluation {
+	bool quad_found = false;
+	bool corner_evaluated = false;
+	float corner_error = 0;
+	int arrows = 0;
+	int recalled_arrows = 0;
+	int segments = 0;
+	int true_segments = 0;
+	bool pose_evaluated = false;
+	float translation_error = 0;
+	float rotation_error = 0;
+	float stage_ms[STAGE_COUNT] = {};
+};
+
+struct RegressionMetrics {
+	int frames = 0;
+	double fps = 0;
+	double stage_ms[STAGE_COUNT] = {};
+	double quad_detection_rate = 0;
+	double corner_error = 0;
+	double translation_error = 0;
+	double rotation_error = 0;
+	double recall = 0;
+	double precision = 0;
+	double segments_per_face = 0;
+};
+
+// Allowed degradation against the baseline. Throughput tolerances are
+// relative, accuracy tolerances absolute. Throughput depends on the machine
+// and is compared only with check_throughput, against a baseline recorded on
+// the same machine.
+struct RegressionTolerances {
+	bool check_throughput = false;
+	double fps = 0.3;
+	double latency = 0.3;
+	double quad_detection_rate = 0.02;
+	double corner_error = 0.5;
+	double translation_error = 2.0;
+	double rotation_error = 0.02;
+	double recall = 0.05;
+	double precision = 0.05;
+	// Relative, more segments per face load every later stage. Not compared
+	// against a baseline without segments.
+	double segments_per_face = 0.5;
+};
+
+// Mean distance of detected corners to the nearest ground truth corner.
+float quadCornerError(const std::vector<cv::Point2f> &detected,
+	const std::vector<cv::Point2f> &truth);
+
+// Fills the accuracy part of an evaluation from an extracted face and the
+// lines detected on it.
+void scoreDetection(const LabeledFrame &frame,
+	const PipelineParameters &parameters,
+	const TargetExtractorData &data,
+	FrameEvaluation *evaluation);
+// Without a line detector arrows are detected by the fixed Hough path.
+FrameEvaluation evaluateFrame(const LabeledFrame &frame,
+	const PipelineParameters &parameters,
+	TargetExtractorData *data,
+	LineDetector *line_detector = nullptr);
+RegressionMetrics summarizeEvaluations(const std::vector<FrameEvaluation> &evaluations);
+RegressionMetrics evaluateDataset(const std::vector<LabeledFrame> &dataset,
+	const PipelineParameters &parameters);
+
+bool loadMetrics(const std::string &filename, RegressionMetrics *metrics);
+void storeMetrics(const std::string &filename, const RegressionMetrics &metrics);
+void printMetrics(std::ostream &out, const RegressionMetrics &metrics);
+// Runs the dataset with every available line detector and prints detection
+// latency, segments per frame, recall and precision side by side.
+void compareLineDetectors(std::ostream &out,
+	const std::vector<LabeledFrame> &dataset,
+	const PipelineParameters &parameters);
+
+// Returns a description of every metric which regressed beyond tolerance.
+std::vector<std::string> compareMetrics(const RegressionMetrics &current,
+	const RegressionMetrics &baseline,
+	const RegressionTolerances &tolerances);
+
+#endif  // _REGRESSION_H
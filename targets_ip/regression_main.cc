@@ -0,0 +1,99 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "regression.h"
+
+namespace po = boost::program_options;
+
+// Accuracy-plus-throughput regression harness. Runs the pipeline over a
+// synthetic or labelme annotated dataset and compares the metrics against a
+// stored baseline. The baseline is written only with --update-baseline, a
+// missing baseline fails the run. Throughput is compared only with
+// --check-throughput.
+int main(int argc, char** argv) {
+	PipelineParameters parameters;
+	RegressionTolerances tolerances;
+	int frames = 100;
+	int seed = 1;
+	int image_height = 384;
+	std::string dataset_dir;
+	std::string pack_file;
+	std::string baseline_file = "regression_baseline.yml";
+
+	po::options_description options_description("Allowed options");
+	options_description.add_options()
+		("help", "produce help message")
+		("dataset", po::value<std::string>(&dataset_dir), "labelme annotated dataset, synthetic if not set")
+		("pack", po::value<std::string>(&pack_file), "image pack of a labelme annotated dataset")
+		("frames", po::value<int>(&frames), "number of synthetic frames")
+		("seed", po::value<int>(&seed), "synthetic dataset seed")
+		("image-height", po::value<int>(&image_height), "synthetic image height")
+		("baseline", po::value<std::string>(&baseline_file), "baseline metrics file")
+		("update-baseline", "store current metrics as baseline")
+		("check-throughput", "also compare fps and stage latency, against a baseline of this machine")
+		("fit", "evaluate pose fitting")
+		("template-cost", "fit with the warped face template cost")
+		("auto-threshold", "pick the face threshold per frame")
+		("warp-from-original", "warp faces from the full resolution image")
+		("line-detector", po::value<std::string>(&parameters.line_detector), "line detector backend (hough, lsd, fld, edge_drawing)")
+		("compare-line-detectors", "compare all available line detectors and exit")
+		("fps-tolerance", po::value<double>(&tolerances.fps), "allowed relative fps drop")
+		("latency-tolerance", po::value<double>(&tolerances.latency), "allowed relative stage latency increase")
+		("corner-tolerance", po::value<double>(&tolerances.corner_error), "allowed corner error increase in pixels")
+		("translation-tolerance", po::value<double>(&tolerances.translation_error), "allowed translation error increase")
+		("rotation-tolerance", po::value<double>(&tolerances.rotation_error), "allowed rotation error increase in radians")
+		("recall-tolerance", po::value<double>(&tolerances.recall), "allowed hit recall drop")
+		("precision-tolerance", po::value<double>(&tolerances.precision), "allowed hit precision drop")
+		("segments-tolerance", po::value<double>(&tolerances.segments_per_face), "allowed relative segments per face increase");
+
+	po::variables_map variables_map;
+	po::store(po::parse_command_line(argc, argv, options_description), variables_map);
+	po::notify(variables_map);
+
+	if (variables_map.count("help")) {
+		std::cout << options_description << "\n";
+		return 0;
+	}
+	tolerances.check_throughput = variables_map.count("check-throughput");
+	parameters.fit = variables_map.count("fit");
+	parameters.template_cost = variables_map.count("template-cost");
+	parameters.warp_from_original = variables_map.count("warp-from-original");
+	if (variables_map.count("auto-threshold")) {
+		parameters.threshold = AUTO_THRESHOLD;
+	}
+
+	const std::vector<LabeledFrame> dataset = !pack_file.empty()
+		? packDataset(pack_file)
+		: dataset_dir.empty()
+		? syntheticDataset(frames, seed, cv::Size(image_height * 4 / 3, image_height), 3)
+		: labelmeDataset(dataset_dir);
+
+	if (variables_map.count("compare-line-detectors")) {
+		compareLineDetectors(std::cout, dataset, parameters);
+		return 0;
+	}
+
+	const RegressionMetrics metrics = evaluateDataset(dataset, parameters);
+	printMetrics(std::cout, metrics);
+
+	if (variables_map.count("update-baseline")) {
+		storeMetrics(baseline_file, metrics);
+		std::cout << "Baseline stored to " << baseline_file << "\n";
+		return 0;
+	}
+	RegressionMetrics baseline;
+	if (!loadMetrics(baseline_file, &baseline)) {
+		std::cerr << "Could not load baseline " << baseline_file
+			<< ", record one with --update-baseline\n";
+		return 1;
+	}
+
+	const std::vector<std::string> failures = compareMetrics(metrics, baseline, tolerances);
+	for (const auto &failure : failures) {
+		std::cerr << failure << "\n";
+	}
+	return failures.empty() ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE RegressionTest
+
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "regression.h"
+
+BOOST_AUTO_TEST_CASE(test_quad_corner_error_ignores_order) {
+	const std::vector<cv::Point2f> truth{{0, 0}, {10, 0}, {10, 10}, {0, 10}};
+	const std::vector<cv::Point2f> detected{{10, 11}, {0, 10}, {1, 0}, {10, 0}};
+	BOOST_CHECK_CLOSE(quadCornerError(detected, truth), 0.5f, 0.0001);
+}
+
+BOOST_AUTO_TEST_CASE(test_compare_metrics) {
+	RegressionMetrics baseline;
+	baseline.fps = 100;
+	baseline.stage_ms[STAGE_EXTRACT] = 2;
+	baseline.recall = 0.8;
+	baseline.corner_error = 1;
+
+	RegressionMetrics current = baseline;
+	current.fps = 90;
+	current.corner_error = 1.2;
+	BOOST_CHECK(compareMetrics(current, baseline, RegressionTolerances()).empty());
+
+	current.fps = 50;
+	current.stage_ms[STAGE_EXTRACT] = 4;
+	current.recall = 0.5;
+	// Throughput is machine dependent and only compared on request.
+	BOOST_CHECK_EQUAL(compareMetrics(current, baseline, RegressionTolerances()).size(), 1);
+	RegressionTolerances throughput;
+	throughput.check_throughput = true;
+	BOOST_CHECK_EQUAL(compareMetrics(current, baseline, throughput).size(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_compare_segments_per_face) {
+	RegressionMetrics baseline;
+	baseline.segments_per_face = 10;
+	RegressionMetrics current = baseline;
+	current.segments_per_face = 14;
+	BOOST_CHECK(compareMetrics(current, baseline, RegressionTolerances()).empty());
+	current.segments_per_face = 20;
+	BOOST_CHECK_EQUAL(compareMetrics(current, baseline, RegressionTolerances()).size(), 1);
+
+	// Baselines without segments do not constrain them.
+	baseline.segments_per_face = 0;
+	BOOST_CHECK(compareMetrics(current, baseline, RegressionTolerances()).empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_synthetic_dataset_detection) {
+	const auto dataset = syntheticDataset(10, 3, cv::Size(512, 384), 2);
+	const RegressionMetrics metrics = evaluateDataset(dataset, PipelineParameters());
+	BOOST_CHECK_EQUAL(metrics.frames, 10);
+	BOOST_CHECK_GT(metrics.quad_detection_rate, 0.9);
+	BOOST_CHECK_LT(metrics.corner_error, 5.0);
+}
@@ -0,0 +1,430 @@
+#include "result_log.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+const char LOG_MAGIC[8] = {'T', 'G', 'T', 'S', 'L', 'O', 'G', '\0'};
+const uint32_t LOG_VERSION = 1;
+const uint32_t BLOCK_RECORD = 0x43455246;  // "FREC"
+const uint32_t BLOCK_INDEX = 0x58444946;  // "FIDX"
+const size_t GROWTH_CHUNK = 16 << 20;
+
+const uint32_t HAS_QUAD = 1;
+const uint32_t HAS_HOMOGRAPHY = 2;
+const uint32_t HAS_POSE = 4;
+
+struct LogFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t index_interval;
+	uint64_t data_end;
+	uint64_t last_index_offset;
+	uint64_t record_count;
+	uint8_t reserved[24];
+};
+static_assert(sizeof(LogFileHeader) == 64, "unexpected log header layout");
+
+struct BlockHeader {
+	uint32_t tag;
+	uint32_t size;
+};
+static_assert(sizeof(BlockHeader) == 8, "unexpected block header layout");
+
+// Fixed part of a record, followed by segment_count x int16[4] segments.
+struct RecordData {
+	uint64_t frame_index;
+	int64_t capture_timestamp_us;
+	double homography[9];
+	double pose[6];
+	float quad[8];
+	float stage_ms[STAGE_COUNT];
+	uint32_t flags;
+	uint32_t segment_count;
+};
+static_assert(sizeof(RecordData) == 192, "unexpected record layout");
+
+// Fixed part of an index block, followed by count x uint64 record offsets.
+struct IndexData {
+	uint64_t prev_index_offset;
+	uint64_t first_record;
+	uint32_t count;
+	uint32_t reserved;
+};
+static_assert(sizeof(IndexData) == 24, "unexpected index layout");
+
+const char *const STAGE_NAMES[STAGE_COUNT] = {"preprocess", "extract", "detect", "fit"};
+
+const char *stageName(Stage stage) {
+	return STAGE_NAMES[stage];
+}
+
+size_t alignBlock(size_t size) {
+	return (size + 7) & ~static_cast<size_t>(7);
+}
+
+template<typename T>
+T readAt(const uint8_t *mapping, uint64_t offset) {
+	T value;
+	std::memcpy(&value, mapping + offset, sizeof(T));
+	return value;
+}
+
+FrameResult decodeFrameResult(const uint8_t *payload, size_t size) {
+	if (size < sizeof(RecordData)) {
+		std::cerr << "Truncated frame result record\n";
+		abort();
+	}
+	const auto record = readAt<RecordData>(payload, 0);
+	if (size < sizeof(RecordData) + record.segment_count * 4 * sizeof(int16_t)) {
+		std::cerr << "Truncated frame result record\n";
+		abort();
+	}
+
+	FrameResult result;
+	result.frame_index = record.frame_index;
+	result.capture_timestamp_us = record.capture_timestamp_us;
+	if (record.flags & HAS_QUAD) {
+		for (int i = 0; i < 4; i++) {
+			result.quad.emplace_back(record.quad[2 * i], record.quad[2 * i + 1]);
+		}
+	}
+	if (record.flags & HAS_HOMOGRAPHY) {
+		result.homography = cv::Mat(3, 3, CV_64F);
+		std::memcpy(result.homography.data, record.homography, sizeof(record.homography));
+	}
+	if (record.flags & HAS_POSE) {
+		result.pose.assign(std::begin(record.pose), std::end(record.pose));
+	}
+	std::copy(std::begin(record.stage_ms), std::end(record.stage_ms), result.stage_ms);
+
+	const uint8_t *segments = payload + sizeof(RecordData);
+	result.segments.resize(record.segment_count);
+	for (uint32_t i = 0; i < record.segment_count; i++) {
+		int16_t coords[4];
+		std::memcpy(coords, segments + i * sizeof(coords), sizeof(coords));
+		result.segments[i] = cv::Vec4i(coords[0], coords[1], coords[2], coords[3]);
+	}
+	return result;
+}
+
+FrameResult decodeRecord(const uint8_t *mapping, uint64_t offset) {
+	const auto block = readAt<BlockHeader>(mapping, offset);
+	return decodeFrameResult(mapping + offset + sizeof(BlockHeader), block.size);
+}
+
+// Reads the header of the block at offset if the block with its payload lies
+// within the data blocks before end.
+bool readBlock(const uint8_t *mapping, uint64_t end, uint64_t offset, BlockHeader *block) {
+	if (offset < sizeof(LogFileHeader) || offset > end ||
+		end - offset < sizeof(BlockHeader)) {
+		return false;
+	}
+	*block = readAt<BlockHeader>(mapping, offset);
+	return end - offset - sizeof(BlockHeader) >= block->size;
+}
+
+std::vector<uint8_t> encodeFrameResult(const FrameResult &result) {
+	RecordData record{};
+	record.frame_index = result.frame_index;
+	record.capture_timestamp_us = result.capture_timestamp_us;
+	if (result.quad.size() == 4) {
+		for (int i = 0; i < 4; i++) {
+			record.quad[2 * i] = result.quad[i].x;
+			record.quad[2 * i + 1] = result.quad[i].y;
+		}
+		record.flags |= HAS_QUAD;
+	}
+	if (result.homography.total() == 9) {
+		cv::Mat homography;
+		result.homography.convertTo(homography, CV_64F);
+		std::memcpy(record.homography, homography.ptr<double>(), sizeof(record.homography));
+		record.flags |= HAS_HOMOGRAPHY;
+	}
+	if (result.pose.size() == 6) {
+		std::copy(result.pose.begin(), result.pose.end(), record.pose);
+		record.flags |= HAS_POSE;
+	}
+	std::copy(std::begin(result.stage_ms), std::end(result.stage_ms), record.stage_ms);
+	record.segment_count = result.segments.size();
+
+	std::vector<uint8_t> payload(sizeof(RecordData) + result.segments.size() * 4 * sizeof(int16_t));
+	std::memcpy(payload.data(), &record, sizeof(RecordData));
+	uint8_t *segments = payload.data() + sizeof(RecordData);
+	for (const auto &segment : result.segments) {
+		const int16_t coords[4] = {
+			cv::saturate_cast<int16_t>(segment[0]), cv::saturate_cast<int16_t>(segment[1]),
+			cv::saturate_cast<int16_t>(segment[2]), cv::saturate_cast<int16_t>(segment[3])};
+		std::memcpy(segments, coords, sizeof(coords));
+		segments += sizeof(coords);
+	}
+	return payload;
+}
+
+// Offset of the first block not covered by any index block, or 0 when the
+// last index block is damaged.
+uint64_t unindexedStart(const uint8_t *mapping, const LogFileHeader &header, uint64_t end) {
+	if (!header.last_index_offset) {
+		return sizeof(LogFileHeader);
+	}
+	BlockHeader block;
+	if (!readBlock(mapping, end, header.last_index_offset, &block) || block.tag != BLOCK_INDEX) {
+		return 0;
+	}
+	return header.last_index_offset + sizeof(BlockHeader) + block.size;
+}
+
+// Appends the record offsets of the blocks from begin up to end, stopping
+// at the first damaged block.
+void collectRecords(const uint8_t *mapping, uint64_t begin, uint64_t end,
+	std::vector<uint64_t> *offsets) {
+	BlockHeader block;
+	for (uint64_t offset = begin; readBlock(mapping, end, offset, &block);) {
+		if (block.tag == BLOCK_RECORD) {
+			offsets->push_back(offset);
+		} else if (block.tag != BLOCK_INDEX) {
+			return;
+		}
+		offset += sizeof(BlockHeader) + block.size;
+	}
+}
+
+// Record offsets of the index chain ending at last_index_offset, oldest
+// first. False if any index block or indexed record is damaged or an index
+// does not lead backwards.
+bool readIndexChain(const uint8_t *mapping, uint64_t end, uint64_t last_index_offset,
+	std::vector<uint64_t> *offsets) {
+	std::vector<std::vector<uint64_t>> index_blocks;
+	for (uint64_t index_offset = last_index_offset; index_offset;) {
+		BlockHeader block;
+		if (!readBlock(mapping, end, index_offset, &block) || block.tag != BLOCK_INDEX ||
+			block.size < sizeof(IndexData)) {
+			return false;
+		}
+		const uint64_t payload = index_offset + sizeof(BlockHeader);
+		const auto index = readAt<IndexData>(mapping, payload);
+		if ((block.size - sizeof(IndexData)) / sizeof(uint64_t) < index.count ||
+			index.prev_index_offset >= index_offset) {
+			return false;
+		}
+		std::vector<uint64_t> records(index.count);
+		std::memcpy(records.data(), mapping + payload + sizeof(IndexData),
+			index.count * sizeof(uint64_t));
+		for (uint64_t record : records) {
+			BlockHeader record_block;
+			if (!readBlock(mapping, end, record, &record_block) ||
+				record_block.tag != BLOCK_RECORD) {
+				return false;
+			}
+		}
+		index_blocks.push_back(std::move(records));
+		index_offset = index.prev_index_offset;
+	}
+	std::for_each(index_blocks.rbegin(), index_blocks.rend(), [offsets](const auto &records) {
+		offsets->insert(offsets->end(), records.begin(), records.end());
+	});
+	return true;
+}
+
+FrameResult makeFrameResult(const TargetExtractorData &data,
+	uint64_t frame_index, int64_t capture_timestamp_us,
+	const std::vector<double> &pose) {
+	FrameResult result;
+	result.frame_index = frame_index;
+	result.capture_timestamp_us = capture_timestamp_us;
+	if (data.poly.size() == 4) {
+		for (const auto &point : data.poly) {
+			result.quad.emplace_back(point);
+		}
+	}
+	result.homography = data.homography;
+	result.pose = pose;
+	result.segments = data.lines;
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+
+ResultLogWriter::ResultLogWriter(const std::string &filename, uint32_t index_interval)
+	: fd(-1), mapping(nullptr), capacity(0), index_interval(index_interval) {
+	fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		std::cerr << "Could not open result log " << filename << std::endl;
+		abort();
+	}
+	struct stat file_stat;
+	fstat(fd, &file_stat);
+	const bool existing = static_cast<size_t>(file_stat.st_size) >= sizeof(LogFileHeader);
+	reserve(std::max<size_t>(file_stat.st_size, sizeof(LogFileHeader)));
+
+	auto *header = reinterpret_cast<LogFileHeader*>(mapping);
+	if (existing) {
+		if (std::memcmp(header->magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 ||
+			header->version != LOG_VERSION) {
+			std::cerr << "Not a result log " << filename << std::endl;
+			abort();
+		}
+		const uint64_t start = unindexedStart(mapping, *header, header->data_end);
+		if (!start) {
+			std::cerr << "Damaged result log " << filename << std::endl;
+			abort();
+		}
+		collectRecords(mapping, start, header->data_end, &pending_offsets);
+	} else {
+		std::memset(header, 0, sizeof(LogFileHeader));
+		std::memcpy(header->magic, LOG_MAGIC, sizeof(LOG_MAGIC));
+		header->version = LOG_VERSION;
+		header->index_interval = index_interval;
+		header->data_end = sizeof(LogFileHeader);
+	}
+}
+
+ResultLogWriter::~ResultLogWriter() {
+	appendIndexBlock();
+	const uint64_t data_end = reinterpret_cast<LogFileHeader*>(mapping)->data_end;
+	msync(mapping, capacity, MS_SYNC);
+	munmap(mapping, capacity);
+	if (ftruncate(fd, data_end) != 0) {
+		std::cerr << "Could not truncate result log" << std::endl;
+	}
+	close(fd);
+}
+
+void ResultLogWriter::reserve(size_t bytes) {
+	if (bytes <= capacity) {
+		return;
+	}
+	size_t new_capacity = std::max(bytes, capacity * 2);
+	new_capacity = (new_capacity + GROWTH_CHUNK - 1) / GROWTH_CHUNK * GROWTH_CHUNK;
+	if (mapping) {
+		munmap(mapping, capacity);
+	}
+	if (ftruncate(fd, new_capacity) != 0) {
+		std::cerr << "Could not grow result log" << std::endl;
+		abort();
+	}
+	void *new_mapping = mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (new_mapping == MAP_FAILED) {
+		std::cerr << "Could not map result log" << std::endl;
+		abort();
+	}
+	mapping = static_cast<uint8_t*>(new_mapping);
+	capacity = new_capacity;
+}
+
+uint64_t ResultLogWriter::appendBlock(uint32_t tag, const std::vector<uint8_t> &payload) {
+	const size_t size = alignBlock(payload.size());
+	const uint64_t offset = reinterpret_cast<LogFileHeader*>(mapping)->data_end;
+	reserve(offset + sizeof(BlockHeader) + size);
+
+	const BlockHeader block{tag, static_cast<uint32_t>(size)};
+	std::memcpy(mapping + offset, &block, sizeof(block));
+	std::memcpy(mapping + offset + sizeof(block), payload.data(), payload.size());
+	std::memset(mapping + offset + sizeof(block) + payload.size(), 0, size - payload.size());
+
+	// Publish the block only after it is completely written.
+	std::atomic_thread_fence(std::memory_order_release);
+	reinterpret_cast<LogFileHeader*>(mapping)->data_end = offset + sizeof(block) + size;
+	return offset;
+}
+
+void ResultLogWriter::appendIndexBlock() {
+	if (pending_offsets.empty()) {
+		return;
+	}
+	auto *header = reinterpret_cast<LogFileHeader*>(mapping);
+	const IndexData index{header->last_index_offset,
+		header->record_count - pending_offsets.size(),
+		static_cast<uint32_t>(pending_offsets.size()), 0};
+
+	std::vector<uint8_t> payload(sizeof(IndexData) + pending_offsets.size() * sizeof(uint64_t));
+	std::memcpy(payload.data(), &index, sizeof(index));
+	std::memcpy(payload.data() + sizeof(index), pending_offsets.data(),
+		pending_offsets.size() * sizeof(uint64_t));
+
+	const uint64_t offset = appendBlock(BLOCK_INDEX, payload);
+	reinterpret_cast<LogFileHeader*>(mapping)->last_index_offset = offset;
+	pending_offsets.clear();
+}
+
+void ResultLogWriter::append(const FrameResult &result) {
+	const uint64_t offset = appendBlock(BLOCK_RECORD, encodeFrameResult(result));
+	reinterpret_cast<LogFileHeader*>(mapping)->record_count++;
+	pending_offsets.push_back(offset);
+	if (pending_offsets.size() >= index_interval) {
+		appendIndexBlock();
+	}
+}
+
+void ResultLogWriter::flush() {
+	msync(mapping, reinterpret_cast<LogFileHeader*>(mapping)->data_end, MS_ASYNC);
+}
+
+//-----------------------------------------------------------------------------
+
+ResultLogReader::ResultLogReader(const std::string &filename)
+	: fd(-1), mapping(nullptr), mapping_size(0) {
+	fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		std::cerr << "Could not open result log " << filename << std::endl;
+		abort();
+	}
+	struct stat file_stat;
+	fstat(fd, &file_stat);
+	mapping_size = file_stat.st_size;
+	if (mapping_size < sizeof(LogFileHeader)) {
+		std::cerr << "Not a result log " << filename << std::endl;
+		abort();
+	}
+	void *file_mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (file_mapping == MAP_FAILED) {
+		std::cerr << "Could not map result log " << filename << std::endl;
+		abort();
+	}
+	mapping = static_cast<const uint8_t*>(file_mapping);
+
+	const auto header = readAt<LogFileHeader>(mapping, 0);
+	if (std::memcmp(header.magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 ||
+		header.version != LOG_VERSION) {
+		std::cerr << "Not a result log " << filename << std::endl;
+		abort();
+	}
+
+	// Walk the index chain backwards, then pick up records appended after
+	// the last index block. A damaged chain falls back to scanning every
+	// block from the start.
+	const uint64_t end = std::min<uint64_t>(header.data_end, mapping_size);
+	const uint64_t start = unindexedStart(mapping, header, end);
+	if (start && readIndexChain(mapping, end, header.last_index_offset, &offsets)) {
+		collectRecords(mapping, start, end, &offsets);
+	} else {
+		offsets.clear();
+		collectRecords(mapping, sizeof(LogFileHeader), end, &offsets);
+	}
+}
+
+ResultLogReader::~ResultLogReader() {
+	munmap(const_cast<uint8_t*>(mapping), mapping_size);
+	close(fd);
+}
+
+FrameResult ResultLogReader::read(size_t index) const {
+	return decodeRecord(mapping, offsets.at(index));
+}
+
+void ResultLogReader::replay(const std::function<void(const FrameResult&)> &fnc) const {
+	madvise(const_cast<uint8_t*>(mapping), mapping_size, MADV_SEQUENTIAL);
+	for (uint64_t offset : offsets) {
+		fnc(decodeRecord(mapping, offset));
+	}
+}
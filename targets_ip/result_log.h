@@ -0,0 +1,93 @@
+#ifndef _RESULT_LOG_H
+#define _RESULT_LOG_H
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "target.h"
+
+enum Stage {
+	STAGE_PREPROCESS,
+	STAGE_EXTRACT,
+	STAGE_DETECT,
+	STAGE_FIT,
+	STAGE_COUNT
+};
+
+const char *stageName(Stage stage);
+
+struct FrameResult {
+	uint64_t frame_index = 0;
+	int64_t capture_timestamp_us = 0;
+	std::vector<cv::Point2f> quad;
+	cv::Mat homography;
+	std::vector<double> pose;
+	std::vector<cv::Vec4i> segments;
+	float stage_ms[STAGE_COUNT] = {};
+};
+
+// Result of the face in data, with pose if one was fitted to it.
+FrameResult makeFrameResult(const TargetExtractorData &data,
+	uint64_t frame_index, int64_t capture_timestamp_us,
+	const std::vector<double> &pose = {});
+
+// Compact record encoding shared by the log and the daemon replies.
+std::vector<uint8_t> encodeFrameResult(const FrameResult &result);
+FrameResult decodeFrameResult(const uint8_t *payload, size_t size);
+
+// Append-only binary log of per-frame results. The file starts with a fixed
+// header followed by tagged blocks. Every index_interval records an index
+// block with the offsets of the preceding records is appended; index blocks
+// are chained backwards from the header, so a reader finds all records
+// without touching their payload. The file is grown in large chunks and
+// written through a shared memory mapping. Numbers are stored in host
+// (little-endian) byte order.
+class ResultLogWriter {
+ private:
+	int fd;
+	uint8_t *mapping;
+	size_t capacity;
+	uint32_t index_interval;
+	std::vector<uint64_t> pending_offsets;
+
+	void reserve(size_t bytes);
+	uint64_t appendBlock(uint32_t tag, const std::vector<uint8_t> &payload);
+	void appendIndexBlock();
+
+ public:
+	explicit ResultLogWriter(const std::string &filename, uint32_t index_interval = 256);
+	ResultLogWriter(const ResultLogWriter&) = delete;
+	ResultLogWriter &operator=(const ResultLogWriter&) = delete;
+	~ResultLogWriter();
+
+	void append(const FrameResult &result);
+	void flush();
+};
+
+// Reads a log while or after it is written. Blocks are checked against the
+// file size, the index chain must lead backwards; a log cut short, e.g. by a
+// crash during an append, yields the records before the first damaged block.
+class ResultLogReader {
+ private:
+	int fd;
+	const uint8_t *mapping;
+	size_t mapping_size;
+	std::vector<uint64_t> offsets;
+
+ public:
+	explicit ResultLogReader(const std::string &filename);
+	ResultLogReader(const ResultLogReader&) = delete;
+	ResultLogReader &operator=(const ResultLogReader&) = delete;
+	~ResultLogReader();
+
+	size_t size() const { return offsets.size(); }
+	FrameResult read(size_t index) const;
+	void replay(const std::function<void(const FrameResult&)> &fnc) const;
+};
+
+#endif  // _RESULT_LOG_H
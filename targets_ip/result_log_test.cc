@@ -0,0 +1,152 @@
+#include <unistd.h>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE ResultLogTest
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "result_log.h"
+
+namespace fs = boost::filesystem;
+
+struct TemporaryLog {
+	std::string path;
+	TemporaryLog()
+		: path((fs::temp_directory_path() / fs::unique_path("targets_%%%%%%%%.log")).string()) {
+	}
+	~TemporaryLog() { fs::remove(path); }
+};
+
+FrameResult makeResult(uint64_t frame_index) {
+	FrameResult result;
+	result.frame_index = frame_index;
+	result.capture_timestamp_us = 1000 * frame_index;
+	if (frame_index % 2) {
+		result.quad = {{1, 2}, {3, 4}, {5, 6}, {7, static_cast<float>(frame_index)}};
+		result.homography = cv::Mat::eye(3, 3, CV_64F) * static_cast<double>(frame_index);
+	}
+	if (frame_index % 3 == 0) {
+		result.pose = {1, 2, 300, 0.1, 0.2, static_cast<double>(frame_index)};
+	}
+	for (uint64_t i = 0; i < frame_index % 5; i++) {
+		result.segments.emplace_back(i, i + 1, i + 2, frame_index);
+	}
+	result.stage_ms[STAGE_EXTRACT] = 0.5f * frame_index;
+	return result;
+}
+
+void checkResult(const FrameResult &result, uint64_t frame_index) {
+	const FrameResult expected = makeResult(frame_index);
+	BOOST_CHECK_EQUAL(result.frame_index, expected.frame_index);
+	BOOST_CHECK_EQUAL(result.capture_timestamp_us, expected.capture_timestamp_us);
+	BOOST_CHECK(result.quad == expected.quad);
+	BOOST_CHECK_EQUAL(result.homography.empty(), expected.homography.empty());
+	if (!expected.homography.empty()) {
+		BOOST_CHECK_EQUAL(cv::norm(result.homography, expected.homography), 0.0);
+	}
+	BOOST_CHECK(result.pose == expected.pose);
+	BOOST_CHECK(result.segments == expected.segments);
+	BOOST_CHECK_EQUAL(result.stage_ms[STAGE_EXTRACT], expected.stage_ms[STAGE_EXTRACT]);
+}
+
+BOOST_AUTO_TEST_CASE(test_random_access_and_replay) {
+	TemporaryLog log;
+	{
+		ResultLogWriter writer(log.path, 4);
+		for (uint64_t i = 0; i < 11; i++) {
+			writer.append(makeResult(i));
+		}
+	}
+
+	ResultLogReader reader(log.path);
+	BOOST_REQUIRE_EQUAL(reader.size(), 11);
+	checkResult(reader.read(7), 7);
+	checkResult(reader.read(0), 0);
+
+	uint64_t replayed = 0;
+	reader.replay([&replayed](const FrameResult &result) {
+		checkResult(result, replayed++);
+	});
+	BOOST_CHECK_EQUAL(replayed, 11);
+}
+
+BOOST_AUTO_TEST_CASE(test_reopen_appends) {
+	TemporaryLog log;
+	{
+		ResultLogWriter writer(log.path, 4);
+		for (uint64_t i = 0; i < 6; i++) {
+			writer.append(makeResult(i));
+		}
+	}
+	{
+		ResultLogWriter writer(log.path, 4);
+		for (uint64_t i = 6; i < 9; i++) {
+			writer.append(makeResult(i));
+		}
+	}
+
+	ResultLogReader reader(log.path);
+	BOOST_REQUIRE_EQUAL(reader.size(), 9);
+	for (size_t i = 0; i < reader.size(); i++) {
+		checkResult(reader.read(i), i);
+	}
+}
+
+void writeLog(const std::string &path, uint64_t records) {
+	ResultLogWriter writer(path, 4);
+	for (uint64_t i = 0; i < records; i++) {
+		writer.append(makeResult(i));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_truncated_log_yields_complete_records) {
+	for (uint64_t cut : {40, 100, 300, 1000}) {
+		TemporaryLog log;
+		writeLog(log.path, 11);
+		BOOST_REQUIRE_EQUAL(truncate(log.path.c_str(), fs::file_size(log.path) - cut), 0);
+
+		ResultLogReader reader(log.path);
+		BOOST_CHECK_LE(reader.size(), 11);
+		BOOST_CHECK_GT(reader.size(), 0);
+		for (size_t i = 0; i < reader.size(); i++) {
+			checkResult(reader.read(i), i);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_cyclic_index_chain_is_not_followed) {
+	TemporaryLog log;
+	writeLog(log.path, 11);
+	{
+		// Point the last index block back at itself.
+		std::fstream file(log.path, std::ios::in | std::ios::out | std::ios::binary);
+		uint64_t last_index_offset;
+		file.seekg(24);
+		file.read(reinterpret_cast<char*>(&last_index_offset), sizeof(last_index_offset));
+		BOOST_REQUIRE_GT(last_index_offset, 0);
+		file.seekp(last_index_offset + 8);
+		file.write(reinterpret_cast<const char*>(&last_index_offset), sizeof(last_index_offset));
+	}
+
+	ResultLogReader reader(log.path);
+	BOOST_REQUIRE_EQUAL(reader.size(), 11);
+	for (size_t i = 0; i < reader.size(); i++) {
+		checkResult(reader.read(i), i);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_frame_result_carries_pose) {
+	TargetExtractorData data(cv::Size(256, 256), 256);
+	BOOST_CHECK(makeFrameResult(data, 1, 2).pose.empty());
+	const std::vector<double> pose{1, 2, 300, 0.1, 0.2, 0.3};
+	BOOST_CHECK(makeFrameResult(data, 1, 2, pose).pose == pose);
+}
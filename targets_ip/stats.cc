@@ -0,0 +1,93 @@
+#include "stats.h"
+
+#include <cmath>
+#include <cstdint>
+
+#include <opencv2/core/core.hpp>
+
+void computePlaneStatistics(const cv::Mat &plane, PlaneStatistics *statistics) {
+	CV_Assert(plane.type() == CV_8UC1);
+	uint32_t partial[4][256] = {};
+	for (int y = 0; y < plane.rows; y++) {
+		const uchar *row = plane.ptr<uchar>(y);
+		int x = 0;
+		for (; x + 4 <= plane.cols; x += 4) {
+			partial[0][row[x]]++;
+			partial[1][row[x + 1]]++;
+			partial[2][row[x + 2]]++;
+			partial[3][row[x + 3]]++;
+		}
+		for (; x < plane.cols; x++) {
+			partial[0][row[x]]++;
+		}
+	}
+
+	uint64_t sum = 0, square_sum = 0;
+	statistics->min = 255;
+	statistics->max = 0;
+	for (int value = 0; value < 256; value++) {
+		const uint32_t count = partial[0][value] + partial[1][value] +
+			partial[2][value] + partial[3][value];
+		statistics->histogram[value] = count;
+		sum += static_cast<uint64_t>(value) * count;
+		square_sum += static_cast<uint64_t>(value * value) * count;
+		if (count) {
+			statistics->min = std::min(statistics->min, value);
+			statistics->max = value;
+		}
+	}
+	statistics->count = plane.total();
+	if (!statistics->count) {
+		statistics->min = 0;
+		statistics->mean = 0;
+		statistics->variance = 0;
+		return;
+	}
+	statistics->mean = static_cast<double>(sum) / statistics->count;
+	statistics->variance = static_cast<double>(square_sum) / statistics->count -
+		statistics->mean * statistics->mean;
+}
+
+double PlaneStatistics::stdDev() const {
+	return std::sqrt(std::max(variance, 0.0));
+}
+
+int PlaneStatistics::percentile(double fraction) const {
+	const double target = fraction * count;
+	uint64_t cumulative = 0;
+	for (int value = 0; value < 256; value++) {
+		cumulative += histogram[value];
+		if (cumulative && cumulative >= target) {
+			return value;
+		}
+	}
+	return max;
+}
+
+int PlaneStatistics::otsuThreshold() const {
+	if (!count) {
+		return 0;
+	}
+	const double total_mean = mean;
+	double best_variance = -1;
+	int best_threshold = min;
+	uint64_t below = 0;
+	double below_sum = 0;
+	for (int threshold = 0; threshold < 255; threshold++) {
+		below += histogram[threshold];
+		below_sum += static_cast<double>(threshold) * histogram[threshold];
+		if (!below || below == count) {
+			continue;
+		}
+		const double below_weight = static_cast<double>(below) / count;
+		const double below_mean = below_sum / below;
+		const double above_mean = (total_mean * count - below_sum) / (count - below);
+		const double difference = below_mean - above_mean;
+		const double between = below_weight * (1 - below_weight) * difference * difference;
+		if (between > best_variance) {
+			best_variance = between;
+			best_threshold = threshold;
+		}
+	}
+	return best_threshold;
+}
@@ -0,0 +1,31 @@
+#ifndef _STATS_H
+#define _STATS_H
+#pragma once
+
+#include <cstdint>
+
+#include <opencv2/core/core.hpp>
+
+// Distribution of an 8-bit plane. Moments are exact, they are computed from
+// the histogram rather than accumulated per pixel.
+struct PlaneStatistics {
+	uint32_t histogram[256] = {};
+	uint64_t count = 0;
+	double mean = 0;
+	double variance = 0;
+	int min = 0;
+	int max = 0;
+
+	double stdDev() const;
+	// Smallest value v with at least fraction of the pixels <= v.
+	int percentile(double fraction) const;
+	// Threshold maximizing the between-class variance of pixels <= t and
+	// pixels > t, as cv::THRESH_OTSU.
+	int otsuThreshold() const;
+};
+
+// One pass over the plane, four interleaved partial histograms hide the
+// store to load dependency of repeated values.
+void computePlaneStatistics(const cv::Mat &plane, PlaneStatistics *statistics);
+
+#endif  // _STATS_H
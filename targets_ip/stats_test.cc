@@ -0,0 +1,50 @@
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE StatsTest
+
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "stats.h"
+
+BOOST_AUTO_TEST_CASE(test_moments_match_opencv) {
+	cv::Mat plane(37, 53, CV_8UC1);
+	cv::RNG rng(7);
+	rng.fill(plane, cv::RNG::UNIFORM, 0, 256);
+
+	PlaneStatistics statistics;
+	computePlaneStatistics(plane, &statistics);
+
+	cv::Scalar mean, std_dev;
+	cv::meanStdDev(plane, mean, std_dev);
+	double min, max;
+	cv::minMaxLoc(plane, &min, &max);
+	BOOST_CHECK_EQUAL(statistics.count, plane.total());
+	BOOST_CHECK_CLOSE(statistics.mean, mean[0], 0.0001);
+	BOOST_CHECK_CLOSE(statistics.stdDev(), std_dev[0], 0.0001);
+	BOOST_CHECK_EQUAL(statistics.min, min);
+	BOOST_CHECK_EQUAL(statistics.max, max);
+}
+
+BOOST_AUTO_TEST_CASE(test_percentile) {
+	cv::Mat plane(10, 10, CV_8UC1, cv::Scalar(10));
+	plane.rowRange(0, 9) = cv::Scalar(20);
+
+	PlaneStatistics statistics;
+	computePlaneStatistics(plane, &statistics);
+	BOOST_CHECK_EQUAL(statistics.percentile(0.05), 10);
+	BOOST_CHECK_EQUAL(statistics.percentile(0.5), 20);
+	BOOST_CHECK_EQUAL(statistics.percentile(1.0), 20);
+}
+
+BOOST_AUTO_TEST_CASE(test_otsu_separates_modes) {
+	cv::Mat plane(64, 64, CV_8UC1, cv::Scalar(60));
+	plane(cv::Rect(16, 16, 32, 32)) = cv::Scalar(220);
+
+	PlaneStatistics statistics;
+	computePlaneStatistics(plane, &statistics);
+	const int threshold = statistics.otsuThreshold();
+	BOOST_CHECK_GE(threshold, 60);
+	BOOST_CHECK_LT(threshold, 220);
+}
@@ -0,0 +1,188 @@
+#include "stream_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "trace.h"
+
+const size_t LATENCY_WINDOW = 1024;
+
+StreamScheduler::StreamScheduler(const std::vector<std::string> &source_names,
+	const TargetExtractorData &prototype,
+	WorkStealingPool *pool,
+	size_t queue_capacity,
+	FrameProcessor processor)
+	: pool(pool),
+		queue_capacity(std::max<size_t>(queue_capacity, 1)),
+		processor(processor),
+		running(false) {
+	for (size_t i = 0; i < source_names.size(); i++) {
+		sources.push_back(std::make_unique<Source>(i, source_names[i], prototype));
+		sources.back()->stats.source = source_names[i];
+	}
+}
+
+StreamScheduler::~StreamScheduler() {
+	stop();
+}
+
+bool StreamScheduler::isLiveSource(const std::string &name) {
+	return name.rfind("/dev/", 0) == 0 || name.find("://") != std::string::npos;
+}
+
+void StreamScheduler::start() {
+	running = true;
+	for (auto &source : sources) {
+		source->capture_thread = std::thread(&StreamScheduler::capture, this, source.get());
+	}
+}
+
+void StreamScheduler::stop() {
+	running = false;
+	for (auto &source : sources) {
+		source->space_available.notify_all();
+	}
+	for (auto &source : sources) {
+		if (source->capture_thread.joinable()) {
+			source->capture_thread.join();
+		}
+	}
+	pool->wait();
+}
+
+bool StreamScheduler::finished() {
+	for (auto &source : sources) {
+		std::lock_guard<std::mutex> lock(source->mutex);
+		if (!source->capture_finished || !source->queue.empty() || source->scheduled) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void StreamScheduler::capture(Source *source) {
+	TRACE_THREAD_NAME("capture " + source->name);
+	cv::VideoCapture capture(source->name);
+	cv::Mat frame;
+	while (running) {
+		{
+			TRACE_SPAN("capture");
+			if (!capture.read(frame)) {
+				break;
+			}
+		}
+		const auto captured = std::chrono::steady_clock::now();
+		bool submit = false;
+		{
+			TRACE_SPAN("queue_push");
+			std::unique_lock<std::mutex> lock(source->mutex);
+			source->stats.captured++;
+			if (source->live) {
+				while (source->queue.size() >= queue_capacity) {
+					source->queue.pop_front();
+					source->stats.dropped++;
+				}
+			} else {
+				source->space_available.wait(lock, [this, source]() {
+					return source->queue.size() < queue_capacity || !running;
+				});
+			}
+			// The queued Mat keeps the buffer, the next read allocates a new one.
+			source->queue.push_back({std::move(frame), captured});
+			frame = cv::Mat();
+			if (!source->scheduled) {
+				source->scheduled = true;
+				submit = true;
+			}
+		}
+		if (submit) {
+			pool->submit([this, source]() { process(source); });
+		}
+	}
+	std::lock_guard<std::mutex> lock(source->mutex);
+	source->capture_finished = true;
+}
+
+void StreamScheduler::process(Source *source) {
+	QueuedFrame frame;
+	{
+		TRACE_SPAN("queue_pop");
+		std::lock_guard<std::mutex> lock(source->mutex);
+		if (source->queue.empty()) {
+			source->scheduled = false;
+			return;
+		}
+		frame = std::move(source->queue.front());
+		source->queue.pop_front();
+	}
+	source->space_available.notify_one();
+
+	source->data.img = frame.image;
+	{
+		TRACE_SPAN("process_frame");
+		processor(source->index, &source->data);
+	}
+
+	const std::chrono::duration<float, std::milli> latency =
+		std::chrono::steady_clock::now() - frame.captured;
+	recordLatency(source, latency.count());
+
+	{
+		std::lock_guard<std::mutex> lock(source->mutex);
+		if (source->queue.empty()) {
+			source->scheduled = false;
+			return;
+		}
+	}
+	pool->submit([this, source]() { process(source); }, true);
+}
+
+void StreamScheduler::recordLatency(Source *source, float latency_ms) {
+	std::lock_guard<std::mutex> lock(source->mutex);
+	SourceStats &stats = source->stats;
+	stats.processed++;
+	source->total_latency_ms += latency_ms;
+	stats.mean_latency_ms = source->total_latency_ms / stats.processed;
+	stats.max_latency_ms = std::max<double>(stats.max_latency_ms, latency_ms);
+	if (source->recent_latencies_ms.size() < LATENCY_WINDOW) {
+		source->recent_latencies_ms.push_back(latency_ms);
+	} else {
+		source->recent_latencies_ms[source->next_latency++ % LATENCY_WINDOW] = latency_ms;
+	}
+}
+
+std::vector<SourceStats> StreamScheduler::stats() {
+	std::vector<SourceStats> result;
+	for (auto &source : sources) {
+		std::lock_guard<std::mutex> lock(source->mutex);
+		SourceStats stats = source->stats;
+		std::vector<float> latencies = source->recent_latencies_ms;
+		if (!latencies.empty()) {
+			auto p95 = latencies.begin() + latencies.size() * 95 / 100;
+			std::nth_element(latencies.begin(), p95, latencies.end());
+			stats.p95_latency_ms = *p95;
+		}
+		result.push_back(stats);
+	}
+	return result;
+}
+
+void printSourceStats(std::ostream &out, const std::vector<SourceStats> &stats) {
+	out << std::fixed << std::setprecision(1);
+	for (const auto &source : stats) {
+		out << source.source
+			<< " captured " << source.captured
+			<< " processed " << source.processed
+			<< " dropped " << source.dropped
+			<< " latency mean " << source.mean_latency_ms
+			<< " p95 " << source.p95_latency_ms
+			<< " max " << source.max_latency_ms << " ms\n";
+	}
+}
@@ -0,0 +1,107 @@
+#ifndef _STREAM_SCHEDULER_H
+#define _STREAM_SCHEDULER_H
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "target.h"
+#include "thread_pool.h"
+
+struct SourceStats {
+	std::string source;
+	uint64_t captured = 0;
+	uint64_t processed = 0;
+	uint64_t dropped = 0;
+	double mean_latency_ms = 0;
+	double p95_latency_ms = 0;
+	double max_latency_ms = 0;
+};
+
+// Runs one pipeline per camera or video file on a shared pool. Every source
+// has a capture thread feeding a bounded queue; live sources drop their
+// oldest frame when the queue is full, files wait for space. At most one
+// task per source is queued or running at a time and it processes a single
+// frame before yielding, so sources share the workers fairly and each
+// source's TargetExtractorData is used by one task at a time. Latency is
+// measured from capture to the end of processing.
+class StreamScheduler {
+ public:
+	using FrameProcessor = std::function<void(int source, TargetExtractorData *data)>;
+
+ private:
+	struct QueuedFrame {
+		cv::Mat image;
+		std::chrono::steady_clock::time_point captured;
+	};
+
+	struct Source {
+		int index;
+		std::string name;
+		bool live;
+		TargetExtractorData data;
+		std::mutex mutex;
+		std::condition_variable space_available;
+		std::deque<QueuedFrame> queue;
+		bool scheduled = false;
+		bool capture_finished = false;
+		SourceStats stats;
+		double total_latency_ms = 0;
+		std::vector<float> recent_latencies_ms;
+		size_t next_latency = 0;
+		std::thread capture_thread;
+
+		Source(int index, const std::string &name, const TargetExtractorData &prototype)
+			: index(index),
+				name(name),
+				live(isLiveSource(name)),
+				data(prototype) {
+		}
+	};
+
+	std::vector<std::unique_ptr<Source>> sources;
+	WorkStealingPool *pool;
+	size_t queue_capacity;
+	FrameProcessor processor;
+	std::atomic<bool> running;
+
+	void capture(Source *source);
+	void process(Source *source);
+	void recordLatency(Source *source, float latency_ms);
+
+ public:
+	StreamScheduler(const std::vector<std::string> &source_names,
+		const TargetExtractorData &prototype,
+		WorkStealingPool *pool,
+		size_t queue_capacity,
+		FrameProcessor processor);
+	StreamScheduler(const StreamScheduler&) = delete;
+	StreamScheduler &operator=(const StreamScheduler&) = delete;
+	~StreamScheduler();
+
+	// Cameras and network streams, as opposed to video files.
+	static bool isLiveSource(const std::string &name);
+
+	void start();
+	// Stops capturing and waits for queued work to finish.
+	void stop();
+	// True once all sources ended and their queues are drained.
+	bool finished();
+	std::vector<SourceStats> stats();
+};
+
+void printSourceStats(std::ostream &out, const std::vector<SourceStats> &stats);
+
+#endif  // _STREAM_SCHEDULER_H
@@ -0,0 +1,143 @@
+#include "synthetic.h"
+
+#include <cmath>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "target_model.h"
+
+using cv::Point2f;
+using cv::Vec2f;
+using cv::Vec3f;
+
+const cv::Scalar SHAFT_COLOR(30, 30, 30);
+
+Camera syntheticCamera(cv::Size image_size) {
+	return model_camera(image_size, LensCalibration());
+}
+
+LensCalibration syntheticLens(cv::Size image_size) {
+	LensCalibration lens;
+	lens.camera_matrix = cv::Matx33d(syntheticCamera(image_size).projection_matrix);
+	lens.distortion = (cv::Mat_<double>(1, 5) << -0.25, 0.05, 0, 0, 0);
+	lens.image_size = image_size;
+	return lens;
+}
+
+SyntheticFrame distortSyntheticFrame(const SyntheticFrame &frame, const LensCalibration &lens) {
+	std::vector<cv::Point2f> pixels;
+	for (int y = 0; y < frame.image.rows; y++) {
+		for (int x = 0; x < frame.image.cols; x++) {
+			pixels.emplace_back(x, y);
+		}
+	}
+	const std::vector<cv::Point2f> sources = undistortImagePoints(lens, pixels);
+	const cv::Mat map(frame.image.size(), CV_32FC2, const_cast<cv::Point2f *>(sources.data()));
+
+	SyntheticFrame distorted = frame;
+	cv::remap(frame.image, distorted.image, map, cv::noArray(), cv::INTER_LINEAR,
+		cv::BORDER_CONSTANT, cv::Scalar(60, 70, 60));
+	distorted.quad = distortImagePoints(lens, frame.quad);
+	return distorted;
+}
+
+SyntheticTargetRenderer::SyntheticTargetRenderer(int texture_size, uint64 seed)
+	: face_texture(texture_size, texture_size, CV_8UC3), rng(seed) {
+	const Target target{Vec3f{0, 0, 0}, Vec3f{0, 0, 0}, 1.0f};
+	for (int row = 0; row < texture_size; row++) {
+		auto *texel = face_texture.ptr<cv::Vec3b>(row);
+		const float y = (row + 0.5f) / texture_size * 2 - 1;
+		for (int col = 0; col < texture_size; col++) {
+			const float x = (col + 0.5f) / texture_size * 2 - 1;
+			const Vec3f color = target.target_color({x, y}).value_or(Vec3f{1, 1, 1});
+			texel[col] = cv::Vec3b(color * 255.0f);
+		}
+	}
+}
+
+SyntheticFrame SyntheticTargetRenderer::render(const SyntheticScene &scene) {
+	const ModelProjection projection{syntheticCamera(scene.image_size),
+		target_from_pose(scene.pose)};
+
+	SyntheticFrame frame;
+	frame.pose = scene.pose;
+	for (const Vec2f &corner : {Vec2f{-1, -1}, Vec2f{1, -1}, Vec2f{1, 1}, Vec2f{-1, 1}}) {
+		frame.quad.push_back(Point2f(projection.project(corner)));
+	}
+
+	const float size = face_texture.cols;
+	frame.homography = cv::getPerspectiveTransform(
+		std::vector<Point2f>{{0, 0}, {size, 0}, {size, size}, {0, size}}, frame.quad);
+
+	frame.image.create(scene.image_size, CV_8UC3);
+	frame.image.setTo(scene.background);
+	cv::warpPerspective(face_texture, frame.image, frame.homography, scene.image_size,
+		cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+
+	for (const auto &arrow : scene.arrows) {
+		const Vec2f tail = arrow.hit +
+			Vec2f{std::cos(arrow.angle), std::sin(arrow.angle)} * arrow.length;
+		const Point2f hit_point(projection.project(arrow.hit));
+		const Point2f tail_point(projection.project(tail));
+		frame.hits.push_back(hit_point);
+		frame.shafts.emplace_back(hit_point.x, hit_point.y, tail_point.x, tail_point.y);
+		cv::line(frame.image, hit_point, tail_point, SHAFT_COLOR, 2, cv::LINE_AA);
+	}
+
+	if (scene.horizontal_gradient != 0.0f) {
+		const int cols = frame.image.cols;
+		for (int row = 0; row < frame.image.rows; row++) {
+			auto *pixel = frame.image.ptr<cv::Vec3b>(row);
+			for (int col = 0; col < cols; col++) {
+				const float gain = scene.gain *
+					(1.0f + scene.horizontal_gradient * (col / static_cast<float>(cols) - 0.5f));
+				for (int channel = 0; channel < 3; channel++) {
+					pixel[col][channel] = cv::saturate_cast<uchar>(
+						pixel[col][channel] * gain + scene.offset);
+				}
+			}
+		}
+	} else if (scene.gain != 1.0f || scene.offset != 0.0f) {
+		frame.image.convertTo(frame.image, -1, scene.gain, scene.offset);
+	}
+
+	if (scene.blur) {
+		cv::GaussianBlur(frame.image, frame.image, cv::Size(scene.blur | 1, scene.blur | 1), 0);
+	}
+
+	if (scene.noise_sigma > 0.0f) {
+		noise.create(scene.image_size, CV_16SC3);
+		rng.fill(noise, cv::RNG::NORMAL, 0, scene.noise_sigma);
+		cv::add(frame.image, noise, frame.image, cv::noArray(), CV_8U);
+	}
+
+	return frame;
+}
+
+SyntheticScene randomSyntheticScene(cv::RNG *rng, cv::Size image_size, int max_arrows) {
+	SyntheticScene scene;
+	scene.image_size = image_size;
+	scene.pose = {
+		rng->uniform(-20.0, 20.0),
+		rng->uniform(-20.0, 20.0),
+		rng->uniform(280.0, 360.0),
+		rng->uniform(-0.3, 0.3),
+		rng->uniform(-0.3, 0.3),
+		rng->uniform(-0.5, 0.5)};
+	scene.gain = rng->uniform(0.95f, 1.05f);
+	scene.horizontal_gradient = rng->uniform(-0.05f, 0.05f);
+	scene.noise_sigma = rng->uniform(0.0f, 4.0f);
+
+	const int arrows = rng->uniform(0, max_arrows + 1);
+	for (int i = 0; i < arrows; i++) {
+		const float radius = std::sqrt(rng->uniform(0.0f, 1.0f)) * 0.9f;
+		const float direction = rng->uniform(0.0f, static_cast<float>(2 * CV_PI));
+		scene.arrows.push_back({
+			Vec2f{radius * std::cos(direction), radius * std::sin(direction)},
+			rng->uniform(0.0f, static_cast<float>(2 * CV_PI)),
+			rng->uniform(0.3f, 0.6f)});
+	}
+	return scene;
+}
@@ -0,0 +1,70 @@
+#ifndef _SYNTHETIC_H
+#define _SYNTHETIC_H
+#pragma once
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "lens.h"
+#include "target_model.h"
+
+struct SyntheticArrow {
+	cv::Vec2f hit;  // model coordinates
+	float angle;  // shaft direction in the target plane
+	float length;  // shaft length in model units
+};
+
+struct SyntheticScene {
+	std::vector<double> pose{0, 0, 300, 0, 0, 0};
+	cv::Size image_size{256, 256};
+	cv::Scalar background{60, 70, 60};
+	float gain = 1.0f;
+	float offset = 0.0f;
+	float horizontal_gradient = 0.0f;  // relative gain change across the image
+	int blur = 0;  // gaussian kernel size, 0 disables blur
+	float noise_sigma = 0.0f;
+	std::vector<SyntheticArrow> arrows;
+};
+
+struct SyntheticFrame {
+	cv::Mat image;
+	std::vector<double> pose;
+	std::vector<cv::Point2f> quad;  // projected face corners
+	cv::Mat homography;  // face texture to image
+	std::vector<cv::Point2f> hits;  // projected arrow hits
+	std::vector<cv::Vec4f> shafts;  // projected arrow shafts, hit first
+};
+
+// Camera SystemModel::value fits with for an image of given size without
+// lens calibration.
+Camera syntheticCamera(cv::Size image_size);
+// Barrel distorted lens with the intrinsics of the synthetic camera.
+LensCalibration syntheticLens(cv::Size image_size);
+
+// Renders target images with exact ground truth. The target face texture is
+// built once from Target::target_color and every frame is a single
+// homography warp of it, followed by cheap in-place arrow, lighting, blur
+// and noise passes. Noise is drawn from the renderer's own seeded
+// generator, so a sequence of frames is reproducible.
+class SyntheticTargetRenderer {
+ private:
+	cv::Mat face_texture;
+	cv::Mat noise;
+	cv::RNG rng;
+
+ public:
+	explicit SyntheticTargetRenderer(int texture_size = 512, uint64 seed = 0);
+
+	const cv::Mat &faceTexture() const { return face_texture; }
+	SyntheticFrame render(const SyntheticScene &scene);
+};
+
+// The frame as seen through lens, image and quad distorted.
+SyntheticFrame distortSyntheticFrame(const SyntheticFrame &frame, const LensCalibration &lens);
+
+// Random but plausible scene: target facing the camera within a few tens of
+// degrees, somewhat off center, with up to max_arrows arrows.
+SyntheticScene randomSyntheticScene(cv::RNG *rng, cv::Size image_size, int max_arrows);
+
+#endif  // _SYNTHETIC_H
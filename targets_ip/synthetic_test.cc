@@ -0,0 +1,50 @@
+#include <vector>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE SyntheticTest
+
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include "synthetic.h"
+#include "utils.h"
+
+BOOST_AUTO_TEST_CASE(test_render_is_reproducible) {
+	cv::RNG scene_rng(7);
+	const SyntheticScene scene = randomSyntheticScene(&scene_rng, cv::Size(320, 240), 3);
+
+	SyntheticTargetRenderer first(256, 42);
+	SyntheticTargetRenderer second(256, 42);
+	const SyntheticFrame a = first.render(scene);
+	const SyntheticFrame b = second.render(scene);
+
+	BOOST_CHECK_EQUAL(a.image.size(), cv::Size(320, 240));
+	BOOST_CHECK_EQUAL(cv::norm(a.image, b.image, cv::NORM_INF), 0.0);
+	BOOST_CHECK_EQUAL(a.hits.size(), scene.arrows.size());
+}
+
+BOOST_AUTO_TEST_CASE(test_homography_maps_texture_corners_to_quad) {
+	SyntheticScene scene;
+	scene.pose = {10, 5, 320, 0.2, -0.1, 0.3};
+	SyntheticTargetRenderer renderer(256);
+	const SyntheticFrame frame = renderer.render(scene);
+
+	std::vector<cv::Point2f> corners{{0, 0}, {256, 0}, {256, 256}, {0, 256}};
+	std::vector<cv::Point2f> projected;
+	cv::perspectiveTransform(corners, projected, frame.homography);
+	for (int i = 0; i < 4; i++) {
+		BOOST_CHECK_SMALL(dist(cv::Vec2f(projected[i]), cv::Vec2f(frame.quad[i])), 0.01f);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_target_center_is_rendered_yellow) {
+	SyntheticScene scene;
+	SyntheticTargetRenderer renderer;
+	const SyntheticFrame frame = renderer.render(scene);
+
+	const cv::Vec3b center = frame.image.at<cv::Vec3b>(
+		scene.image_size.height / 2, scene.image_size.width / 2);
+	BOOST_CHECK_EQUAL(center, cv::Vec3b(0, 207, 255));
+}
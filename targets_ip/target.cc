@@ -9,6 +9,7 @@
 #include <opencv2/imgproc.hpp>
 
 #include "io.h"
+#include "trace.h"
 #include "utils.h"
 
 void loadAndPreprocessInput(TargetExtractorData *data,
@@ -18,6 +19,7 @@ void loadAndPreprocessInput(TargetExtractorData *data,
 }
 
 void preprocessInput(TargetExtractorData *data) {
+	TRACE_SPAN("preprocess");
 	cv::resize(data->img, data->img_resized,
 		getSizeKeepRatio(data->img, 0, data->scaled_input_size));
 
@@ -25,6 +27,21 @@ void preprocessInput(TargetExtractorData *data) {
 	cv::cvtColor(data->img_resized, imgHSV, cv::COLOR_BGR2HSV);
 
 	cv::split(imgHSV, data->hsv);
+	computePlaneStatistics(data->hsv[2], &data->value_statistics);
+	data->quality = assessFrameQuality(data->hsv[2], data->value_statistics,
+		data->quality_thresholds);
+}
+
+int resolveThreshold(const TargetExtractorData &data, int threshold) {
+	if (threshold != AUTO_THRESHOLD) {
+		return threshold;
+	}
+	// The face is the bright class of the V plane. The clamp keeps a frame
+	// without a clear bimodal distribution from binarizing its noise.
+	const int min_threshold = 128;
+	const int max_threshold = 250;
+	return std::min(max_threshold,
+		std::max(min_threshold, data.value_statistics.otsuThreshold()));
 }
 
 double vector2Angle(cv::Point2f a) { return atan2(a.x, a.y); }
@@ -35,74 +52,331 @@ double pointCenter2Angle(cv::Point2f a, cv::Point2f center) {
 
 void warpPolygonToSquare(TargetExtractorData *data) {
 	if (data->poly.size() != 4) {
+		data->homography.release();
+		data->warped.release();
 		return;
 	}
 	std::vector<cv::Point2f> source{
 		cv::Point2f{data->poly[0]}, cv::Point2f{data->poly[1]},
 		cv::Point2f{data->poly[2]}, cv::Point2f{data->poly[3]}};
 
+	if (!data->lens.empty()) {
+		source = undistortImagePoints(data->lens.scaled(data->img_resized.size()), source);
+	}
+
 	cv::Point2f center = (source[0] + source[1] + source[2] + source[3]) / 4;
 
 	std::sort(std::begin(source), std::end(source), [center](auto a, auto b) {
 		return pointCenter2Angle(a, center) > pointCenter2Angle(b, center);
 	});
 
-	cv::Mat warp_mat = cv::getPerspectiveTransform(source,
+	data->homography = cv::getPerspectiveTransform(source,
 		std::vector<cv::Point2f>{
 			cv::Point2i{data->target_size.width, 0},
 			cv::Point2i{data->target_size.width, data->target_size.height},
 			cv::Point2i{0, data->target_size.height},
 			cv::Point2i{0, 0}});
-	cv::warpPerspective(data->hsv[2], data->warped, warp_mat, data->target_size,
-		cv::INTER_CUBIC, cv::BORDER_CONSTANT, cv::Scalar());
+	warpTargetFace(data);
 }
 
-void extractTargetFace(TargetExtractorData *data,
-	int smoothing, int dilate, int threshold) {
-	const cv::Mat *preprocessed = &data->hsv[2];
+std::vector<cv::Point2f> faceCorners(const TargetExtractorData &data) {
+	if (data.homography.empty()) {
+		return {};
+	}
+	const float width = data.target_size.width;
+	const float height = data.target_size.height;
+	std::vector<cv::Point2f> corners;
+	cv::perspectiveTransform(
+		std::vector<cv::Point2f>{{0, 0}, {width, 0}, {width, height}, {0, height}},
+		corners, data.homography.inv());
+	// The homography is taken on the undistorted quad.
+	if (!data.lens.empty() && !data.img_resized.empty()) {
+		corners = distortImagePoints(data.lens.scaled(data.img_resized.size()), corners);
+	}
+
+	if (!data.img.empty() && !data.img_resized.empty()) {
+		const cv::Point2f scale(data.img.cols / static_cast<float>(data.img_resized.cols),
+			data.img.rows / static_cast<float>(data.img_resized.rows));
+		for (auto &corner : corners) {
+			corner = cv::Point2f(corner.x * scale.x, corner.y * scale.y);
+		}
+	}
+	return corners;
+}
+
+bool warpsFromOriginal(const TargetExtractorData &data) {
+	return data.warp_from_original && !data.img.empty() && !data.img_resized.empty();
+}
+
+const DistortionMap &distortionMap(TargetExtractorData *data, cv::Size source_size) {
+	if (data->distortion_map.empty() || data->distortion_map.image_size != source_size) {
+		data->distortion_map = buildDistortionMap(data->lens, source_size);
+	}
+	return data->distortion_map;
+}
+
+void prepareFaceWarp(TargetExtractorData *data) {
+	if (data->lens.empty()) {
+		return;
+	}
+	distortionMap(data, warpsFromOriginal(*data) ? data->img.size() : data->hsv[2].size());
+}
+
+// Face of source, which is the resized image, one of its planes or the
+// original image.
+void warpFace(TargetExtractorData *data, const cv::Mat &source, cv::Mat *face) {
+	cv::Mat homography;
+	data->homography.convertTo(homography, CV_64F);
+	if (!data->img_resized.empty() && source.size() != data->img_resized.size()) {
+		// Original to resized image scaling composed with the face homography.
+		const cv::Matx33d scale(
+			data->img_resized.cols / static_cast<double>(source.cols), 0, 0,
+			0, data->img_resized.rows / static_cast<double>(source.rows), 0,
+			0, 0, 1);
+		homography = homography * cv::Mat(scale);
+	}
+
+	if (data->lens.empty()) {
+		cv::warpPerspective(source, *face, homography, data->target_size,
+			cv::INTER_CUBIC, cv::BORDER_CONSTANT, cv::Scalar());
+		return;
+	}
+	composeFaceRemap(distortionMap(data, source.size()), homography, data->target_size,
+		&data->face_map[0], &data->face_map[1]);
+	cv::remap(source, *face, data->face_map[0], data->face_map[1],
+		cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar());
+}
+
+void warpTargetFace(TargetExtractorData *data) {
+	TRACE_SPAN("warp_face");
+	if (data->homography.empty()) {
+		return;
+	}
+	if (!warpsFromOriginal(*data)) {
+		warpFace(data, data->hsv[2], &data->warped);
+		return;
+	}
+
+	// Only face pixels of the original are sampled, the V plane of the face
+	// is the channel maximum as in cv::COLOR_BGR2HSV.
+	cv::Mat warped_bgr;
+	warpFace(data, data->img, &warped_bgr);
+	if (warped_bgr.channels() == 1) {
+		data->warped = warped_bgr;
+		return;
+	}
+	cv::Mat channels[3];
+	cv::split(warped_bgr, channels);
+	cv::max(channels[0], channels[1], data->warped);
+	cv::max(data->warped, channels[2], data->warped);
+}
+
+void warpColorTargetFace(TargetExtractorData *data, cv::Mat *face) {
+	TRACE_SPAN("warp_color_face");
+	face->release();
+	if (data->homography.empty()) {
+		return;
+	}
+	warpFace(data, warpsFromOriginal(*data) ? data->img : data->img_resized, face);
+}
+
+// Streams the V plane row by row through box blur, threshold and
+// rectangular dilation and writes only the final mask. The working set is
+// one row of vertical blur sums and a ring of dilate thresholded rows.
+// Results equal cv::blur (BORDER_REFLECT_101), cv::threshold
+// (THRESH_BINARY) and cv::dilate for odd smoothing; for even smoothing
+// blurred values landing exactly on .5 may round differently. The inner
+// loops are plain loops over contiguous rows which the compiler vectorizes.
+void blurThresholdDilate(const cv::Mat &value, int smoothing, int threshold, int dilate,
+	cv::Mat *mask, cv::Mat *smoothed, cv::Mat *thresholded) {
+	TRACE_SPAN("blur_threshold_dilate");
+	CV_Assert(value.type() == CV_8UC1);
+	const int rows = value.rows;
+	const int cols = value.cols;
+	const int blur_size = std::max(smoothing, 1);
+	const int blur_anchor = blur_size / 2;
+	const int dilate_size = std::max(dilate, 1);
+	const int dilate_anchor = dilate_size / 2;
+	const int area = blur_size * blur_size;
+	// round(sum / area) > threshold  <=>  2 * sum >= (2 * threshold + 1) * area
+	const int limit = (2 * threshold + 1) * area;
+
+	mask->create(value.size(), CV_8UC1);
+	if (smoothed) {
+		smoothed->create(value.size(), CV_8UC1);
+	}
+	if (thresholded) {
+		thresholded->create(value.size(), CV_8UC1);
+	}
+	if (rows == 0 || cols == 0) {
+		return;
+	}
+
+	auto reflect = [](int index, int size) {
+		return cv::borderInterpolate(index, size, cv::BORDER_REFLECT_101);
+	};
+
+	std::vector<int> column_sums(cols, 0);
+	std::vector<int> padded_sums(cols + blur_size - 1);
+	std::vector<int> row_sums(cols);
+	std::vector<uchar> ring(dilate_size * cols);
+	std::vector<uchar> padded_max(cols + dilate_size - 1, 0);
+
+	for (int i = 0; i < blur_size; i++) {
+		const uchar *src = value.ptr<uchar>(reflect(i - blur_anchor, rows));
+		for (int x = 0; x < cols; x++) {
+			column_sums[x] += src[x];
+		}
+	}
 
+	auto dilateRow = [&](int y) {
+		const int first = std::max(y - dilate_anchor, 0);
+		const int last = std::min(y - dilate_anchor + dilate_size - 1, rows - 1);
+		uchar *vertical = padded_max.data() + dilate_anchor;
+		std::fill(vertical, vertical + cols, 0);
+		for (int row = first; row <= last; row++) {
+			const uchar *src = ring.data() + (row % dilate_size) * cols;
+			for (int x = 0; x < cols; x++) {
+				vertical[x] = std::max(vertical[x], src[x]);
+			}
+		}
+		uchar *dst = mask->ptr<uchar>(y);
+		std::copy(padded_max.begin(), padded_max.begin() + cols, dst);
+		for (int i = 1; i < dilate_size; i++) {
+			const uchar *src = padded_max.data() + i;
+			for (int x = 0; x < cols; x++) {
+				dst[x] = std::max(dst[x], src[x]);
+			}
+		}
+	};
+
+	for (int y = 0; y < rows; y++) {
+		if (y > 0) {
+			const uchar *added = value.ptr<uchar>(reflect(y - blur_anchor + blur_size - 1, rows));
+			const uchar *removed = value.ptr<uchar>(reflect(y - 1 - blur_anchor, rows));
+			for (int x = 0; x < cols; x++) {
+				column_sums[x] += added[x] - removed[x];
+			}
+		}
+
+		std::copy(column_sums.begin(), column_sums.end(), padded_sums.begin() + blur_anchor);
+		for (int p = 0; p < blur_anchor; p++) {
+			padded_sums[p] = column_sums[reflect(p - blur_anchor, cols)];
+		}
+		for (int p = blur_anchor + cols; p < cols + blur_size - 1; p++) {
+			padded_sums[p] = column_sums[reflect(p - blur_anchor, cols)];
+		}
+
+		std::copy(padded_sums.begin(), padded_sums.begin() + cols, row_sums.begin());
+		for (int i = 1; i < blur_size; i++) {
+			const int *src = padded_sums.data() + i;
+			for (int x = 0; x < cols; x++) {
+				row_sums[x] += src[x];
+			}
+		}
+
+		uchar *binary = ring.data() + (y % dilate_size) * cols;
+		for (int x = 0; x < cols; x++) {
+			binary[x] = 2 * row_sums[x] >= limit ? 255 : 0;
+		}
+		if (smoothed) {
+			uchar *dst = smoothed->ptr<uchar>(y);
+			for (int x = 0; x < cols; x++) {
+				dst[x] = (row_sums[x] + area / 2) / area;
+			}
+		}
+		if (thresholded) {
+			std::copy(binary, binary + cols, thresholded->ptr<uchar>(y));
+		}
+
+		// The last thresholded row a mask row depends on is y.
+		const int mask_row = y - (dilate_size - 1 - dilate_anchor);
+		if (mask_row >= 0) {
+			dilateRow(mask_row);
+		}
+	}
+	for (int y = std::max(rows - (dilate_size - 1 - dilate_anchor), 0); y < rows; y++) {
+		dilateRow(y);
+	}
+}
+
+void smoothTargetInput(TargetExtractorData *data, int smoothing) {
+	TRACE_SPAN("smooth");
 	if (smoothing) {
 		cv::blur(data->hsv[2], data->smoothed, cv::Size(smoothing, smoothing));
-		preprocessed = &data->smoothed;
+	} else {
+		data->smoothed = data->hsv[2];
 	}
+}
 
-	cv::threshold(*preprocessed, data->thresholded, threshold, 255, cv::THRESH_BINARY);
-	preprocessed = &data->thresholded;
+void extractTargetFace(TargetExtractorData *data,
+	int smoothing, int dilate, int threshold) {
+	TRACE_SPAN("extract_face");
+	threshold = resolveThreshold(*data, threshold);
+	if (data->keep_intermediates) {
+		blurThresholdDilate(data->hsv[2], smoothing, threshold, dilate,
+			&data->mask, &data->smoothed, &data->thresholded);
+		data->dilated = data->mask;
+	} else {
+		blurThresholdDilate(data->hsv[2], smoothing, threshold, dilate,
+			&data->mask, nullptr, nullptr);
+	}
+	extractFaceFromMask(data);
+}
 
-	if (dilate) {
-		cv::dilate(*preprocessed, data->dilated,
-			cv::getStructuringElement(cv::MORPH_RECT, cv::Size(dilate, dilate)));
-		preprocessed = &data->dilated;
+void extractSmoothedTargetFace(TargetExtractorData *data,
+	int dilate, int threshold) {
+	TRACE_SPAN("extract_smoothed_face");
+	threshold = resolveThreshold(*data, threshold);
+	// smoothed is blurred already, smoothing 1 leaves it as is.
+	if (data->keep_intermediates) {
+		blurThresholdDilate(data->smoothed, 1, threshold, dilate,
+			&data->mask, nullptr, &data->thresholded);
+		data->dilated = data->mask;
+	} else {
+		blurThresholdDilate(data->smoothed, 1, threshold, dilate, &data->mask);
 	}
+	extractFaceFromMask(data);
+}
 
+void extractFaceFromMask(TargetExtractorData *data) {
+	TRACE_SPAN("find_face");
 	std::vector<std::vector<cv::Point>> contours;
-	cv::findContours(*preprocessed, contours, cv::RETR_LIST, cv::CHAIN_APPROX_NONE);
+	cv::findContours(data->mask, contours, cv::RETR_LIST, cv::CHAIN_APPROX_NONE);
 
 	std::sort(std::begin(contours), std::end(contours),
 		[](auto a, auto b) { return cv::contourArea(a) > cv::contourArea(b); });
 
 	if (contours.size() == 0) {
+		// No face of an earlier frame survives a frame without one.
+		data->poly.clear();
+		data->homography.release();
+		data->warped.release();
 		return;
 	}
 
-	zeroSameAs(&data->curve_drawing, data->thresholded);
+	zeroSameAs(&data->curve_drawing, data->mask);
 	cv::drawContours(data->curve_drawing, contours, 0, cv::Scalar(255, 255, 255));
 
 	cv::approxPolyDP(contours[0], data->poly, 30.0, true);
 
-	zeroSameAs(&data->poly_drawing, data->thresholded);
+	zeroSameAs(&data->poly_drawing, data->mask);
 	cv::polylines(data->poly_drawing, {data->poly}, true, cv::Scalar(255, 255, 255));
 
 	warpPolygonToSquare(data);
 }
 
-void detectArrows(TargetExtractorData *data,
-	int canny1, int canny2, int hough) {
-	cv::Canny(data->warped, data->warped_edges, canny1, canny2, 3);
+// Changed face fraction above which the face is assumed to have moved.
+const double MAX_CHANGED_FRACTION = 0.25;
+// Margin around changed regions, so that edges of a new arrow are complete.
+const int CHANGED_REGION_MARGIN = 8;
 
-	std::vector<cv::Vec4i> lines;
-	cv::HoughLinesP(data->warped_edges, lines, 1, 0.01, hough, 30, 10);
+void houghSegments(const cv::Mat &edges, int hough, std::vector<cv::Vec4i> *lines) {
+	cv::HoughLinesP(edges, *lines, 1, 0.01, hough, 30, 10);
+}
 
+void drawSegments(TargetExtractorData *data) {
+	const std::vector<cv::Vec4i> &lines = data->lines;
 	zeroSameAs(&data->lines_drawing, data->warped);
 	for (size_t i = 0; i < lines.size(); i++) {
 		cv::line(data->lines_drawing,
@@ -111,3 +385,113 @@ void detectArrows(TargetExtractorData *data,
 			cv::Scalar(255, 255, 255), 1, 8);
 	}
 }
+
+void detectEdges(TargetExtractorData *data, int canny1, int canny2) {
+	TRACE_SPAN("detect_edges");
+	cv::Canny(data->warped, data->warped_edges, canny1, canny2, 3);
+}
+void detectLines(TargetExtractorData *data, int hough) {
+	TRACE_SPAN("detect_lines");
+	houghSegments(data->warped_edges, hough, &data->lines);
+	drawSegments(data);
+}
+void detectArrows(TargetExtractorData *data,
+	int canny1, int canny2, int hough) {
+	TRACE_SPAN("detect_arrows");
+	detectEdges(data, canny1, canny2);
+	detectLines(data, hough);
+}
+
+// Bounding boxes of changed regions grown by margin, overlapping boxes merged.
+std::vector<cv::Rect> changedRegions(const cv::Mat &changed, int margin) {
+	std::vector<std::vector<cv::Point>> contours;
+	cv::findContours(changed, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+	const cv::Rect face(0, 0, changed.cols, changed.rows);
+	std::vector<cv::Rect> regions;
+	for (const auto &contour : contours) {
+		cv::Rect region = cv::boundingRect(contour);
+		region -= cv::Point(margin, margin);
+		region += cv::Size(2 * margin, 2 * margin);
+		regions.push_back(region & face);
+	}
+
+	for (bool merged = true; merged;) {
+		merged = false;
+		for (size_t i = 0; i < regions.size() && !merged; i++) {
+			for (size_t j = i + 1; j < regions.size() && !merged; j++) {
+				if ((regions[i] & regions[j]).area() > 0) {
+					regions[i] |= regions[j];
+					regions.erase(regions.begin() + j);
+					merged = true;
+				}
+			}
+		}
+	}
+	return regions;
+}
+
+void resetArrowTracking(ArrowTrackingState *state) {
+	state->reference.release();
+	state->reference_lines.clear();
+	state->lines.clear();
+	state->regions.clear();
+}
+
+bool segmentInRegions(const cv::Vec4i &line, const std::vector<cv::Rect> &regions) {
+	const cv::Point middle((line[0] + line[2]) / 2, (line[1] + line[3]) / 2);
+	return std::any_of(regions.begin(), regions.end(),
+		[middle](const cv::Rect &region) { return region.contains(middle); });
+}
+
+void detectNewArrows(TargetExtractorData *data, ArrowTrackingState *state,
+	int canny1, int canny2, int hough, int difference_threshold) {
+	TRACE_SPAN("detect_new_arrows");
+	if (data->warped.empty()) {
+		return;
+	}
+
+	bool full_detection = state->reference.empty() ||
+		state->reference.size() != data->warped.size();
+	if (!full_detection) {
+		cv::absdiff(data->warped, state->reference, state->difference);
+		cv::threshold(state->difference, state->changed, difference_threshold, 255,
+			cv::THRESH_BINARY);
+		cv::dilate(state->changed, state->changed,
+			cv::getStructuringElement(cv::MORPH_RECT, cv::Size(5, 5)));
+		full_detection = cv::countNonZero(state->changed) >
+			MAX_CHANGED_FRACTION * state->changed.total();
+	}
+
+	if (full_detection) {
+		detectArrows(data, canny1, canny2, hough);
+		data->warped.copyTo(state->reference);
+		state->reference_lines = data->lines;
+		state->lines = data->lines;
+		state->regions.clear();
+		return;
+	}
+
+	// Every changed region is detected anew and replaces the reference lines
+	// within it, so arrows of the whole end are found while noise or jitter
+	// never accumulates lines.
+	state->regions = changedRegions(state->changed, CHANGED_REGION_MARGIN);
+	state->lines.clear();
+	for (const auto &line : state->reference_lines) {
+		if (!segmentInRegions(line, state->regions)) {
+			state->lines.push_back(line);
+		}
+	}
+	zeroSameAs(&data->warped_edges, data->warped);
+	std::vector<cv::Vec4i> region_lines;
+	for (const auto &region : state->regions) {
+		cv::Mat region_edges = data->warped_edges(region);
+		cv::Canny(data->warped(region), region_edges, canny1, canny2, 3);
+		houghSegments(region_edges, hough, &region_lines);
+		for (const auto &line : region_lines) {
+			state->lines.push_back(line + cv::Vec4i(region.x, region.y, region.x, region.y));
+		}
+	}
+	data->lines = state->lines;
+	drawSegments(data);
+}
@@ -7,36 +7,118 @@
 
 #include <opencv2/core/core.hpp>
 
+#include "lens.h"
+#include "quality.h"
+#include "stats.h"
+
 struct TargetExtractorData {
 	cv::Mat img;
 	cv::Mat img_resized;
 	cv::Mat hsv[3];
+	PlaneStatistics value_statistics;  // of hsv[2], set in preprocessInput
+	QualityThresholds quality_thresholds;
+	FrameQuality quality;  // of hsv[2], set in preprocessInput
 
 	cv::Mat smoothed;
 	cv::Mat thresholded;
 	cv::Mat dilated;
+	cv::Mat mask;  // binary image the face contour is taken from
 	cv::Mat curve_drawing;
 	cv::Mat poly_drawing;
 	std::vector<cv::Point> poly;
+	cv::Mat homography;
 
 	cv::Mat warped;
 	cv::Mat warped_edges;
+	cv::Mat face_mask;  // area of the warped face searched for lines
+	std::vector<cv::Vec4i> lines;
 	cv::Mat lines_drawing;
 
 	cv::Size target_size;
 	int scaled_input_size;
+	// Fill smoothed, thresholded and dilated in extractTargetFace and
+	// thresholded and dilated in extractSmoothedTargetFace, which otherwise
+	// produce only the mask.
+	bool keep_intermediates = false;
+	// Warp the face from the full resolution img instead of the resized
+	// V plane. The quad and homography stay in resized image coordinates.
+	bool warp_from_original = false;
+	// Lens of img. When set, the quad corners are undistorted before the
+	// homography is taken and the face is rectified by a single remap of the
+	// distorted image. The distortion map of the warp source is built once,
+	// every frame only composes it with its homography into face_map.
+	LensCalibration lens;
+	DistortionMap distortion_map;
+	cv::Mat face_map[2];
 	explicit TargetExtractorData(cv::Size target_size, int scaled_input_size)
 		: target_size(target_size), scaled_input_size(scaled_input_size) {
 	}
 };
 
+// Incremental arrow detection within one end. The reference is the warped
+// face at the start of the end with its reference_lines, lines holds the
+// lines of the last update and regions the face regions re-examined in it.
+struct ArrowTrackingState {
+	cv::Mat reference;
+	std::vector<cv::Vec4i> reference_lines;
+	std::vector<cv::Vec4i> lines;
+	std::vector<cv::Rect> regions;
+	cv::Mat difference;
+	cv::Mat changed;
+};
+
+// Threshold argument selecting a per-frame threshold from the V plane
+// distribution.
+const int AUTO_THRESHOLD = -1;
+
 void loadAndPreprocessInput(TargetExtractorData *data,
 	const std::string &filename);
 void preprocessInput(TargetExtractorData *data);
+// Returns threshold, or the automatic threshold if it is AUTO_THRESHOLD.
+int resolveThreshold(const TargetExtractorData &data, int threshold);
 void extractTargetFace(TargetExtractorData *data,
 	int smoothing, int dilate, int threshold);
+// The two halves of extractTargetFace, so that a blurred plane can be shared
+// by several threshold and dilate settings.
+void smoothTargetInput(TargetExtractorData *data, int smoothing);
+void extractSmoothedTargetFace(TargetExtractorData *data,
+	int dilate, int threshold);
+// Contour, polygon and warp stage on data->mask.
+void extractFaceFromMask(TargetExtractorData *data);
+// Fused blur, threshold and dilate of an 8-bit plane into a binary mask,
+// equivalent to cv::blur, cv::threshold and cv::dilate with a rectangle.
+// Intermediates are written only when requested.
+void blurThresholdDilate(const cv::Mat &value, int smoothing, int threshold, int dilate,
+	cv::Mat *mask, cv::Mat *smoothed = nullptr, cv::Mat *thresholded = nullptr);
+// Homography of the quad in data->poly and warpTargetFace.
+void warpPolygonToSquare(TargetExtractorData *data);
+void warpTargetFace(TargetExtractorData *data);
+// Color face of the homography, from img with warp_from_original and from
+// img_resized otherwise, for consumers trained on color photos.
+void warpColorTargetFace(TargetExtractorData *data, cv::Mat *face);
+// Builds the distortion map of the warpTargetFace source unless it is built
+// already, so that faces warped from copies of data share it.
+void prepareFaceWarp(TargetExtractorData *data);
+// Corners of the found face in (distorted) img coordinates, in the order of
+// the warped face corners (0, 0), (w, 0), (w, h), (0, h). Empty without a
+// face.
+std::vector<cv::Point2f> faceCorners(const TargetExtractorData &data);
 void detectArrows(TargetExtractorData *data,
 	int canny1, int canny2, int hough);
+// The two halves of detectArrows, edges of the warped face and line
+// segments found in them.
+void detectEdges(TargetExtractorData *data, int canny1, int canny2);
+void detectLines(TargetExtractorData *data, int hough);
+// Renders data->lines into lines_drawing.
+void drawSegments(TargetExtractorData *data);
+// Runs edge and line detection only in regions of the face which changed
+// since the reference and carries the reference lines of the other regions
+// forward. Falls back to full detection, which takes a new reference, when
+// there is no reference or most of the face changed.
+void detectNewArrows(TargetExtractorData *data, ArrowTrackingState *state,
+	int canny1, int canny2, int hough, int difference_threshold = 40);
+// Starts a new end, the next frame becomes the reference.
+void resetArrowTracking(ArrowTrackingState *state);
 
 // Direction to angle in 2D. Clockwise decreasing from
 // maximum at 00:00 to minimum at 11:59.
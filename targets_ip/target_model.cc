@@ -2,12 +2,15 @@
 
 #include <algorithm>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <optional>
 #include <vector>
 
 #include <opencv2/core.hpp>
 #include <opencv2/core/core.hpp>
 #include <opencv2/core/mat.hpp>
+#include <opencv2/calib3d.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 
@@ -106,23 +109,55 @@ std::optional<cv::Vec3f> Target::get_target_point(
 //-----------------------------------------------------------------------------
 
 Vec2f ModelProjection::project(Vec2f model_coord) const {
-	Vec3f model_3d_coord = model.get_target_point(model_coord).value();
-	auto projected_coord = camera.projection_matrix * model_3d_coord;
-	return {projected_coord[0] / projected_coord[2],
-		projected_coord[1] / projected_coord[2]};
+	return camera.project(model.get_target_point(model_coord).value());
 }
 
 //-----------------------------------------------------------------------------
 
 // clang-format off
-Camera::Camera(float object_distance, float scale, Vec2f shift)
+Camera::Camera(float object_distance, float scale, Vec2f shift,
+	const cv::Vec<float, 5> &distortion)
 	: projection_matrix{
 		object_distance * scale, 0, shift[0],
 		0, object_distance * scale, shift[1],
-		0, 0, 1} {
+		0, 0, 1},
+		distortion(distortion) {
+}
+
+Camera::Camera(const cv::Matx33f &projection_matrix, const cv::Vec<float, 5> &distortion)
+	: projection_matrix(projection_matrix), distortion(distortion) {
 }
 // clang-format on
 
+Camera model_camera(cv::Size image_size, const LensCalibration &lens) {
+	if (lens.image_size.area() == 0 && lens.empty()) {
+		return Camera{26, 10, {image_size.width / 2.0f, image_size.height / 2.0f}};
+	}
+	const LensCalibration scaled = lens.scaled(image_size);
+	cv::Vec<float, 5> distortion;
+	for (int i = 0; i < std::min<int>(5, scaled.distortion.total()); i++) {
+		distortion[i] = scaled.distortion.at<double>(i);
+	}
+	return Camera(cv::Matx33f(scaled.camera_matrix), distortion);
+}
+
+Vec2f Camera::project(const Vec3f &point) const {
+	if (distortion == cv::Vec<float, 5>()) {
+		auto projected_coord = projection_matrix * point;
+		return {projected_coord[0] / projected_coord[2],
+			projected_coord[1] / projected_coord[2]};
+	}
+	const float x = point[0] / point[2];
+	const float y = point[1] / point[2];
+	const float r2 = x * x + y * y;
+	const float radial = 1 + r2 * (distortion[0] + r2 * (distortion[1] + r2 * distortion[4]));
+	const float distorted_x = x * radial + 2 * distortion[2] * x * y +
+		distortion[3] * (r2 + 2 * x * x);
+	const float distorted_y = y * radial + distortion[2] * (r2 + 2 * y * y) +
+		2 * distortion[3] * x * y;
+	auto projected_coord = projection_matrix * Vec3f{distorted_x, distorted_y, 1};
+	return {projected_coord[0], projected_coord[1]};
+}
 //-----------------------------------------------------------------------------
 
 std::optional<Vec3f> img_color(const Mat &camera_image,
@@ -145,65 +180,173 @@ float dota(const std::optional<Vec3f> &v) {
 	return 0;
 }
 
-float sample_model_edges(const Mat &camera_image, const ModelProjection &model_projection) {
-	const float section_width = 1.0 / 5;
-	float total_sample_fit_cost = 0.0f;
-	int sample_count = 0;
+// Lattice coordinates of the edge samples, as the position along a square
+// side and the angle around a ring, and of the area samples along one axis.
+std::vector<float> edge_lattice() {
+	std::vector<float> lattice;
 	for (float t = 0; t < 1; t += 0.01) {
-		total_sample_fit_cost += dota(img_color(camera_image, model_projection, Vec2f{t, 0}));
-		total_sample_fit_cost += dota(img_color(camera_image, model_projection, Vec2f{t, 1}));
-		total_sample_fit_cost += dota(img_color(camera_image, model_projection, Vec2f{0, t}));
-		total_sample_fit_cost += dota(img_color(camera_image, model_projection, Vec2f{1, t}));
-		sample_count += 4;
-
-		Vec2f direction {cosf(t * 2 * M_PI), sinf(t * 2 * M_PI)};
-		for (int circle = 0; circle < 4; circle ++) {
-			const double circle_radius = (circle + 1) * section_width;
-			const Vec2f circle_point {direction * circle_radius};
-			total_sample_fit_cost += dota(img_color(camera_image, model_projection, circle_point));
+		lattice.push_back(t);
+	}
+	return lattice;
+}
+
+std::vector<float> area_lattice() {
+	std::vector<float> lattice;
+	for (float x = -1; x <= 1; x += 0.01) {
+		lattice.push_back(x);
+	}
+	return lattice;
+}
+
+void add_edge_samples(float t, std::vector<Vec2f> *samples) {
+	const float section_width = 1.0 / 5;
+	samples->push_back(Vec2f{t, 0});
+	samples->push_back(Vec2f{t, 1});
+	samples->push_back(Vec2f{0, t});
+	samples->push_back(Vec2f{1, t});
+
+	Vec2f direction {cosf(t * 2 * M_PI), sinf(t * 2 * M_PI)};
+	for (int circle = 0; circle < 4; circle ++) {
+		const double circle_radius = (circle + 1) * section_width;
+		samples->push_back(direction * circle_radius);
+	}
+}
+
+const ModelSamples &full_model_samples() {
+	static const ModelSamples samples = stratified_model_samples(1, 0);
+	return samples;
+}
+
+ModelSamples stratified_model_samples(int stride, uint64 seed) {
+	cv::RNG rng(seed);
+	auto jittered = [&rng, stride](size_t block_start, size_t size) {
+		const size_t block_end = std::min(block_start + stride, size);
+		return block_start + (stride > 1 ? rng.uniform(0, static_cast<int>(block_end - block_start)) : 0);
+	};
+
+	ModelSamples samples;
+	samples.stride = stride;
+	const std::vector<float> edges = edge_lattice();
+	for (size_t t = 0; t < edges.size(); t += stride) {
+		add_edge_samples(edges[jittered(t, edges.size())], &samples.edges);
+	}
+	const std::vector<float> area = area_lattice();
+	for (size_t y = 0; y < area.size(); y += stride) {
+		for (size_t x = 0; x < area.size(); x += stride) {
+			const size_t sample_y = jittered(y, area.size());
+			const size_t sample_x = jittered(x, area.size());
+			samples.area.push_back(Vec2f{area[sample_x], area[sample_y]});
 		}
-		sample_count += 4;
 	}
-	return total_sample_fit_cost / sample_count;
+	return samples;
 }
 
-float sample_model_area_error(const Mat &camera_image, const ModelProjection &model_projection) {
+float sample_model_edges(const Mat &camera_image, const ModelProjection &model_projection,
+	const std::vector<Vec2f> &samples) {
 	float total_sample_fit_cost = 0.0f;
-	int sample_count = 0;
-	for (float y = -1; y <= 1; y += 0.01) {
-		for (float x = -1; x <= 1; x += 0.01) {
-			const Vec2f model_coord {x, y};
-			auto target_model_color = model_projection.model.target_color(model_coord);
-			auto image_color_float = img_color(camera_image, model_projection, model_coord);
-			if (!image_color_float.has_value() || !target_model_color.has_value()) {
-				std::cout << "should not happen " << model_coord
-					<< " " << image_color_float.has_value()
-					<< " " << target_model_color.has_value() << "\n";
-				total_sample_fit_cost += 3;
-			} else {
-				auto diff = image_color_float.value() - target_model_color.value();
-				// std::cout << model_coord << " -> "
-				// 	<< image_color_float.value() << ","
-				// 	<< target_model_color.value() << "\n";
-				total_sample_fit_cost += diff.dot(diff);
+	for (const Vec2f &model_coord : samples) {
+		total_sample_fit_cost += dota(img_color(camera_image, model_projection, model_coord));
+	}
+	return total_sample_fit_cost / samples.size();
+}
+
+float sample_model_area_error(const Mat &camera_image, const ModelProjection &model_projection,
+	const std::vector<Vec2f> &samples) {
+	float total_sample_fit_cost = 0.0f;
+	for (const Vec2f &model_coord : samples) {
+		auto target_model_color = model_projection.model.target_color(model_coord);
+		auto image_color_float = img_color(camera_image, model_projection, model_coord);
+		if (!image_color_float.has_value() || !target_model_color.has_value()) {
+			// Projected outside the image, maximal color difference.
+			total_sample_fit_cost += 3;
+		} else {
+			auto diff = image_color_float.value() - target_model_color.value();
+			total_sample_fit_cost += diff.dot(diff);
+		}
+	}
+	return total_sample_fit_cost / samples.size();
+}
+
+// Dense lattice resolution of the area samples.
+const int FACE_TEMPLATE_SIZE = 200;
+
+const cv::Mat &face_template(int size) {
+	static std::mutex templates_mutex;
+	static std::map<int, Mat> templates;
+	std::lock_guard<std::mutex> lock(templates_mutex);
+	Mat &face = templates[size];
+	if (face.empty()) {
+		const Target target{Vec3f{0, 0, 0}, Vec3f{0, 0, 0}, 1.0f};
+		face.create(size, size, CV_32FC3);
+		for (int row = 0; row < size; row++) {
+			auto *texel = face.ptr<Vec3f>(row);
+			const float y = (row + 0.5f) / size * 2 - 1;
+			for (int col = 0; col < size; col++) {
+				const float x = (col + 0.5f) / size * 2 - 1;
+				texel[col] = target.target_color({x, y}).value_or(MISS);
 			}
-			sample_count++;
 		}
 	}
-	return total_sample_fit_cost / sample_count;
+	return face;
 }
 
-float SystemModel::value(const Target &target_model) const {
-	const Vec2f shift{camera_image.cols / 2.0f, camera_image.rows / 2.0f};
-	const Camera camera{26, 10, shift};
-	const ModelProjection model_projection{camera, target_model};
+// Template pixels to image coordinates: the texel center to model
+// coordinates, then the plane of the face through the camera.
+cv::Matx33d template_to_image(const ModelProjection &model_projection, int size) {
+	const Target &target = model_projection.model;
+	const Vec3f origin = target.get_target_point({0, 0}).value();
+	const Vec3f x_axis = target.get_target_point({1, 0}).value() - origin;
+	const Vec3f y_axis = target.get_target_point({0, 1}).value() - origin;
+	// clang-format off
+	const cv::Matx33d face_plane(
+		x_axis[0], y_axis[0], origin[0],
+		x_axis[1], y_axis[1], origin[1],
+		x_axis[2], y_axis[2], origin[2]);
+	const double scale = 2.0 / size;
+	const cv::Matx33d texel_to_model(
+		scale, 0, scale / 2 - 1,
+		0, scale, scale / 2 - 1,
+		0, 0, 1);
+	// clang-format on
+	return cv::Matx33d(model_projection.camera.projection_matrix) * face_plane * texel_to_model;
+}
 
-	float edge_cost = sample_model_edges(camera_image_edges, model_projection);
-	float area_error_cost = sample_model_area_error(camera_image, model_projection);
+// Same cost as sample_model_area_error: squared color difference per
+// sample, 3 for samples outside the image.
+float template_area_error(const Mat &camera_image, const ModelProjection &model_projection,
+	int size) {
+	const Mat &face = face_template(size);
+	const cv::Matx33d homography = template_to_image(model_projection, size);
+
+	Mat warped, valid;
+	cv::warpPerspective(camera_image, warped, homography, face.size(),
+		cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_CONSTANT);
+	cv::warpPerspective(Mat(camera_image.size(), CV_8UC1, cv::Scalar(255)), valid, homography,
+		face.size(), cv::INTER_NEAREST | cv::WARP_INVERSE_MAP, cv::BORDER_CONSTANT);
+	warped.convertTo(warped, CV_32FC3, 1.0 / 255);
+
+	Mat difference;
+	cv::subtract(warped, face, difference);
+	cv::multiply(difference, difference, difference);
+	const int valid_count = cv::countNonZero(valid);
+	const int total_count = face.total();
+	const cv::Scalar valid_error = valid_count ? cv::mean(difference, valid) : cv::Scalar();
+	return ((valid_error[0] + valid_error[1] + valid_error[2]) * valid_count +
+		3.0 * (total_count - valid_count)) / total_count;
+}
 
-	std::cout
-		<< "area_error_cost = " << area_error_cost
-		<< " edge_cost = " << edge_cost << "\n";
+float SystemModel::value(const Target &target_model) const {
+	const ModelProjection model_projection{model_camera(camera_image.size(), lens),
+		target_model};
+	const ModelSamples &model_samples = samples.area.empty() ? full_model_samples() : samples;
+
+	float edge_cost = sample_model_edges(camera_image_edges, model_projection,
+		model_samples.edges);
+	float area_error_cost = engine == FitCostEngine::TEMPLATE
+		? template_area_error(undistorted_image.empty() ? camera_image : undistorted_image,
+			model_projection,
+			FACE_TEMPLATE_SIZE / model_samples.stride)
+		: sample_model_area_error(camera_image, model_projection, model_samples.area);
 
 	return area_error_cost - 1.0*edge_cost;
 }
@@ -213,35 +356,117 @@ double target_model_fit_cost(const gsl_vector *v, void *params) {
 	return model.value(Target{get_vec3f(v, 0), get_vec3f(v, 3), 120.0f});
 }
 
-Target fit_target_model_to_image(const Mat &camera_image) {
+Target target_from_pose(const std::vector<double> &pose) {
+	return Target{get_vec3f(pose, 0), get_vec3f(pose, 3), 120.0f};
+}
+
+SystemModel system_model_for_image(const Mat &camera_image, const LensCalibration &lens) {
 	cv::Mat camera_image_edges;
 	cv::Mat blurred_camera_image = camera_image.clone();
 
-	imshow("opencv", camera_image);
-	cv::waitKey(0);
-
-
 	cv::blur(blurred_camera_image, blurred_camera_image, cv::Size(5, 5));
-	imshow("opencv", blurred_camera_image);
-	cv::waitKey(0);
-
 	cv::Canny(camera_image, camera_image_edges, 150, 400, 3, true);
-	imshow("opencv", camera_image_edges);
-	cv::waitKey(0);
-
 	cv::blur(camera_image_edges, camera_image_edges, cv::Size(8, 8));
-	imshow("opencv", camera_image_edges);
-	cv::waitKey(0);
 
 	SystemModel model{blurred_camera_image, camera_image_edges};
+	model.lens = lens;
+	if (!lens.empty()) {
+		const LensCalibration scaled = lens.scaled(camera_image.size());
+		cv::undistort(blurred_camera_image, model.undistorted_image,
+			cv::Mat(scaled.camera_matrix), scaled.distortion);
+	}
+	return model;
+}
+
+std::vector<double> pose_from_quad(const std::vector<cv::Point2f> &quad,
+	const Camera &camera) {
+	const float base = 120.0f;
+	const std::vector<cv::Point3f> face_corners{
+		{-base, -base, 0}, {base, -base, 0}, {base, base, 0}, {-base, base, 0}};
+	cv::Mat rotation_vector, translation;
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 1)
+	const int pnp_method = cv::SOLVEPNP_IPPE;
+#else
+	const int pnp_method = cv::SOLVEPNP_ITERATIVE;
+#endif
+	cv::solvePnP(face_corners, quad, cv::Mat(cv::Matx33d(camera.projection_matrix)),
+		cv::Mat(camera.distortion), rotation_vector, translation, false, pnp_method);
+	translation.convertTo(translation, CV_64F);
+
+	// Rotation rz * ry * rx of eulerAnglesToRotationMatrix.
+	cv::Matx33d rotation;
+	cv::Rodrigues(rotation_vector, rotation);
+	return {translation.at<double>(0), translation.at<double>(1), translation.at<double>(2),
+		std::atan2(rotation(2, 1), rotation(2, 2)),
+		std::asin(std::clamp(-rotation(2, 0), -1.0, 1.0)),
+		std::atan2(rotation(1, 0), rotation(0, 0))};
+}
+
+std::vector<double> fit_target_model_pose(const Mat &camera_image,
+	const std::vector<cv::Point2f> &quad,
+	FitCostEngine engine,
+	const LensCalibration &lens) {
+	SystemModel model = system_model_for_image(camera_image, lens);
+	model.engine = engine;
+
+	if (quad.size() == 4) {
+		// The PnP pose is within a few pixels of reprojection error, a small
+		// simplex on the dense lattice only refines it.
+		std::vector<double> result;
+		optimize(pose_from_quad(quad, model_camera(camera_image.size(), lens)),
+			{0.25, 0.25, 0.25, 0.00025, 0.0025, 0.0025},
+			&model,
+			target_model_fit_cost,
+			&result,
+			0.05);
+		return result;
+	}
+
+	return fit_progressive(&model, {0, 0, 300, 0, 0, 0});
+}
 
-	std::vector<double> result;
+const std::vector<FitStage> &progressive_fit_stages() {
+	// The simplex size of the unscaled steps is about 0.6; every stage
+	// starts above its own tolerance, so the dense stage still polishes
+	// the pose down to the single stage tolerance of 1e-1.
+	static const std::vector<FitStage> stages{
+		{8, 1.0, 0.4}, {4, 0.5, 0.2}, {2, 0.5, 0.15}, {1, 0.5, 1e-1}};
+	return stages;
+}
 
-	optimize({0, 0, 300, 0, 0, 0},
-		{1.0, 1.0, 1.0, 0.001, 0.01, 0.01},
-		&model,
-		target_model_fit_cost,
-		&result);
+std::vector<double> fit_progressive(SystemModel *model, const std::vector<double> &initial_pose,
+	std::vector<int> *stage_iterations) {
+	// Progressive fidelity: the early, coarse simplex moves are made on a
+	// stratified subset of the samples, every stage restarts the simplex
+	// at the best pose of the previous one with a denser subset and the
+	// final polish uses the dense lattice. The samples of a stage are fixed,
+	// so the simplex compares costs of the same samples.
+	const std::vector<double> step_size{1.0, 1.0, 1.0, 0.001, 0.01, 0.01};
+	const uint64 sample_seed = 1;
+
+	std::vector<double> result = initial_pose;
+	for (const FitStage &stage : progressive_fit_stages()) {
+		model->samples = stage.sample_stride > 1
+			? stratified_model_samples(stage.sample_stride, sample_seed)
+			: ModelSamples();
+		std::vector<double> stage_step_size = step_size;
+		for (double &step : stage_step_size) {
+			step *= stage.step_scale;
+		}
+		const std::vector<double> initial_solution = result;
+		const int iterations = optimize(initial_solution,
+			stage_step_size,
+			model,
+			target_model_fit_cost,
+			&result,
+			stage.size_tolerance);
+		if (stage_iterations) {
+			stage_iterations->push_back(iterations);
+		}
+	}
+	return result;
+}
 
-	return Target{get_vec3f(result, 0), get_vec3f(result, 3), 120.0f};
+Target fit_target_model_to_image(const Mat &camera_image) {
+	return target_from_pose(fit_target_model_pose(camera_image));
 }
@@ -2,10 +2,17 @@
 #define _TARGET_MODEL_H
 #pragma once
 
+#include <gsl/gsl_vector.h>
+
 #include <optional>
+#include <vector>
 
 #include <opencv2/core/core.hpp>
 
+#include "lens.h"
+
+cv::Matx33f eulerAnglesToRotationMatrix(const cv::Vec3f &theta);
+
 class Target {
  private:
 	cv::Vec3f center;
@@ -25,9 +32,21 @@ class Target {
 
 struct Camera {
 	cv::Matx33f projection_matrix;
-	Camera(float object_distance, float scale, cv::Vec2f shift);
+	// Lens distortion k1, k2, p1, p2, k3 as in cv::projectPoints, zero for
+	// an ideal pinhole.
+	cv::Vec<float, 5> distortion;
+	Camera(float object_distance, float scale, cv::Vec2f shift,
+		const cv::Vec<float, 5> &distortion = cv::Vec<float, 5>());
+	explicit Camera(const cv::Matx33f &projection_matrix,
+		const cv::Vec<float, 5> &distortion = cv::Vec<float, 5>());
+
+	cv::Vec2f project(const cv::Vec3f &point) const;
 };
 
+// Camera of the fit for images of image_size: the calibrated lens scaled to
+// the image, or the uncalibrated model camera when lens holds no calibration.
+Camera model_camera(cv::Size image_size, const LensCalibration &lens);
+
 struct ModelProjection {
 	Camera camera;
 	Target model;
@@ -35,13 +54,85 @@ struct ModelProjection {
 	cv::Vec2f project(cv::Vec2f model_coord) const;
 };
 
+// Model coordinates at which the fit cost samples the image.
+struct ModelSamples {
+	int stride = 1;
+	std::vector<cv::Vec2f> area;
+	std::vector<cv::Vec2f> edges;
+};
+
+// The dense lattice of the full fidelity cost.
+const ModelSamples &full_model_samples();
+// One sample of the dense lattice per stride x stride block of area samples
+// and per stride edge positions, jittered within the block by a generator
+// seeded with seed. Stride 1 is the dense lattice.
+ModelSamples stratified_model_samples(int stride, uint64 seed);
+
+enum class FitCostEngine {
+	// Area error of the image color at every area sample.
+	SAMPLED,
+	// Area error of the image warped into a rendered face template, with
+	// one template pixel per stride x stride block of area samples.
+	TEMPLATE
+};
+
+// Face colors of Target::target_color over model coordinates [-1, 1]^2,
+// size x size CV_32FC3 with channel values in [0, 1].
+const cv::Mat &face_template(int size);
+
 struct SystemModel {
 	cv::Mat camera_image;
 	cv::Mat camera_image_edges;
+	// Samples of a reduced fidelity cost, the dense lattice when empty.
+	ModelSamples samples;
+	FitCostEngine engine = FitCostEngine::SAMPLED;
+	// Lens of camera_image, projections go through model_camera. The
+	// template engine warps undistorted_image, which is camera_image without
+	// the lens distortion, or empty when the lens has none.
+	LensCalibration lens;
+	cv::Mat undistorted_image;
 
 	float value(const Target &target_model) const;
 };
 
+// Fit cost of the pose v for optimize, params being the SystemModel.
+double target_model_fit_cost(const gsl_vector *v, void *params);
+// Cost model of an image as fitted by fit_target_model_pose.
+SystemModel system_model_for_image(const cv::Mat &camera_image,
+	const LensCalibration &lens = LensCalibration());
+
+// Pose is {center x, y, z, euler angle x, y, z}.
+Target target_from_pose(const std::vector<double> &pose);
+// Pose of the target whose face corners (-1, -1), (1, -1), (1, 1), (-1, 1)
+// project to quad, from the planar PnP solution for the face.
+std::vector<double> pose_from_quad(const std::vector<cv::Point2f> &quad,
+	const Camera &camera);
+
+// Revision of fit_target_model_pose, part of the cached pose keys. Bump it
+// with every change which moves the fitted poses.
+const int FIT_MODEL_REVISION = 2;
+
+// Stage of the progressive fit, which restarts the simplex with the pose
+// steps scaled by step_scale and optimizes the cost of the samples of
+// sample_stride down to size_tolerance.
+struct FitStage {
+	int sample_stride;
+	double step_scale;
+	double size_tolerance;
+};
+
+const std::vector<FitStage> &progressive_fit_stages();
+// Runs the progressive fit stages from initial_pose, the optimizer
+// iterations of every stage are appended to stage_iterations if given.
+std::vector<double> fit_progressive(SystemModel *model, const std::vector<double> &initial_pose,
+	std::vector<int> *stage_iterations = nullptr);
+// Fits the pose to the image taken through lens. The optimizer starts from
+// the PnP pose of quad when it holds the four face corners in (distorted)
+// camera_image coordinates.
+std::vector<double> fit_target_model_pose(const cv::Mat &camera_image,
+	const std::vector<cv::Point2f> &quad = {},
+	FitCostEngine engine = FitCostEngine::SAMPLED,
+	const LensCalibration &lens = LensCalibration());
 Target fit_target_model_to_image(const cv::Mat &camera_image);
 
 #endif	 // _TARGET_MODEL_H
@@ -7,11 +7,14 @@
 #define BOOST_TEST_MODULE TargetTest
 
 #include <boost/test/unit_test.hpp>
+#include <opencv2/calib3d.hpp>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 
+#include "lens.h"
 #include "opt.h"
+#include "synthetic.h"
 #include "target_model.h"
 #include "utils.h"
 
@@ -23,11 +26,13 @@ using cv::Vec3b;
 using cv::Vec3f;
 using boost::unit_test::disabled;
 
+const std::vector<double> synthetic_pose{20, -20, 300, 0, 0.1, 0};
+
 Mat load_data() {
-	Mat img = imread(
-		"/home/vajicek/src/targets/targets_ip/testdata/img0001_scaled.jpg",
-		cv::IMREAD_COLOR);
-	return img;
+	SyntheticScene scene;
+	scene.pose = synthetic_pose;
+	scene.image_size = cv::Size(340, 256);
+	return SyntheticTargetRenderer().render(scene).image;
 }
 
 void show(Mat *camera_image, const ModelProjection &model_projection) {
@@ -93,6 +98,149 @@ BOOST_AUTO_TEST_CASE(test_sample_modelspace_in_imagespace, *disabled()) {
 	show(&camera_image, model_projection);
 }
 
+BOOST_AUTO_TEST_CASE(test_synthetic_pose_has_lowest_cost) {
+	SystemModel model{load_data()};
+
+	std::vector<double> shifted_pose = synthetic_pose;
+	shifted_pose[0] += 10;
+	std::vector<double> rotated_pose = synthetic_pose;
+	rotated_pose[4] += 0.2;
+
+	const float true_cost = model.value(target_from_pose(synthetic_pose));
+	BOOST_CHECK_LT(true_cost, model.value(target_from_pose(shifted_pose)));
+	BOOST_CHECK_LT(true_cost, model.value(target_from_pose(rotated_pose)));
+}
+
+BOOST_AUTO_TEST_CASE(test_stratified_samples) {
+	const ModelSamples &full = full_model_samples();
+	const ModelSamples dense = stratified_model_samples(1, 7);
+	BOOST_CHECK(dense.area == full.area);
+	BOOST_CHECK(dense.edges == full.edges);
+
+	const ModelSamples coarse = stratified_model_samples(8, 1);
+	BOOST_CHECK(coarse.area == stratified_model_samples(8, 1).area);
+	BOOST_CHECK(coarse.area != stratified_model_samples(8, 2).area);
+	BOOST_CHECK_LT(coarse.area.size() * 50, full.area.size());
+	BOOST_CHECK_LT(coarse.edges.size() * 6, full.edges.size());
+}
+
+BOOST_AUTO_TEST_CASE(test_subsampled_cost_keeps_minimum) {
+	SystemModel model{load_data()};
+	model.samples = stratified_model_samples(4, 1);
+
+	std::vector<double> shifted_pose = synthetic_pose;
+	shifted_pose[0] += 10;
+	const float true_cost = model.value(target_from_pose(synthetic_pose));
+	BOOST_CHECK_LT(true_cost, model.value(target_from_pose(shifted_pose)));
+}
+
+double translation_error(const std::vector<double> &pose) {
+	return cv::norm(cv::Vec3d(pose[0], pose[1], pose[2]) -
+		cv::Vec3d(synthetic_pose[0], synthetic_pose[1], synthetic_pose[2]));
+}
+
+BOOST_AUTO_TEST_CASE(test_progressive_fit_polishes_on_dense_samples) {
+	const std::vector<double> initial_pose{0, 0, 300, 0, 0, 0};
+	SystemModel model{load_data()};
+	std::vector<int> stage_iterations;
+	const std::vector<double> progressive = fit_progressive(&model, initial_pose,
+		&stage_iterations);
+
+	BOOST_REQUIRE_EQUAL(stage_iterations.size(), progressive_fit_stages().size());
+	BOOST_CHECK_EQUAL(progressive_fit_stages().back().sample_stride, 1);
+	for (int iterations : stage_iterations) {
+		BOOST_CHECK_GT(iterations, 1);
+	}
+
+	// No worse than a single simplex on the dense lattice.
+	SystemModel dense{load_data()};
+	std::vector<double> single;
+	optimize(initial_pose, {1.0, 1.0, 1.0, 0.001, 0.01, 0.01}, &dense,
+		target_model_fit_cost, &single, 1e-1);
+	BOOST_CHECK_LE(translation_error(progressive), translation_error(single) + 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_pose_from_quad) {
+	SyntheticScene scene;
+	scene.pose = {-15, 10, 320, 0.2, -0.15, 0.1};
+	scene.image_size = cv::Size(340, 256);
+	const SyntheticFrame frame = SyntheticTargetRenderer().render(scene);
+
+	const std::vector<double> pose = pose_from_quad(frame.quad, syntheticCamera(scene.image_size));
+	BOOST_REQUIRE_EQUAL(pose.size(), 6);
+	for (int i = 0; i < 3; i++) {
+		BOOST_CHECK_SMALL(pose[i] - scene.pose[i], 1.0);
+	}
+	for (int i = 3; i < 6; i++) {
+		BOOST_CHECK_SMALL(pose[i] - scene.pose[i], 0.01);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_template_cost_matches_sampled_cost) {
+	SystemModel sampled{load_data()};
+	SystemModel warped = sampled;
+	warped.engine = FitCostEngine::TEMPLATE;
+
+	std::vector<double> shifted_pose = synthetic_pose;
+	shifted_pose[0] += 10;
+	for (const auto &pose : {synthetic_pose, shifted_pose}) {
+		const Target target = target_from_pose(pose);
+		BOOST_CHECK_SMALL(warped.value(target) - sampled.value(target), 0.05f);
+	}
+	BOOST_CHECK_LT(warped.value(target_from_pose(synthetic_pose)),
+		warped.value(target_from_pose(shifted_pose)));
+
+	warped.samples = stratified_model_samples(4, 1);
+	BOOST_CHECK_LT(warped.value(target_from_pose(synthetic_pose)),
+		warped.value(target_from_pose(shifted_pose)));
+}
+
+BOOST_AUTO_TEST_CASE(test_model_camera_projects_through_lens) {
+	const cv::Size image_size(340, 256);
+	BOOST_CHECK_EQUAL(cv::norm(model_camera(image_size, LensCalibration()).projection_matrix -
+		syntheticCamera(image_size).projection_matrix), 0);
+
+	const LensCalibration lens = syntheticLens(cv::Size(680, 512));
+	const Camera camera = model_camera(image_size, lens);
+	const std::vector<cv::Point3f> points{{0, 0, 300}, {-100, 60, 280}, {110, -90, 320}};
+	std::vector<cv::Point2f> expected;
+	const LensCalibration scaled = lens.scaled(image_size);
+	cv::projectPoints(points, cv::Vec3d(), cv::Vec3d(), cv::Mat(scaled.camera_matrix),
+		scaled.distortion, expected);
+	for (size_t i = 0; i < points.size(); i++) {
+		const Vec2f projected = camera.project(Vec3f(points[i].x, points[i].y, points[i].z));
+		BOOST_CHECK_SMALL(cv::norm(cv::Point2f(projected[0], projected[1]) - expected[i]), 0.01);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_fit_distorted_frame) {
+	SyntheticScene scene;
+	scene.pose = {25, -15, 300, 0.1, 0.15, 0};
+	scene.image_size = cv::Size(340, 256);
+	const LensCalibration lens = syntheticLens(scene.image_size);
+	const SyntheticFrame frame = distortSyntheticFrame(SyntheticTargetRenderer().render(scene), lens);
+
+	auto translation_error_of = [&scene](const std::vector<double> &pose) {
+		return cv::norm(cv::Vec3d(pose[0], pose[1], pose[2]) -
+			cv::Vec3d(scene.pose[0], scene.pose[1], scene.pose[2]));
+	};
+	const double lens_error = translation_error_of(
+		fit_target_model_pose(frame.image, frame.quad, FitCostEngine::SAMPLED, lens));
+	const double pinhole_error = translation_error_of(
+		fit_target_model_pose(frame.image, frame.quad));
+	BOOST_CHECK_LT(lens_error, 5.0);
+	BOOST_CHECK_LT(lens_error, pinhole_error);
+
+	// The template engine compares on the undistorted image.
+	SystemModel model = system_model_for_image(frame.image, lens);
+	model.engine = FitCostEngine::TEMPLATE;
+	BOOST_CHECK(!model.undistorted_image.empty());
+	std::vector<double> shifted_pose = scene.pose;
+	shifted_pose[0] += 10;
+	BOOST_CHECK_LT(model.value(target_from_pose(scene.pose)),
+		model.value(target_from_pose(shifted_pose)));
+}
+
 BOOST_AUTO_TEST_CASE(test_project_modelspace_to_imagespace) {
 	auto camera_image = load_data();
 
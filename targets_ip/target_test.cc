@@ -1,6 +1,7 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <limits>
 #include <string>
 
 #define BOOST_TEST_MAIN
@@ -13,6 +14,8 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 
+#include "pipeline.h"
+#include "synthetic.h"
 #include "target.h"
 #include "utils.h"
 
@@ -50,6 +53,192 @@ BOOST_AUTO_TEST_CASE(test_detect_and_warp_target) {
 	BOOST_CHECK_EQUAL(data.poly[3], cv::Point(130, 175));
 }
 
+BOOST_AUTO_TEST_CASE(test_detect_synthetic_target) {
+	const cv::Size image_size(256, 256);
+	SyntheticTargetRenderer renderer(512, 1);
+	cv::RNG rng(1);
+
+	for (int i = 0; i < 20; i++) {
+		SyntheticScene scene = randomSyntheticScene(&rng, image_size, 0);
+		SyntheticFrame frame = renderer.render(scene);
+
+		TargetExtractorData data(cv::Size(256, 256), image_size.height);
+		data.img = frame.image;
+		preprocessInput(&data);
+		extractTargetFace(&data, 3, 3, 240);
+
+		BOOST_REQUIRE_EQUAL(data.poly.size(), 4);
+		for (const auto &corner : data.poly) {
+			float nearest = std::numeric_limits<float>::max();
+			for (const auto &expected : frame.quad) {
+				nearest = std::min(nearest, dist(cv::Point2f(corner), expected));
+			}
+			BOOST_CHECK_LT(nearest, 4.0f);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_warp_from_original_keeps_detail) {
+	SyntheticTargetRenderer renderer(1024, 1);
+	SyntheticScene scene;
+	scene.image_size = cv::Size(1024, 768);
+	scene.pose = {0, 0, 300, 0.1, -0.2, 0.1};
+	const cv::Mat image = renderer.render(scene).image;
+
+	TargetExtractorData low(cv::Size(256, 256), 256);
+	low.img = image;
+	preprocessInput(&low);
+	extractTargetFace(&low, 3, 3, 240);
+
+	TargetExtractorData high(cv::Size(256, 256), 256);
+	high.warp_from_original = true;
+	high.img = image;
+	preprocessInput(&high);
+	extractTargetFace(&high, 3, 3, 240);
+
+	BOOST_REQUIRE(!low.warped.empty());
+	BOOST_REQUIRE(!high.warped.empty());
+	BOOST_CHECK(low.poly == high.poly);
+
+	auto sharpness = [](const cv::Mat &face) {
+		cv::Mat laplacian;
+		cv::Laplacian(face, laplacian, CV_32F);
+		cv::Scalar mean, std_dev;
+		cv::meanStdDev(laplacian, mean, std_dev);
+		return std_dev[0];
+	};
+	BOOST_CHECK_GT(sharpness(high.warped), 1.5 * sharpness(low.warped));
+
+	// Same geometry, both faces agree once the detail is blurred away.
+	cv::Mat low_blurred, high_blurred;
+	cv::GaussianBlur(low.warped, low_blurred, cv::Size(0, 0), 4);
+	cv::GaussianBlur(high.warped, high_blurred, cv::Size(0, 0), 4);
+	BOOST_CHECK_LT(cv::norm(low_blurred, high_blurred, cv::NORM_L1) / low_blurred.total(), 8.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_blur_threshold_dilate_matches_opencv) {
+	cv::RNG rng(7);
+	cv::Mat noise(97, 131, CV_8UC1);
+	rng.fill(noise, cv::RNG::UNIFORM, 0, 256);
+	cv::Mat blobs;
+	cv::GaussianBlur(noise, blobs, cv::Size(0, 0), 4);
+	cv::normalize(blobs, blobs, 0, 255, cv::NORM_MINMAX);
+
+	for (const cv::Mat &value : {noise, blobs}) {
+		for (int smoothing : {0, 1, 3, 5, 7}) {
+			for (int dilate : {0, 1, 2, 3, 4, 5}) {
+				for (int threshold : {-1, 0, 127, 128, 240, 255}) {
+					cv::Mat expected_smoothed = value;
+					if (smoothing) {
+						cv::blur(value, expected_smoothed, cv::Size(smoothing, smoothing));
+					}
+					cv::Mat expected_thresholded, expected;
+					cv::threshold(expected_smoothed, expected_thresholded, threshold, 255, cv::THRESH_BINARY);
+					expected = expected_thresholded;
+					if (dilate) {
+						cv::dilate(expected_thresholded, expected,
+							cv::getStructuringElement(cv::MORPH_RECT, cv::Size(dilate, dilate)));
+					}
+
+					cv::Mat mask, smoothed, thresholded;
+					blurThresholdDilate(value, smoothing, threshold, dilate, &mask, &smoothed, &thresholded);
+					BOOST_CHECK_EQUAL(cv::norm(smoothed, expected_smoothed, cv::NORM_INF), 0);
+					BOOST_CHECK_EQUAL(cv::norm(thresholded, expected_thresholded, cv::NORM_INF), 0);
+					BOOST_CHECK_EQUAL(cv::norm(mask, expected, cv::NORM_INF), 0);
+				}
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_detect_new_arrows_incrementally) {
+	SyntheticTargetRenderer renderer(512, 1);
+	SyntheticScene scene;
+	scene.pose = {0, 0, 300, 0.1, -0.1, 0.2};
+
+	auto extract = [&renderer](const SyntheticScene &scene, TargetExtractorData *data) {
+		data->img = renderer.render(scene).image;
+		preprocessInput(data);
+		extractTargetFace(data, 3, 3, 240);
+	};
+
+	TargetExtractorData data(cv::Size(256, 256), 256);
+	ArrowTrackingState state;
+	extract(scene, &data);
+	detectNewArrows(&data, &state, 50, 200, 50);
+	const std::vector<cv::Vec4i> initial_lines = data.lines;
+
+	scene.arrows.push_back({cv::Vec2f{0.2f, -0.1f}, 0.5f, 0.5f});
+	extract(scene, &data);
+	detectNewArrows(&data, &state, 50, 200, 50);
+	BOOST_REQUIRE_GT(data.lines.size(), initial_lines.size());
+	BOOST_CHECK(!state.regions.empty());
+	// Lines away from the arrow are carried unchanged.
+	for (const auto &line : initial_lines) {
+		const cv::Point middle((line[0] + line[2]) / 2, (line[1] + line[3]) / 2);
+		const bool reexamined = std::any_of(state.regions.begin(), state.regions.end(),
+			[middle](const cv::Rect &region) { return region.contains(middle); });
+		if (!reexamined) {
+			BOOST_CHECK(std::find(data.lines.begin(), data.lines.end(), line) != data.lines.end());
+		}
+	}
+
+	const std::vector<cv::Vec4i> arrow_lines = data.lines;
+	extract(scene, &data);
+	detectNewArrows(&data, &state, 50, 200, 50);
+	BOOST_CHECK(data.lines == arrow_lines);
+
+	resetArrowTracking(&state);
+	BOOST_CHECK(state.lines.empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_new_arrows_stable_under_noise_and_jitter) {
+	SyntheticTargetRenderer renderer(512, 2);
+	SyntheticScene scene;
+	scene.pose = {0, 0, 300, 0.1, -0.1, 0.2};
+	scene.noise_sigma = 4;
+	scene.arrows.push_back({cv::Vec2f{-0.3f, 0.2f}, 0.8f, 0.5f});
+
+	TargetExtractorData data(cv::Size(256, 256), 256);
+	ArrowTrackingState state;
+	cv::RNG rng(5);
+	std::vector<size_t> counts;
+	for (int frame = 0; frame < 20; frame++) {
+		// Fresh sensor noise and a slight camera shake in every frame.
+		SyntheticScene jittered = scene;
+		jittered.pose[0] += rng.uniform(-0.3, 0.3);
+		jittered.pose[1] += rng.uniform(-0.3, 0.3);
+		data.img = renderer.render(jittered).image;
+		preprocessInput(&data);
+		extractTargetFace(&data, 3, 3, 240);
+		BOOST_REQUIRE_EQUAL(data.poly.size(), 4);
+		detectNewArrows(&data, &state, 50, 200, 50);
+		counts.push_back(data.lines.size());
+	}
+	for (size_t count : counts) {
+		BOOST_CHECK_LE(count, counts[0] + counts[0] / 4 + 4);
+	}
+	BOOST_CHECK_EQUAL(state.lines.size(), counts.back());
+}
+
+BOOST_AUTO_TEST_CASE(test_lost_face_clears_previous_face) {
+	SyntheticScene scene;
+	scene.image_size = cv::Size(320, 240);
+	TargetExtractorData data(cv::Size(128, 128), 256);
+	data.img = SyntheticTargetRenderer().render(scene).image;
+	preprocessInput(&data);
+	extractTargetFace(&data, 3, 3, 240);
+	BOOST_REQUIRE_EQUAL(data.poly.size(), 4);
+
+	// A dark frame without any contour.
+	data.img = cv::Mat(240, 320, CV_8UC3, cv::Scalar(0, 0, 0));
+	preprocessInput(&data);
+	extractTargetFace(&data, 3, 3, 240);
+	BOOST_CHECK(data.poly.empty());
+	BOOST_CHECK(data.homography.empty());
+	BOOST_CHECK(data.warped.empty());
+}
+
 BOOST_AUTO_TEST_CASE(test_interactive_threshold, *disabled()) {
 	cv::namedWindow("opencv", 1);
 
@@ -72,12 +261,13 @@ BOOST_AUTO_TEST_CASE(test_interactive_threshold, *disabled()) {
 	cv::createTrackbar("hough", "opencv", &hough, 300, NULL, NULL);
 
 	TargetExtractorData data(cv::Size(512, 512), 512);
-
-	loadAndPreprocessInput(&data, target_image_0001);
+	data.keep_intermediates = true;
+	TargetPipeline pipeline(&data);
+	pipeline.setInput(imread(target_image_0001, cv::IMREAD_COLOR));
 
 	while (true) {
-		extractTargetFace(&data, smoothing, dilate, threshold);
-		detectArrows(&data, canny1, canny2, hough);
+		pipeline.setParameters(smoothing, dilate, threshold, canny1, canny2, hough);
+		pipeline.detectArrows();
 
 		// showStack({&data.warped, &data.warped_edges, &data.lines_drawing}, 3, false);
 
@@ -134,3 +324,33 @@ BOOST_AUTO_TEST_CASE(test_ip_pipeline, *disabled()) {
 
 	showStack({&imgResized, &imgEqualizedBGR, &imgEqualizedBGR2}, 3);
 }
+
+BOOST_AUTO_TEST_CASE(test_fit_from_corners_of_distorted_face) {
+	SyntheticScene scene;
+	scene.pose = {25, -15, 300, 0.1, 0.15, 0};
+	scene.image_size = cv::Size(340, 256);
+	const LensCalibration lens = syntheticLens(scene.image_size);
+	const SyntheticFrame frame = distortSyntheticFrame(SyntheticTargetRenderer().render(scene), lens);
+
+	TargetExtractorData data(cv::Size(256, 256), 256);
+	data.lens = lens;
+	data.img = frame.image;
+	preprocessInput(&data);
+	extractTargetFace(&data, 3, 3, 240);
+	const std::vector<cv::Point2f> corners = faceCorners(data);
+	BOOST_REQUIRE_EQUAL(corners.size(), 4);
+
+	// The corners are back in distorted image coordinates.
+	for (const auto &corner : corners) {
+		float nearest = std::numeric_limits<float>::max();
+		for (const auto &truth : frame.quad) {
+			nearest = std::min(nearest, static_cast<float>(cv::norm(corner - truth)));
+		}
+		BOOST_CHECK_LT(nearest, 3.0f);
+	}
+
+	const std::vector<double> pose = fit_target_model_pose(frame.image, corners,
+		FitCostEngine::SAMPLED, lens);
+	BOOST_CHECK_LT(cv::norm(cv::Vec3d(pose[0], pose[1], pose[2]) -
+		cv::Vec3d(scene.pose[0], scene.pose[1], scene.pose[2])), 5.0);
+}
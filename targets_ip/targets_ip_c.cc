@@ -0,0 +1,223 @@
+#include "targets_ip_c.h"
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "target.h"
+#include "target_model.h"
+
+struct tip_context {
+	tip_parameters parameters;
+	TargetExtractorData data;
+	cv::Mat converted;  // non-BGR input converted to BGR
+	std::string error;
+
+	explicit tip_context(const tip_parameters &parameters)
+		: parameters(parameters),
+			data(cv::Size(parameters.face_size, parameters.face_size),
+				parameters.scaled_input_size) {
+	}
+};
+
+namespace {
+
+tip_status fail(tip_context *context, tip_status status, const std::string &error) {
+	context->error = error;
+	return status;
+}
+
+// BGR view of the caller's buffer, converted only for other formats.
+bool wrapImage(tip_context *context, const tip_image *image, cv::Mat *bgr) {
+	if (!image || !image->data || image->width <= 0 || image->height <= 0) {
+		return false;
+	}
+	static const int types[] = {CV_8UC1, CV_8UC3, CV_8UC3, CV_8UC4, CV_8UC4};
+	static const int conversions[] = {cv::COLOR_GRAY2BGR, -1, cv::COLOR_RGB2BGR,
+		cv::COLOR_BGRA2BGR, cv::COLOR_RGBA2BGR};
+	const int format = image->format;
+	if (format < TIP_FORMAT_GRAY8 || format > TIP_FORMAT_RGBA8) {
+		return false;
+	}
+	const int type = types[format];
+	if (image->stride < static_cast<size_t>(image->width) * CV_ELEM_SIZE(type)) {
+		return false;
+	}
+	// Only read, the const_cast is for the cv::Mat header.
+	const cv::Mat wrapped(image->height, image->width, type,
+		const_cast<uint8_t*>(image->data), image->stride);
+	if (conversions[format] < 0) {
+		*bgr = wrapped;
+	} else {
+		cv::cvtColor(wrapped, context->converted, conversions[format]);
+		*bgr = context->converted;
+	}
+	return true;
+}
+
+template<typename F>
+tip_status guarded(tip_context *context, F body) {
+	if (!context) {
+		return TIP_INVALID_ARGUMENT;
+	}
+	try {
+		context->error.clear();
+		return body();
+	} catch (const std::exception &exception) {
+		return fail(context, TIP_ERROR, exception.what());
+	}
+}
+
+}  // namespace
+
+int32_t tip_api_version(void) {
+	return TIP_API_VERSION;
+}
+
+void tip_default_parameters(tip_parameters *parameters) {
+	if (!parameters) {
+		return;
+	}
+	parameters->face_size = 256;
+	parameters->scaled_input_size = 256;
+	parameters->smoothing = 3;
+	parameters->dilate = 3;
+	parameters->threshold = AUTO_THRESHOLD;
+	parameters->canny1 = 50;
+	parameters->canny2 = 200;
+	parameters->hough = 50;
+}
+
+tip_context *tip_context_create(const tip_parameters *parameters) {
+	tip_parameters values;
+	tip_default_parameters(&values);
+	if (parameters) {
+		values = *parameters;
+	}
+	if (values.face_size <= 0 || values.scaled_input_size <= 0 ||
+		values.smoothing < 0 || values.dilate < 0 ||
+		values.threshold < AUTO_THRESHOLD || values.threshold > 255) {
+		return nullptr;
+	}
+	try {
+		return new tip_context(values);
+	} catch (const std::exception&) {
+		return nullptr;
+	}
+}
+
+void tip_context_destroy(tip_context *context) {
+	delete context;
+}
+
+const char *tip_last_error(const tip_context *context) {
+	return context ? context->error.c_str() : "no context";
+}
+
+tip_status tip_extract_face(tip_context *context, const tip_image *image, tip_face *face) {
+	return guarded(context, [&]() {
+		TargetExtractorData &data = context->data;
+		if (!wrapImage(context, image, &data.img) || !face) {
+			return fail(context, TIP_INVALID_ARGUMENT, "invalid image or face");
+		}
+		const tip_parameters &parameters = context->parameters;
+		preprocessInput(&data);
+		data.poly.clear();
+		data.homography.release();
+		data.warped.release();
+		extractTargetFace(&data, parameters.smoothing, parameters.dilate, parameters.threshold);
+		if (data.homography.empty()) {
+			return fail(context, TIP_NOT_FOUND, "no target face found");
+		}
+
+		const std::vector<cv::Point2f> corners = faceCorners(data);
+		for (size_t i = 0; i < 4; i++) {
+			face->quad[2 * i] = corners[i].x;
+			face->quad[2 * i + 1] = corners[i].y;
+		}
+		// Face homography of the resized image composed with the scaling of
+		// the input.
+		cv::Mat homography;
+		data.homography.convertTo(homography, CV_64F);
+		const cv::Matx33d scale(
+			data.img_resized.cols / static_cast<double>(data.img.cols), 0, 0,
+			0, data.img_resized.rows / static_cast<double>(data.img.rows), 0,
+			0, 0, 1);
+		homography = homography * cv::Mat(scale);
+		std::copy(homography.ptr<double>(), homography.ptr<double>() + 9, face->homography);
+		return TIP_OK;
+	});
+}
+
+tip_status tip_copy_face(const tip_context *context, uint8_t *data, size_t stride) {
+	if (!context || !data) {
+		return TIP_INVALID_ARGUMENT;
+	}
+	const cv::Mat &warped = context->data.warped;
+	if (warped.empty()) {
+		return TIP_NOT_FOUND;
+	}
+	if (stride < static_cast<size_t>(warped.cols)) {
+		return TIP_BUFFER_TOO_SMALL;
+	}
+	cv::Mat destination(warped.rows, warped.cols, CV_8UC1, data, stride);
+	warped.copyTo(destination);
+	return TIP_OK;
+}
+
+tip_status tip_detect_arrows(tip_context *context, int32_t *segments,
+	size_t capacity, size_t *segment_count) {
+	return guarded(context, [&]() {
+		if (!segment_count || (capacity && !segments)) {
+			return fail(context, TIP_INVALID_ARGUMENT, "invalid segment buffer");
+		}
+		TargetExtractorData &data = context->data;
+		if (data.warped.empty()) {
+			return fail(context, TIP_NOT_FOUND, "no extracted face");
+		}
+		const tip_parameters &parameters = context->parameters;
+		detectArrows(&data, parameters.canny1, parameters.canny2, parameters.hough);
+		*segment_count = data.lines.size();
+		const size_t written = std::min(capacity, data.lines.size());
+		for (size_t i = 0; i < written; i++) {
+			std::copy(data.lines[i].val, data.lines[i].val + 4, segments + 4 * i);
+		}
+		return written < data.lines.size() ? TIP_BUFFER_TOO_SMALL : TIP_OK;
+	});
+}
+
+tip_status tip_fit_pose(tip_context *context, const tip_image *image,
+	const tip_face *seed, double pose[6]) {
+	return guarded(context, [&]() {
+		cv::Mat bgr;
+		if (!wrapImage(context, image, &bgr) || !pose) {
+			return fail(context, TIP_INVALID_ARGUMENT, "invalid image or pose");
+		}
+		std::vector<cv::Point2f> quad;
+		if (seed) {
+			for (size_t i = 0; i < 4; i++) {
+				quad.emplace_back(seed->quad[2 * i], seed->quad[2 * i + 1]);
+			}
+		}
+		const std::vector<double> fitted = fit_target_model_pose(bgr, quad);
+		std::copy(fitted.begin(), fitted.end(), pose);
+		return TIP_OK;
+	});
+}
+
+tip_status tip_score_pose(tip_context *context, const tip_image *image,
+	const double pose[6], float *cost) {
+	return guarded(context, [&]() {
+		cv::Mat bgr;
+		if (!wrapImage(context, image, &bgr) || !pose || !cost) {
+			return fail(context, TIP_INVALID_ARGUMENT, "invalid image, pose or cost");
+		}
+		const SystemModel model = system_model_for_image(bgr);
+		*cost = model.value(target_from_pose(std::vector<double>(pose, pose + 6)));
+		return TIP_OK;
+	});
+}
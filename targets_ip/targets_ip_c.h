@@ -0,0 +1,100 @@
+#ifndef _TARGETS_IP_C_H
+#define _TARGETS_IP_C_H
+#pragma once
+
+/* C API of libtargets_ip for in-process embedding, e.g. through JNI or
+ * Python ctypes. Images are caller owned buffers which are read in place
+ * and never retained past a call. A context keeps the pipeline buffers
+ * between calls and must not be used by two threads at once; separate
+ * contexts are independent. Functions return TIP_OK or an error status,
+ * tip_last_error describes the last error of a context. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TIP_API __attribute__((visibility("default")))
+
+/* Incremented on incompatible changes of this header. */
+#define TIP_API_VERSION 1
+
+typedef enum {
+	TIP_OK = 0,
+	TIP_INVALID_ARGUMENT = 1,
+	TIP_NOT_FOUND = 2,  /* no target face in the image */
+	TIP_BUFFER_TOO_SMALL = 3,
+	TIP_ERROR = 4
+} tip_status;
+
+typedef enum {
+	TIP_FORMAT_GRAY8 = 0,
+	TIP_FORMAT_BGR8 = 1,
+	TIP_FORMAT_RGB8 = 2,
+	TIP_FORMAT_BGRA8 = 3,
+	TIP_FORMAT_RGBA8 = 4
+} tip_pixel_format;
+
+/* BGR8 buffers are used without copying, other formats are converted into
+ * a buffer of the context which is reused between calls. */
+typedef struct {
+	const uint8_t *data;
+	int32_t width;
+	int32_t height;
+	size_t stride;  /* bytes per row */
+	tip_pixel_format format;
+} tip_image;
+
+typedef struct {
+	int32_t face_size;  /* side of the rectified face, 256 */
+	int32_t scaled_input_size;  /* height the input is resized to, 256 */
+	int32_t smoothing;  /* 3 */
+	int32_t dilate;  /* 3 */
+	int32_t threshold;  /* 0-255, -1 selects it per image (default) */
+	int32_t canny1;  /* 50 */
+	int32_t canny2;  /* 200 */
+	int32_t hough;  /* 50 */
+} tip_parameters;
+
+typedef struct {
+	float quad[8];  /* face corners x, y in image pixels */
+	double homography[9];  /* image to face, row major */
+} tip_face;
+
+typedef struct tip_context tip_context;
+
+TIP_API int32_t tip_api_version(void);
+TIP_API void tip_default_parameters(tip_parameters *parameters);
+
+/* Returns NULL on invalid parameters. */
+TIP_API tip_context *tip_context_create(const tip_parameters *parameters);
+TIP_API void tip_context_destroy(tip_context *context);
+TIP_API const char *tip_last_error(const tip_context *context);
+
+/* Finds and rectifies the target face. */
+TIP_API tip_status tip_extract_face(tip_context *context, const tip_image *image,
+	tip_face *face);
+/* Copies the rectified face of the last extraction, face_size x face_size
+ * 8-bit value plane. */
+TIP_API tip_status tip_copy_face(const tip_context *context, uint8_t *data, size_t stride);
+/* Arrow line segments x1, y1, x2, y2 in face pixels of the last
+ * extraction. segment_count receives the number of segments found, at most
+ * capacity are written. */
+TIP_API tip_status tip_detect_arrows(tip_context *context, int32_t *segments,
+	size_t capacity, size_t *segment_count);
+/* Fits the target pose {x, y, z, euler x, y, z} to the image. The fit
+ * starts from the pose of seed, a face of tip_extract_face on this image,
+ * or from a default pose when seed is NULL. */
+TIP_API tip_status tip_fit_pose(tip_context *context, const tip_image *image,
+	const tip_face *seed, double pose[6]);
+/* Fit cost of a pose, lower is better. */
+TIP_API tip_status tip_score_pose(tip_context *context, const tip_image *image,
+	const double pose[6], float *cost);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* _TARGETS_IP_C_H */
@@ -0,0 +1,116 @@
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TargetsIpCTest
+
+#include <cstdint>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "synthetic.h"
+#include "targets_ip_c.h"
+
+cv::Mat syntheticImage() {
+	SyntheticScene scene;
+	scene.pose = {10, -5, 320, 0.1, 0.15, 0};
+	scene.image_size = cv::Size(512, 384);
+	return SyntheticTargetRenderer().render(scene).image;
+}
+
+tip_image imageView(const cv::Mat &image, tip_pixel_format format) {
+	return {image.data, image.cols, image.rows, image.step[0], format};
+}
+
+BOOST_AUTO_TEST_CASE(test_invalid_arguments) {
+	BOOST_CHECK_EQUAL(tip_api_version(), TIP_API_VERSION);
+	tip_parameters parameters;
+	tip_default_parameters(&parameters);
+	parameters.threshold = 300;
+	BOOST_CHECK(tip_context_create(&parameters) == nullptr);
+
+	tip_context *context = tip_context_create(nullptr);
+	BOOST_REQUIRE(context != nullptr);
+	tip_face face;
+	BOOST_CHECK_EQUAL(tip_extract_face(context, nullptr, &face), TIP_INVALID_ARGUMENT);
+	BOOST_CHECK_EQUAL(tip_extract_face(nullptr, nullptr, &face), TIP_INVALID_ARGUMENT);
+	size_t count = 0;
+	BOOST_CHECK_EQUAL(tip_detect_arrows(context, nullptr, 0, &count), TIP_NOT_FOUND);
+	tip_context_destroy(context);
+}
+
+BOOST_AUTO_TEST_CASE(test_extract_face_from_caller_buffers) {
+	const cv::Mat bgr = syntheticImage();
+	cv::Mat rgba;
+	cv::cvtColor(bgr, rgba, cv::COLOR_BGR2RGBA);
+
+	tip_context *context = tip_context_create(nullptr);
+	BOOST_REQUIRE(context != nullptr);
+
+	tip_face bgr_face, rgba_face;
+	const tip_image bgr_image = imageView(bgr, TIP_FORMAT_BGR8);
+	const tip_image rgba_image = imageView(rgba, TIP_FORMAT_RGBA8);
+	BOOST_REQUIRE_EQUAL(tip_extract_face(context, &rgba_image, &rgba_face), TIP_OK);
+	BOOST_REQUIRE_EQUAL(tip_extract_face(context, &bgr_image, &bgr_face), TIP_OK);
+	for (int i = 0; i < 8; i++) {
+		BOOST_CHECK_CLOSE(bgr_face.quad[i], rgba_face.quad[i], 0.0001);
+	}
+
+	// The homography maps the first quad corner to the face origin.
+	const cv::Matx33d homography(bgr_face.homography);
+	const cv::Vec3d origin = homography * cv::Vec3d(bgr_face.quad[0], bgr_face.quad[1], 1);
+	BOOST_CHECK_SMALL(origin[0] / origin[2], 0.5);
+	BOOST_CHECK_SMALL(origin[1] / origin[2], 0.5);
+
+	std::vector<uint8_t> face(256 * 300);
+	BOOST_CHECK_EQUAL(tip_copy_face(context, face.data(), 100), TIP_BUFFER_TOO_SMALL);
+	BOOST_CHECK_EQUAL(tip_copy_face(context, face.data(), 300), TIP_OK);
+
+	size_t count = 0;
+	BOOST_CHECK_EQUAL(tip_detect_arrows(context, nullptr, 0, &count),
+		count ? TIP_BUFFER_TOO_SMALL : TIP_OK);
+	tip_context_destroy(context);
+}
+
+BOOST_AUTO_TEST_CASE(test_fit_pose) {
+	const cv::Mat bgr = syntheticImage();
+	tip_context *context = tip_context_create(nullptr);
+	BOOST_REQUIRE(context != nullptr);
+	const tip_image image = imageView(bgr, TIP_FORMAT_BGR8);
+	const double true_pose[6] = {10, -5, 320, 0.1, 0.15, 0};
+
+	double pose[6];
+	BOOST_CHECK_EQUAL(tip_fit_pose(context, &image, nullptr, nullptr), TIP_INVALID_ARGUMENT);
+
+	tip_face face;
+	BOOST_REQUIRE_EQUAL(tip_extract_face(context, &image, &face), TIP_OK);
+	BOOST_REQUIRE_EQUAL(tip_fit_pose(context, &image, &face, pose), TIP_OK);
+	for (int i = 0; i < 3; i++) {
+		BOOST_CHECK_SMALL(pose[i] - true_pose[i], 10.0);
+	}
+	for (int i = 3; i < 6; i++) {
+		BOOST_CHECK_SMALL(pose[i] - true_pose[i], 0.1);
+	}
+
+	// Unseeded fits start from the default pose and still find the target.
+	BOOST_REQUIRE_EQUAL(tip_fit_pose(context, &image, nullptr, pose), TIP_OK);
+	BOOST_CHECK_SMALL(pose[0] - true_pose[0], 20.0);
+	BOOST_CHECK_SMALL(pose[1] - true_pose[1], 20.0);
+	tip_context_destroy(context);
+}
+
+BOOST_AUTO_TEST_CASE(test_score_pose) {
+	const cv::Mat bgr = syntheticImage();
+	tip_context *context = tip_context_create(nullptr);
+	const tip_image image = imageView(bgr, TIP_FORMAT_BGR8);
+
+	const double true_pose[6] = {10, -5, 320, 0.1, 0.15, 0};
+	const double shifted_pose[6] = {25, -5, 320, 0.1, 0.15, 0};
+	float true_cost = 0, shifted_cost = 0;
+	BOOST_REQUIRE_EQUAL(tip_score_pose(context, &image, true_pose, &true_cost), TIP_OK);
+	BOOST_REQUIRE_EQUAL(tip_score_pose(context, &image, shifted_pose, &shifted_cost), TIP_OK);
+	BOOST_CHECK_LT(true_cost, shifted_cost);
+	tip_context_destroy(context);
+}
@@ -0,0 +1,147 @@
+#include "tfrecord.h"
+
+#include <array>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+// Castagnoli polynomial, reflected.
+const uint32_t CRC32C_POLYNOMIAL = 0x82f63b78;
+const uint32_t CRC_MASK_DELTA = 0xa282ead8;
+
+std::array<uint32_t, 256> createCrc32cTable() {
+	std::array<uint32_t, 256> table;
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLYNOMIAL : 0);
+		}
+		table[i] = crc;
+	}
+	return table;
+}
+
+uint32_t crc32c(const void *data, size_t size, uint32_t crc) {
+	const auto *bytes = static_cast<const uint8_t*>(data);
+	crc = ~crc;
+#if defined(__SSE4_2__)
+	for (; size >= 8; size -= 8, bytes += 8) {
+		uint64_t word;
+		std::memcpy(&word, bytes, sizeof(word));
+		crc = static_cast<uint32_t>(_mm_crc32_u64(crc, word));
+	}
+	for (; size; size--, bytes++) {
+		crc = _mm_crc32_u8(crc, *bytes);
+	}
+#else
+	static const std::array<uint32_t, 256> table = createCrc32cTable();
+	for (; size; size--, bytes++) {
+		crc = table[(crc ^ *bytes) & 0xff] ^ (crc >> 8);
+	}
+#endif
+	return ~crc;
+}
+
+uint32_t maskedCrc32c(const void *data, size_t size) {
+	const uint32_t crc = crc32c(data, size);
+	return ((crc >> 15) | (crc << 17)) + CRC_MASK_DELTA;
+}
+
+//-----------------------------------------------------------------------------
+
+const int WIRE_VARINT = 0;
+const int WIRE_LENGTH_DELIMITED = 2;
+
+void appendVarint(std::string *out, uint64_t value) {
+	while (value >= 0x80) {
+		out->push_back(static_cast<char>(value | 0x80));
+		value >>= 7;
+	}
+	out->push_back(static_cast<char>(value));
+}
+
+void appendTag(std::string *out, int field, int wire_type) {
+	appendVarint(out, (field << 3) | wire_type);
+}
+
+void appendLengthDelimited(std::string *out, int field, const std::string &value) {
+	appendTag(out, field, WIRE_LENGTH_DELIMITED);
+	appendVarint(out, value.size());
+	out->append(value);
+}
+
+// Feature { oneof kind { BytesList bytes_list = 1; FloatList float_list = 2;
+// Int64List int64_list = 3; } }, every list has repeated field value = 1.
+void TFExample::addBytes(const std::string &key, const std::vector<std::string> &values) {
+	std::string list;
+	for (const auto &value : values) {
+		appendLengthDelimited(&list, 1, value);
+	}
+	std::string feature;
+	appendLengthDelimited(&feature, 1, list);
+	features.emplace_back(key, feature);
+}
+
+void TFExample::addFloats(const std::string &key, const std::vector<float> &values) {
+	std::string packed(values.size() * sizeof(float), '\0');
+	std::memcpy(&packed[0], values.data(), packed.size());
+	std::string list;
+	if (!values.empty()) {
+		appendLengthDelimited(&list, 1, packed);
+	}
+	std::string feature;
+	appendLengthDelimited(&feature, 2, list);
+	features.emplace_back(key, feature);
+}
+
+void TFExample::addInt64s(const std::string &key, const std::vector<int64_t> &values) {
+	std::string packed;
+	for (int64_t value : values) {
+		appendVarint(&packed, static_cast<uint64_t>(value));
+	}
+	std::string list;
+	if (!values.empty()) {
+		appendLengthDelimited(&list, 1, packed);
+	}
+	std::string feature;
+	appendLengthDelimited(&feature, 3, list);
+	features.emplace_back(key, feature);
+}
+
+// Example { Features features = 1; }, Features { map<string, Feature>
+// feature = 1; } with map entries { string key = 1; Feature value = 2; }.
+std::string TFExample::serialize() const {
+	std::string feature_map;
+	for (const auto &feature : features) {
+		std::string entry;
+		appendLengthDelimited(&entry, 1, feature.first);
+		appendLengthDelimited(&entry, 2, feature.second);
+		appendLengthDelimited(&feature_map, 1, entry);
+	}
+	std::string example;
+	appendLengthDelimited(&example, 1, feature_map);
+	return example;
+}
+
+//-----------------------------------------------------------------------------
+
+TFRecordWriter::TFRecordWriter(const std::string &filename)
+	: file(filename, std::ios::binary) {
+}
+
+void TFRecordWriter::write(const std::string &record) {
+	uint8_t length[sizeof(uint64_t)];
+	const uint64_t size = record.size();
+	std::memcpy(length, &size, sizeof(length));
+	const uint32_t length_crc = maskedCrc32c(length, sizeof(length));
+	const uint32_t data_crc = maskedCrc32c(record.data(), record.size());
+
+	file.write(reinterpret_cast<const char*>(length), sizeof(length));
+	file.write(reinterpret_cast<const char*>(&length_crc), sizeof(length_crc));
+	file.write(record.data(), record.size());
+	file.write(reinterpret_cast<const char*>(&data_crc), sizeof(data_crc));
+}
@@ -0,0 +1,40 @@
+#ifndef _TFRECORD_H
+#define _TFRECORD_H
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+uint32_t crc32c(const void *data, size_t size, uint32_t crc = 0);
+uint32_t maskedCrc32c(const void *data, size_t size);
+
+// Minimal serializer of the tf.train.Example protocol buffer.
+class TFExample {
+ private:
+	std::vector<std::pair<std::string, std::string>> features;
+
+ public:
+	void addBytes(const std::string &key, const std::vector<std::string> &values);
+	void addFloats(const std::string &key, const std::vector<float> &values);
+	void addInt64s(const std::string &key, const std::vector<int64_t> &values);
+
+	std::string serialize() const;
+};
+
+// Writes records framed as TensorFlow's TFRecord format: little-endian
+// uint64 length, masked CRC32C of the length, data, masked CRC32C of data.
+class TFRecordWriter {
+ private:
+	std::ofstream file;
+
+ public:
+	explicit TFRecordWriter(const std::string &filename);
+
+	void write(const std::string &record);
+	bool good() const { return file.good(); }
+};
+
+#endif  // _TFRECORD_H
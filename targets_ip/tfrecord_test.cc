@@ -0,0 +1,44 @@
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TFRecordTest
+
+#include <boost/test/unit_test.hpp>
+
+#include "tfrecord.h"
+
+BOOST_AUTO_TEST_CASE(test_crc32c) {
+	const std::string check = "123456789";
+	BOOST_CHECK_EQUAL(crc32c(check.data(), check.size()), 0xe3069283);
+	BOOST_CHECK_EQUAL(crc32c(nullptr, 0), 0u);
+
+	const std::vector<uint8_t> zeros(32, 0);
+	BOOST_CHECK_EQUAL(crc32c(zeros.data(), zeros.size()), 0x8a9136aa);
+}
+
+BOOST_AUTO_TEST_CASE(test_crc32c_incremental) {
+	const std::string data = "The quick brown fox jumps over the lazy dog";
+	const uint32_t partial = crc32c(data.data(), 10);
+	BOOST_CHECK_EQUAL(crc32c(data.data() + 10, data.size() - 10, partial),
+		crc32c(data.data(), data.size()));
+}
+
+BOOST_AUTO_TEST_CASE(test_serialize_example) {
+	TFExample example;
+	example.addInt64s("a", {1});
+	// Example{features{feature{key: "a" value{int64_list{value: [1]}}}}}
+	const std::string expected(
+		"\x0a\x0c" "\x0a\x0a" "\x0a\x01" "a" "\x12\x05" "\x1a\x03\x0a\x01\x01", 14);
+	BOOST_CHECK(example.serialize() == expected);
+}
+
+BOOST_AUTO_TEST_CASE(test_serialize_float_list) {
+	TFExample example;
+	example.addFloats("b", {1.0f});
+	const std::string serialized = example.serialize();
+	// float_list = 2, packed value = 1 with four bytes of 1.0f
+	const std::string feature("\x12\x06\x0a\x04\x00\x00\x80\x3f", 8);
+	BOOST_CHECK(serialized.find(feature) != std::string::npos);
+}
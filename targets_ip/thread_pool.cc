@@ -0,0 +1,168 @@
+#include "thread_pool.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <utility>
+
+#include "trace.h"
+
+// Index of the pool worker running on this thread, -1 elsewhere.
+thread_local int current_worker = -1;
+thread_local const WorkStealingPool *current_pool = nullptr;
+
+void pinThread(std::thread *thread, int cpu) {
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(cpu, &cpu_set);
+	pthread_setaffinity_np(thread->native_handle(), sizeof(cpu_set), &cpu_set);
+}
+
+WorkStealingPool::WorkStealingPool(int workers, bool pin_threads)
+	: stopping(false), queued(0), unfinished(0), next_queue(0) {
+	workers = std::max(workers, 1);
+	for (int i = 0; i < workers; i++) {
+		queues.push_back(std::make_unique<WorkerQueue>());
+	}
+	const int cpus = std::max(1u, std::thread::hardware_concurrency());
+	for (int i = 0; i < workers; i++) {
+		threads.emplace_back(&WorkStealingPool::run, this, i);
+		if (pin_threads) {
+			pinThread(&threads.back(), i % cpus);
+		}
+	}
+}
+
+WorkStealingPool::~WorkStealingPool() {
+	wait();
+	{
+		std::lock_guard<std::mutex> lock(state_mutex);
+		stopping = true;
+	}
+	work_available.notify_all();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+void WorkStealingPool::submit(Task task, bool yield) {
+	const int worker = current_pool == this
+		? current_worker
+		: next_queue++ % queues.size();
+	unfinished++;
+	{
+		std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+		if (yield) {
+			queues[worker]->tasks.push_front(std::move(task));
+		} else {
+			queues[worker]->tasks.push_back(std::move(task));
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(state_mutex);
+		queued++;
+	}
+	work_available.notify_one();
+}
+
+bool WorkStealingPool::pop(int worker, Task *task) {
+	std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+	if (queues[worker]->tasks.empty()) {
+		return false;
+	}
+	*task = std::move(queues[worker]->tasks.back());
+	queues[worker]->tasks.pop_back();
+	return true;
+}
+
+bool WorkStealingPool::steal(int worker, Task *task) {
+	for (size_t i = 1; i < queues.size(); i++) {
+		WorkerQueue &victim = *queues[(worker + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			*task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkStealingPool::execute(Task *task) {
+	queued--;
+	(*task)();
+	if (--unfinished == 0) {
+		std::lock_guard<std::mutex> lock(state_mutex);
+		all_done.notify_all();
+	}
+}
+
+void WorkStealingPool::run(int worker) {
+	current_worker = worker;
+	current_pool = this;
+	TRACE_THREAD_NAME("worker " + std::to_string(worker));
+	while (true) {
+		Task task;
+		if (pop(worker, &task) || steal(worker, &task)) {
+			execute(&task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(state_mutex);
+		work_available.wait(lock, [this]() { return stopping || queued > 0; });
+		if (stopping && queued == 0) {
+			return;
+		}
+	}
+}
+
+void WorkStealingPool::wait() {
+	std::unique_lock<std::mutex> lock(state_mutex);
+	all_done.wait(lock, [this]() { return unfinished == 0; });
+}
+
+bool WorkStealingPool::runPendingTask() {
+	if (current_pool != this) {
+		return false;
+	}
+	Task task;
+	if (!pop(current_worker, &task) && !steal(current_worker, &task)) {
+		return false;
+	}
+	execute(&task);
+	return true;
+}
+
+void parallelFor(WorkStealingPool *pool, int count, const std::function<void(int)> &fnc) {
+	// Counts the tasks of this call only. The last task notifies while it
+	// holds the mutex, so the latch outlives every access to it.
+	std::mutex mutex;
+	std::condition_variable done;
+	int remaining = count;
+	for (int i = 0; i < count; i++) {
+		pool->submit([&, i]() {
+			fnc(i);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--remaining == 0) {
+				done.notify_all();
+			}
+		});
+	}
+
+	// Once no task is queued, the remaining tasks of this call are running
+	// on other workers and blocking is safe.
+	while (pool->runPendingTask()) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (remaining == 0) {
+			return;
+		}
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [&remaining]() { return remaining == 0; });
+}
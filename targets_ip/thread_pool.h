@@ -0,0 +1,67 @@
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of workers, each with its own task deque. A worker pops
+// its newest task first and, when idle, steals the oldest task of another
+// worker. Tasks submitted from a worker go to its own deque, tasks
+// submitted from outside are spread round-robin.
+class WorkStealingPool {
+ public:
+	using Task = std::function<void()>;
+
+ private:
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+	std::vector<std::thread> threads;
+	std::atomic<bool> stopping;
+	std::atomic<int> queued;
+	std::atomic<int> unfinished;
+	std::atomic<unsigned> next_queue;
+	std::mutex state_mutex;
+	std::condition_variable work_available;
+	std::condition_variable all_done;
+
+	bool pop(int worker, Task *task);
+	bool steal(int worker, Task *task);
+	void execute(Task *task);
+	void run(int worker);
+
+ public:
+	// With pin_threads, worker i is bound to CPU i modulo the CPU count.
+	explicit WorkStealingPool(int workers, bool pin_threads = false);
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool &operator=(const WorkStealingPool&) = delete;
+	~WorkStealingPool();
+
+	// A yielding task submitted from a worker is queued behind the worker's
+	// other tasks instead of running next.
+	void submit(Task task, bool yield = false);
+	// Blocks until every submitted task, including tasks submitted by
+	// tasks, has finished. Must not be called from a pool task.
+	void wait();
+	// Called from a worker of this pool, runs one queued task on the calling
+	// thread. Returns false when there is none or when called from elsewhere.
+	bool runPendingTask();
+	int size() const { return threads.size(); }
+};
+
+// Runs fnc(i) for i in [0, count) on the pool and waits for these tasks
+// only. Called from a pool task, the calling worker runs queued tasks while
+// it waits, so nested calls do not deadlock.
+void parallelFor(WorkStealingPool *pool, int count, const std::function<void(int)> &fnc);
+
+#endif  // _THREAD_POOL_H
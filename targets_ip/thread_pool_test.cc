@@ -0,0 +1,68 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE ThreadPoolTest
+
+#include <boost/test/unit_test.hpp>
+
+#include "thread_pool.h"
+
+BOOST_AUTO_TEST_CASE(test_parallel_for_visits_every_index) {
+	WorkStealingPool pool(4);
+	std::vector<std::atomic<int>> visits(1000);
+	parallelFor(&pool, visits.size(), [&visits](int i) { visits[i]++; });
+	for (const auto &count : visits) {
+		BOOST_CHECK_EQUAL(count, 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_wait_includes_nested_tasks) {
+	WorkStealingPool pool(3);
+	std::atomic<int> done{0};
+	for (int i = 0; i < 10; i++) {
+		pool.submit([&pool, &done]() {
+			for (int j = 0; j < 10; j++) {
+				pool.submit([&done]() { done++; });
+			}
+		});
+	}
+	pool.wait();
+	BOOST_CHECK_EQUAL(done, 100);
+}
+
+BOOST_AUTO_TEST_CASE(test_pinned_pool_runs_tasks) {
+	WorkStealingPool pool(2, true);
+	std::atomic<int> done{0};
+	parallelFor(&pool, 16, [&done](int) { done++; });
+	BOOST_CHECK_EQUAL(done, 16);
+}
+
+BOOST_AUTO_TEST_CASE(test_nested_parallel_for) {
+	// A single worker must run the inner tasks itself.
+	WorkStealingPool pool(1);
+	std::atomic<int> done{0};
+	parallelFor(&pool, 4, [&pool, &done](int) {
+		parallelFor(&pool, 8, [&done](int) { done++; });
+	});
+	BOOST_CHECK_EQUAL(done, 32);
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_for_waits_for_own_tasks) {
+	WorkStealingPool pool(2);
+	std::atomic<bool> release{false};
+	std::atomic<int> done{0};
+	// A long task of another user of the pool.
+	pool.submit([&release]() {
+		while (!release) {
+			std::this_thread::yield();
+		}
+	});
+	parallelFor(&pool, 16, [&done](int) { done++; });
+	BOOST_CHECK_EQUAL(done, 16);
+	BOOST_CHECK(!release);
+	release = true;
+	pool.wait();
+}
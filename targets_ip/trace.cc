@@ -0,0 +1,133 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// Events kept per thread, about 1.5 MB.
+const size_t TRACE_BUFFER_CAPACITY = 1 << 16;
+
+TraceBuffer::TraceBuffer(int thread_id, size_t capacity)
+	: events(capacity), written(0), thread_id(thread_id) {
+}
+
+void TraceBuffer::record(const char *name, int64_t start_ns, int64_t duration_ns) {
+	const uint64_t index = written.load(std::memory_order_relaxed);
+	events[index % events.size()] = {name, start_ns, duration_ns};
+	written.store(index + 1, std::memory_order_release);
+}
+
+std::vector<TraceEvent> TraceBuffer::snapshot() const {
+	const uint64_t capacity = events.size();
+	const uint64_t before = written.load(std::memory_order_acquire);
+	std::vector<TraceEvent> copy;
+	const uint64_t first = before > capacity ? before - capacity : 0;
+	for (uint64_t index = first; index < before; index++) {
+		copy.push_back(events[index % capacity]);
+	}
+	// Events overwritten during the copy, including one being written now,
+	// are dropped.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	const uint64_t after = written.load(std::memory_order_relaxed);
+	const uint64_t valid = after >= capacity ? after - capacity + 1 : 0;
+	if (valid > first) {
+		copy.erase(copy.begin(), copy.begin() + std::min<uint64_t>(valid - first, copy.size()));
+	}
+	return copy;
+}
+
+namespace {
+
+// Buffers outlive their threads so that a trace written after a worker
+// exits still holds its spans.
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<TraceBuffer>> registry;
+
+TraceBuffer *registerThread() {
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	registry.push_back(std::make_unique<TraceBuffer>(registry.size() + 1, TRACE_BUFFER_CAPACITY));
+	return registry.back().get();
+}
+
+void writeJsonString(std::ostream &out, const std::string &value) {
+	out << '"';
+	for (const char c : value) {
+		if (c == '"' || c == '\\') {
+			out << '\\' << c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			out << ' ';
+		} else {
+			out << c;
+		}
+	}
+	out << '"';
+}
+
+}  // namespace
+
+int64_t traceNow() {
+	static const auto epoch = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - epoch).count();
+}
+
+TraceBuffer *threadTraceBuffer() {
+	thread_local TraceBuffer *buffer = registerThread();
+	return buffer;
+}
+
+void setTraceThreadName(const std::string &name) {
+	TraceBuffer *buffer = threadTraceBuffer();
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	buffer->thread_name = name;
+}
+
+void writeChromeTrace(std::ostream &out) {
+	std::vector<std::pair<const TraceBuffer*, std::string>> buffers;
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		for (const auto &buffer : registry) {
+			buffers.emplace_back(buffer.get(), buffer->thread_name);
+		}
+	}
+
+	const int pid = getpid();
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	auto separator = [&out, &first]() {
+		out << (first ? "\n" : ",\n");
+		first = false;
+	};
+	out << std::fixed << std::setprecision(3);
+	for (const auto &[buffer, thread_name] : buffers) {
+		if (!thread_name.empty()) {
+			separator();
+			out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid
+				<< ",\"tid\":" << buffer->thread_id << ",\"args\":{\"name\":";
+			writeJsonString(out, thread_name);
+			out << "}}";
+		}
+		for (const TraceEvent &event : buffer->snapshot()) {
+			separator();
+			out << "{\"ph\":\"X\",\"name\":";
+			writeJsonString(out, event.name);
+			out << ",\"pid\":" << pid << ",\"tid\":" << buffer->thread_id
+				<< ",\"ts\":" << event.start_ns / 1000.0
+				<< ",\"dur\":" << event.duration_ns / 1000.0 << "}";
+		}
+	}
+	out << "\n]}\n";
+}
+
+bool storeChromeTrace(const std::string &filename) {
+	std::ofstream out(filename);
+	writeChromeTrace(out);
+	return out.good();
+}
@@ -0,0 +1,76 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Timeline tracing of the pipeline. A span records its name, thread, start
+// and duration into a buffer owned by the recording thread; recording takes
+// no lock. writeChromeTrace collects the buffers of all threads as Chrome
+// trace-event JSON, viewable in chrome://tracing or Perfetto.
+//
+// Spans are compiled in with the TARGETS_TRACING CMake option, otherwise
+// TRACE_SPAN expands to nothing.
+
+struct TraceEvent {
+	const char *name;  // string literal, not copied
+	int64_t start_ns;
+	int64_t duration_ns;
+};
+
+// Ring of the most recent events of one thread. Only the owning thread
+// writes; a reader copies the ring and keeps the events which were not
+// overwritten while it copied.
+class TraceBuffer {
+ private:
+	std::vector<TraceEvent> events;
+	std::atomic<uint64_t> written;
+
+ public:
+	const int thread_id;
+	std::string thread_name;
+
+	TraceBuffer(int thread_id, size_t capacity);
+
+	void record(const char *name, int64_t start_ns, int64_t duration_ns);
+	std::vector<TraceEvent> snapshot() const;
+};
+
+// Nanoseconds since the first call, on the steady clock.
+int64_t traceNow();
+TraceBuffer *threadTraceBuffer();
+// Names the calling thread in the trace.
+void setTraceThreadName(const std::string &name);
+void writeChromeTrace(std::ostream &out);
+bool storeChromeTrace(const std::string &filename);
+
+class TraceSpan {
+ private:
+	const char *name;
+	int64_t start_ns;
+
+ public:
+	explicit TraceSpan(const char *name) : name(name), start_ns(traceNow()) {}
+	TraceSpan(const TraceSpan&) = delete;
+	TraceSpan &operator=(const TraceSpan&) = delete;
+	~TraceSpan() {
+		threadTraceBuffer()->record(name, start_ns, traceNow() - start_ns);
+	}
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifdef TARGETS_TRACING
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) setTraceThreadName(name)
+#else
+#define TRACE_SPAN(name) do {} while (false)
+#define TRACE_THREAD_NAME(name) do {} while (false)
+#endif
+
+#endif  // _TRACE_H
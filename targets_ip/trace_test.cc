@@ -0,0 +1,42 @@
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TraceTest
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+
+#include "trace.h"
+
+BOOST_AUTO_TEST_CASE(test_ring_keeps_newest_events) {
+	TraceBuffer buffer(1, 4);
+	for (int i = 0; i < 6; i++) {
+		buffer.record("event", i, 1);
+	}
+	const auto events = buffer.snapshot();
+	// The oldest slot may be overwritten next and is not reported.
+	BOOST_REQUIRE_EQUAL(events.size(), 3);
+	BOOST_CHECK_EQUAL(events.front().start_ns, 3);
+	BOOST_CHECK_EQUAL(events.back().start_ns, 5);
+}
+
+BOOST_AUTO_TEST_CASE(test_chrome_trace_holds_spans_of_all_threads) {
+	std::thread worker([]() {
+		setTraceThreadName("trace \"worker\"");
+		TraceSpan span("worker_span");
+	});
+	worker.join();
+	{
+		TraceSpan span("main_span");
+	}
+
+	std::ostringstream out;
+	writeChromeTrace(out);
+	const std::string trace = out.str();
+	BOOST_CHECK(trace.find("\"traceEvents\"") != std::string::npos);
+	BOOST_CHECK(trace.find("\"name\":\"worker_span\"") != std::string::npos);
+	BOOST_CHECK(trace.find("\"name\":\"main_span\"") != std::string::npos);
+	BOOST_CHECK(trace.find("trace \\\"worker\\\"") != std::string::npos);
+}
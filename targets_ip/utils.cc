@@ -58,6 +58,16 @@ float dist(const Vec2f &a, const Vec2f &b) {
 	return sqrt(diff.dot(diff));
 }
 
+float pointSegmentDistance(const Vec2f &p, const Vec2f &a, const Vec2f &b) {
+	Vec2f segment = b - a;
+	float length2 = segment.dot(segment);
+	if (length2 == 0) {
+		return dist(p, a);
+	}
+	float t = std::clamp((p - a).dot(segment) / length2, 0.0f, 1.0f);
+	return dist(p, a + segment * t);
+}
+
 Line createLineFromSlope(cv::Vec2f slope_line) {
 	float rho = slope_line[0], theta = slope_line[1];
 	Point pt1, pt2;
@@ -2,12 +2,15 @@
 #define _UTILS_H
 #pragma once
 
+#include <chrono>
+#include <cmath>
 #include <vector>
 
 #include <opencv2/core/mat.hpp>
 
 std::vector<int> get_random_n_tuple(int count, int max);
 float dist(const cv::Vec2f &a, const cv::Vec2f &b);
+float pointSegmentDistance(const cv::Vec2f &p, const cv::Vec2f &a, const cv::Vec2f &b);
 
 struct Line {
 	cv::Vec2f a_, b_;
@@ -24,21 +27,40 @@ float cosAngleLines(Line a, Line b);
 bool intersection(Line a, Line b, cv::Vec2f *r);
 
 template<typename G>
-auto mean(G element_getter, size_t len) {
-	auto sum = 0;
-	for (int i = 0; i < len; i++) {
+double mean(G element_getter, size_t len) {
+	double sum = 0;
+	for (size_t i = 0; i < len; i++) {
 		sum += element_getter(i);
 	}
-	return sum / len;
+	return len ? sum / len : 0;
 }
 
+// Population standard deviation.
 template<typename G>
-auto std_dev(G element_getter, size_t len) {
-	auto mean_val = mean(element_getter, len);
-	auto var_val = mean([&](int i) { return element_getter(i) - mean_val; }, len);
-	return sqrt(var_val);
+double std_dev(G element_getter, size_t len) {
+	const double mean_val = mean(element_getter, len);
+	const double var_val = mean([&](size_t i) {
+		const double deviation = element_getter(i) - mean_val;
+		return deviation * deviation;
+	}, len);
+	return std::sqrt(var_val);
 }
 
+// Measures wall time between consecutive laps.
+class Stopwatch {
+ private:
+	std::chrono::steady_clock::time_point start;
+
+ public:
+	Stopwatch() : start(std::chrono::steady_clock::now()) {}
+	float lap() {
+		const auto now = std::chrono::steady_clock::now();
+		const std::chrono::duration<float, std::milli> elapsed = now - start;
+		start = now;
+		return elapsed.count();
+	}
+};
+
 void sameAs(cv::Mat *target, const cv::Mat &source);
 
 void zeroSameAs(cv::Mat *target, const cv::Mat &source);
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <vector>
 
 #define BOOST_TEST_MAIN
 #define BOOST_TEST_DYN_LINK
@@ -25,3 +26,19 @@ BOOST_AUTO_TEST_CASE(test_intersection) {
 		Line(Vec2f(0, 0), Vec2f(0, 1)), &r));
 	BOOST_CHECK_SMALL(dist(r, Vec2f(0, 0)), 0.0001f);
 }
+
+BOOST_AUTO_TEST_CASE(test_point_segment_distance) {
+	BOOST_CHECK_CLOSE(pointSegmentDistance(Vec2f(1, 1), Vec2f(0, 0), Vec2f(2, 0)), 1.0, 0.0001);
+	BOOST_CHECK_CLOSE(pointSegmentDistance(Vec2f(3, 0), Vec2f(0, 0), Vec2f(2, 0)), 1.0, 0.0001);
+	BOOST_CHECK_CLOSE(pointSegmentDistance(Vec2f(0, 2), Vec2f(0, 0), Vec2f(0, 0)), 2.0, 0.0001);
+}
+
+BOOST_AUTO_TEST_CASE(test_mean_and_std_dev) {
+	const std::vector<int> values{2, 4, 4, 4, 5, 5, 7, 9};
+	auto getter = [&values](size_t i) { return values[i]; };
+	BOOST_CHECK_CLOSE(mean(getter, values.size()), 5.0, 0.0001);
+	BOOST_CHECK_CLOSE(std_dev(getter, values.size()), 2.0, 0.0001);
+
+	const std::vector<float> fractions{0.5f, 1.5f};
+	BOOST_CHECK_CLOSE(mean([&fractions](size_t i) { return fractions[i]; }, 2), 1.0, 0.0001);
+}
@@ -4,18 +4,30 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/videoio.hpp>
 
+#include "trace.h"
+
 void captureCameraImage(std::string source,
 	cv::Mat *frame,
-	std::function<void(const cv::Mat&)> fnc) {
+	std::function<void(const cv::Mat&)> fnc,
+	std::function<void(int)> on_key) {
 	cv::VideoCapture capture(source.c_str());
+	TRACE_THREAD_NAME("capture");
 	while (capture.isOpened()) {
-		capture.grab();
-		capture.retrieve(*frame);
+		{
+			TRACE_SPAN("capture");
+			capture.grab();
+			capture.retrieve(*frame);
+		}
 		if (!frame->empty()) {
+			TRACE_SPAN("process_frame");
 			fnc(*frame);
 		}
-		if (cv::waitKey(100) == 27) {
+		const int key = cv::waitKey(100);
+		if (key == 27) {
 			break;
 		}
+		if (key >= 0 && on_key) {
+			on_key(key);
+		}
 	}
 }
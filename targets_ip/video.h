@@ -10,8 +10,10 @@
 // Examples
 //  captureCameraImage("http://100.112.117.170:9999/video");
 //  captureCameraImage("/dev/video0");
+// Keys other than escape, which stops the capture, are passed to on_key.
 void captureCameraImage(std::string source,
 	cv::Mat *frame,
-	std::function<void(const cv::Mat&)> fnc);
+	std::function<void(const cv::Mat&)> fnc,
+	std::function<void(int)> on_key = nullptr);
 
 #endif